@@ -0,0 +1,161 @@
+// File  : awaiting_response_table.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "awaiting_response_table.hpp"
+
+//--------------------------------------------------------------------------------
+AwaitingResponseTable::AwaitingResponseTable(size_t expectedEntries, unsigned timeoutTicks) :
+  count      (0),
+  timeout    ((timeoutTicks > 0) ? timeoutTicks : 1),
+  currentTick(0),
+  wheel      (timeout + 1)
+{
+  size_t capacity = 16;
+
+  while(capacity < expectedEntries * 2) { // keep the load factor at or below 0.5
+    capacity <<= 1;
+  }
+
+  slots.resize(capacity);
+  mask = capacity - 1;
+}
+
+//--------------------------------------------------------------------------------
+void AwaitingResponseTable::put(SharedSmppPdu pdu)
+{
+  uint32_t seq = pdu->sequence_number;
+
+  if((count + 1) * 2 > slots.size()) {
+    grow();
+  }
+
+  size_t i = findSlot(seq);
+
+  if(!slots[i].pdu) {
+    ++count;
+  }
+
+  slots[i].seq       = seq;
+  slots[i].pdu       = pdu;
+  slots[i].expiresAt = currentTick + timeout;
+
+  wheel[slots[i].expiresAt % wheel.size()].push_back(seq);
+}
+
+//--------------------------------------------------------------------------------
+SharedSmppPdu AwaitingResponseTable::pop(uint32_t seqNum)
+{
+  SharedSmppPdu retval;
+  size_t        i = findSlot(seqNum);
+
+  if(slots[i].pdu) {
+    retval = slots[i].pdu;
+    eraseAt(i);
+  }
+
+  return retval;
+}
+
+//--------------------------------------------------------------------------------
+void AwaitingResponseTable::expire(std::vector<SharedSmppPdu> &expired)
+{
+  ++currentTick;
+
+  std::vector<uint32_t> &due = wheel[currentTick % wheel.size()];
+
+  for(std::vector<uint32_t>::iterator s = due.begin(); s != due.end(); ++s) {
+    size_t i = findSlot(*s);
+
+    // Not found: the response arrived in time. Different expiry: the sequence number was put again since.
+    if(slots[i].pdu && slots[i].expiresAt == currentTick) {
+      expired.push_back(slots[i].pdu);
+      eraseAt(i);
+    }
+  }
+
+  due.clear();
+}
+
+//--------------------------------------------------------------------------------
+void AwaitingResponseTable::drain(std::vector<SharedSmppPdu> &all)
+{
+  for(std::vector<Entry>::iterator i = slots.begin(); i != slots.end(); ++i) {
+    if(i->pdu) {
+      all.push_back(i->pdu);
+      i->pdu.reset();
+    }
+  }
+
+  for(std::vector< std::vector<uint32_t> >::iterator w = wheel.begin(); w != wheel.end(); ++w) {
+    w->clear();
+  }
+
+  count = 0;
+}
+
+//--------------------------------------------------------------------------------
+size_t AwaitingResponseTable::findSlot(uint32_t seq)
+{
+  // Returns the slot holding seq, or the empty slot where it would go.
+  size_t i = home(seq);
+
+  while(slots[i].pdu && slots[i].seq != seq) {
+    i = (i + 1) & mask;
+  }
+
+  return i;
+}
+
+//--------------------------------------------------------------------------------
+void AwaitingResponseTable::eraseAt(size_t i)
+{
+  // Backward shift deletion: entries further along the probe sequence are moved
+  // up into the hole, so that lookups never need tombstones.
+  slots[i].pdu.reset();
+  --count;
+
+  for(size_t j = (i + 1) & mask; slots[j].pdu; j = (j + 1) & mask) {
+    size_t h = home(slots[j].seq);
+
+    bool canMove = (j > i) ? (h <= i || h > j)   // probe sequence of j passes through i
+                           : (h <= i && h > j);  // same, with the table wrapping around between i and j.
+    if(canMove) {
+      slots[i] = slots[j];
+      slots[j].pdu.reset();
+      i = j;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+void AwaitingResponseTable::grow()
+{
+  std::vector<Entry> old;
+
+  old.swap(slots);
+  slots.resize(old.size() * 2);
+  mask = slots.size() - 1;
+
+  for(std::vector<Entry>::iterator e = old.begin(); e != old.end(); ++e) {
+    if(e->pdu) {
+      slots[findSlot(e->seq)] = *e;
+    }
+  }
+}
@@ -0,0 +1,74 @@
+// File  : awaiting_response_table.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _AWAITING_RESPONSE_TABLE_HPP_
+#define _AWAITING_RESPONSE_TABLE_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+#include "sharedsmpppdu.hpp"
+
+//--------------------------------------------------------------------------------
+// The (W)aiting 4 (R)esponse table: sent PDU's, keyed by sequence number.
+//
+// Entries live in a flat, open addressed (linear probing) table, so put() and
+// pop() are O(1) and allocation free once the table has grown to the window
+// size. Ageing is done with a hashed timing wheel: put() drops the sequence
+// number into the wheel slot for the tick at which it expires, and expire()
+// only looks at the slot of the current tick. Entries that were popped in the
+// meantime are skipped when their slot comes around, so pop() never has to
+// touch the wheel.
+class AwaitingResponseTable
+{
+  public:
+    AwaitingResponseTable(size_t expectedEntries, unsigned timeoutTicks);
+    ~AwaitingResponseTable() {}
+
+    void          put   (SharedSmppPdu pdu);
+    SharedSmppPdu pop   (uint32_t seqNum);                     // empty if there is no such entry.
+    size_t        size  () { return count; }
+
+    void          expire(std::vector<SharedSmppPdu> &expired); // advances the wheel by one tick.
+    void          drain (std::vector<SharedSmppPdu> &all);     // removes every entry.
+
+  private:
+    struct Entry {
+      Entry() : seq(0), expiresAt(0) {}
+
+      uint32_t      seq;
+      uint32_t      expiresAt; // tick
+      SharedSmppPdu pdu;       // empty slot if not set.
+    };
+
+    size_t home     (uint32_t seq) { return (seq * 2654435761U) & mask; }
+    size_t findSlot (uint32_t seq);
+    void   eraseAt  (size_t i);
+    void   grow     ();
+
+    std::vector<Entry>                  slots;
+    size_t                              mask;
+    size_t                              count;
+    unsigned                            timeout;     // ticks
+    uint32_t                            currentTick;
+    std::vector< std::vector<uint32_t> > wheel;      // sequence numbers, by the tick at which they expire.
+};
+
+#endif // _AWAITING_RESPONSE_TABLE_HPP_
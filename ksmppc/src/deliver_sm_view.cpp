@@ -0,0 +1,278 @@
+// File  : deliver_sm_view.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include "deliver_sm_view.hpp"
+
+namespace {
+  const uint32_t HEADER_SIZE = 16;
+
+  // Number of single octet fields that follow each C-octet string.
+  const unsigned OCTETS_AFTER[] = { 2,   // source_addr_ton, source_addr_npi
+                                    2,   // dest_addr_ton, dest_addr_npi
+                                    3,   // esm_class, protocol_id, priority_flag
+                                    0,   //
+                                    5 }; // registered_delivery, replace_if_present_flag, data_coding, sm_default_msg_id, sm_length
+
+  inline uint16_t get16(const uint8_t *p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+}
+
+//--------------------------------------------------------------------------------
+DeliverSmView::DeliverSmView(const uint8_t *data, size_t size) :
+  frame      (data),
+  cmdLength  (0),
+  scanned    (false),
+  wellFormed (false),
+  shortMessageOffset(0),
+  tlvOffset  (0),
+  tlvsScanned(false)
+{
+  if(frame && size >= HEADER_SIZE) {
+    cmdLength = smpp_pdu::get_command_length(frame);
+
+    if(cmdLength > size) { // never trust command_length beyond the bytes we actually have.
+      cmdLength = size;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+DeliverSmView::DeliverSmView(RawPdu &rawpdu) :
+  frame      (rawpdu.data()),
+  cmdLength  (rawpdu.cmd_length()), // RawPdu is only ever made for a complete frame.
+  scanned    (false),
+  wellFormed (false),
+  shortMessageOffset(0),
+  tlvOffset  (0),
+  tlvsScanned(false)
+{
+}
+
+//--------------------------------------------------------------------------------
+DeliverSmView::DeliverSmView(const std::string &bytes) :
+  frame      (reinterpret_cast<const uint8_t *>(bytes.data())),
+  cmdLength  (0),
+  scanned    (false),
+  wellFormed (false),
+  shortMessageOffset(0),
+  tlvOffset  (0),
+  tlvsScanned(false)
+{
+  if(bytes.size() >= HEADER_SIZE) {
+    cmdLength = smpp_pdu::get_command_length(frame);
+
+    if(cmdLength > bytes.size()) {
+      cmdLength = bytes.size();
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+bool DeliverSmView::valid() const
+{
+  scan();
+  return wellFormed;
+}
+
+//--------------------------------------------------------------------------------
+uint32_t DeliverSmView::commandId() const
+{
+  return (cmdLength >= HEADER_SIZE) ? smpp_pdu::get_command_id(frame) : 0;
+}
+
+//--------------------------------------------------------------------------------
+uint32_t DeliverSmView::sequenceNumber() const
+{
+  return (cmdLength >= HEADER_SIZE) ? smpp_pdu::get_sequence_number(frame) : 0;
+}
+
+//--------------------------------------------------------------------------------
+std::string DeliverSmView::shortMessage() const
+{
+  scan();
+
+  if(!wellFormed) {
+    return std::string();
+  }
+
+  return std::string(reinterpret_cast<const char *>(frame + shortMessageOffset), tlvOffset - shortMessageOffset);
+}
+
+//--------------------------------------------------------------------------------
+std::string DeliverSmView::message() const
+{
+  std::string retval = shortMessage();
+
+  if(retval.empty()) {
+    tlv(TLV_MESSAGE_PAYLOAD, retval);
+  }
+
+  return retval;
+}
+
+//--------------------------------------------------------------------------------
+bool DeliverSmView::hasTlv(uint16_t tag) const
+{
+  return findTlv(tag) != NULL;
+}
+
+//--------------------------------------------------------------------------------
+bool DeliverSmView::tlv(uint16_t tag, std::string &value) const
+{
+  const Tlv *t = findTlv(tag);
+
+  if(!t) {
+    return false;
+  }
+
+  value.assign(reinterpret_cast<const char *>(frame + t->offset), t->length);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+SharedPduDeliverSm DeliverSmView::materialize() const
+{
+  SharedPduDeliverSm retval;
+
+  if(valid()) {
+    retval.reset(new smpp_pdu::PDU_deliver_sm(reinterpret_cast<const char *>(frame)));
+  }
+
+  return retval;
+}
+
+//--------------------------------------------------------------------------------
+// Walks the mandatory fields once, recording where each C-octet string starts
+// and ends. Every later field access is a lookup.
+void DeliverSmView::scan() const
+{
+  if(scanned) {
+    return;
+  }
+
+  scanned    = true;
+  wellFormed = false;
+
+  if(cmdLength < HEADER_SIZE) {
+    return;
+  }
+
+  uint32_t pos = HEADER_SIZE;
+
+  for(unsigned i = 0; i < FIELD_COUNT; ++i) {
+    if(pos >= cmdLength) {
+      return;
+    }
+
+    const void *nul = memchr(frame + pos, 0, cmdLength - pos);
+
+    if(!nul) {
+      return;
+    }
+
+    starts[i] = pos;
+    afters[i] = static_cast<uint32_t>(static_cast<const uint8_t *>(nul) - frame) + 1;
+    pos       = afters[i] + OCTETS_AFTER[i];
+  }
+
+  if(pos > cmdLength) {
+    return;
+  }
+
+  shortMessageOffset = pos;
+  tlvOffset          = pos + frame[pos - 1]; // sm_length is the last octet before short_message.
+
+  if(tlvOffset > cmdLength) {
+    return;
+  }
+
+  wellFormed = true;
+}
+
+//--------------------------------------------------------------------------------
+void DeliverSmView::scanTlvs() const
+{
+  if(tlvsScanned) {
+    return;
+  }
+
+  tlvsScanned = true;
+
+  if(!valid()) {
+    return;
+  }
+
+  uint32_t pos = tlvOffset;
+
+  while(pos + 4 <= cmdLength) {
+    Tlv t;
+
+    t.tag    = get16(frame + pos);
+    t.length = get16(frame + pos + 2);
+    t.offset = pos + 4;
+
+    if(t.offset + t.length > cmdLength) { // truncated TLV, keep the ones before it.
+      break;
+    }
+
+    tlvs.push_back(t);
+    pos = t.offset + t.length;
+  }
+}
+
+//--------------------------------------------------------------------------------
+const DeliverSmView::Tlv *DeliverSmView::findTlv(uint16_t tag) const
+{
+  scanTlvs();
+
+  for(size_t i = 0; i < tlvs.size(); ++i) {
+    if(tlvs[i].tag == tag) {
+      return &tlvs[i];
+    }
+  }
+
+  return NULL;
+}
+
+//--------------------------------------------------------------------------------
+std::string DeliverSmView::cString(Field field) const
+{
+  scan();
+
+  if(!wellFormed) {
+    return std::string();
+  }
+
+  return std::string(reinterpret_cast<const char *>(frame + starts[field]), afters[field] - starts[field] - 1);
+}
+
+//--------------------------------------------------------------------------------
+uint8_t DeliverSmView::octetAfter(Field field, unsigned octet) const
+{
+  scan();
+
+  if(!wellFormed) {
+    return 0;
+  }
+
+  return frame[afters[field] + octet];
+}
+
@@ -0,0 +1,115 @@
+// File  : deliver_sm_view.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _DELIVER_SM_VIEW_HPP_
+#define _DELIVER_SM_VIEW_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <smpppdu_all.hpp>
+
+#include "rawpdu.hpp"
+#include "smpppdu_queue.hpp"
+
+//--------------------------------------------------------------------------------
+// Read only access to the fields of an encoded deliver_sm, without decoding it.
+// The mandatory fields are located by a single scan, on first access to any of
+// them, the TLVs by a second scan on first TLV lookup. Only the bytes of the
+// fields actually asked for are ever copied.
+//
+// Like RawPdu, the view does not own the bytes. They must outlive it.
+class DeliverSmView
+{
+  public:
+    DeliverSmView(const uint8_t *data, size_t size);
+    explicit DeliverSmView(RawPdu            &rawpdu);
+    explicit DeliverSmView(const std::string &bytes);
+    ~DeliverSmView() {}
+
+    enum { TLV_MESSAGE_PAYLOAD = 0x0424, TLV_RECEIPTED_MESSAGE_ID = 0x001E, TLV_MESSAGE_STATE = 0x0427 };
+
+    bool        valid                () const; // false if the PDU is truncated, or a C-octet string is unterminated.
+
+    uint32_t    commandLength        () const { return cmdLength; }
+    uint32_t    commandId            () const;
+    uint32_t    sequenceNumber       () const;
+
+    std::string serviceType          () const { return cString  (SERVICE_TYPE          ); }
+    uint8_t     sourceAddrTon        () const { return octetAfter(SERVICE_TYPE       , 0); }
+    uint8_t     sourceAddrNpi        () const { return octetAfter(SERVICE_TYPE       , 1); }
+    std::string sourceAddr           () const { return cString  (SOURCE_ADDR           ); }
+    uint8_t     destAddrTon          () const { return octetAfter(SOURCE_ADDR        , 0); }
+    uint8_t     destAddrNpi          () const { return octetAfter(SOURCE_ADDR        , 1); }
+    std::string destinationAddr      () const { return cString  (DESTINATION_ADDR      ); }
+    uint8_t     esmClass             () const { return octetAfter(DESTINATION_ADDR   , 0); }
+    uint8_t     protocolId           () const { return octetAfter(DESTINATION_ADDR   , 1); }
+    uint8_t     priorityFlag         () const { return octetAfter(DESTINATION_ADDR   , 2); }
+    std::string scheduleDeliveryTime () const { return cString  (SCHEDULE_DELIVERY_TIME); }
+    std::string validityPeriod       () const { return cString  (VALIDITY_PERIOD       ); }
+    uint8_t     registeredDelivery   () const { return octetAfter(VALIDITY_PERIOD    , 0); }
+    uint8_t     replaceIfPresentFlag () const { return octetAfter(VALIDITY_PERIOD    , 1); }
+    uint8_t     dataCoding           () const { return octetAfter(VALIDITY_PERIOD    , 2); }
+    uint8_t     smDefaultMsgId       () const { return octetAfter(VALIDITY_PERIOD    , 3); }
+    uint8_t     smLength             () const { return octetAfter(VALIDITY_PERIOD    , 4); }
+    std::string shortMessage         () const;
+
+    bool        isDeliveryReceipt    () const { return (esmClass() & 0x3C) == 0x04; } // esm_class bits 5..2, message type "MC Delivery Receipt".
+    std::string message              () const; // short_message, or the message_payload TLV if short_message is empty.
+
+    bool        hasTlv               (uint16_t tag) const;
+    bool        tlv                  (uint16_t tag, std::string &value) const; // false if the PDU does not carry the TLV.
+
+    SharedPduDeliverSm materialize   () const; // a fully decoded PDU, for consumers that need every field.
+
+  private:
+    // The C-octet strings, whose positions depend on the lengths of the ones before them.
+    enum Field { SERVICE_TYPE, SOURCE_ADDR, DESTINATION_ADDR, SCHEDULE_DELIVERY_TIME, VALIDITY_PERIOD, FIELD_COUNT };
+
+    struct Tlv
+    {
+      uint16_t tag;
+      uint32_t offset;
+      uint16_t length;
+    };
+
+    void        scan                 () const;
+    void        scanTlvs             () const;
+    std::string cString              (Field field) const;
+    uint8_t     octetAfter           (Field field, unsigned octet) const;
+    const Tlv  *findTlv              (uint16_t tag) const;
+
+    const uint8_t            *frame;
+    uint32_t                  cmdLength;       // bytes of frame that may be read. 0 if the header itself is short.
+
+    mutable bool              scanned;
+    mutable bool              wellFormed;
+    mutable uint32_t          starts[FIELD_COUNT];  // of each C-octet string, from the start of the frame.
+    mutable uint32_t          afters[FIELD_COUNT];  // first byte after each C-octet string's NULL terminator.
+    mutable uint32_t          shortMessageOffset;
+    mutable uint32_t          tlvOffset;       // first byte after short_message.
+
+    mutable bool              tlvsScanned;
+    mutable std::vector<Tlv>  tlvs;
+};
+
+#endif // _DELIVER_SM_VIEW_HPP_
+
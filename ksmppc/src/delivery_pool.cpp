@@ -0,0 +1,424 @@
+// File  : delivery_pool.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <ctime>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include <kisscpp/logstream.hpp>
+
+#include "log.hpp"
+#include "reconnect_backoff.hpp"
+#include "deliver_sm_view.hpp"
+#include "delivery_pool.hpp"
+
+//--------------------------------------------------------------------------------
+DeliverySettings::DeliverySettings()
+{
+  std::string list       = CFG->get<std::string> ("delivery.endpoints"               , "localhost:9100");
+  transport              = CFG->get<std::string> ("delivery.transport"               , "kisscpp");
+  connectionsPerEndpoint = CFG->get<unsigned int>("delivery.connections-per-endpoint", 1);
+  maxInFlight            = CFG->get<unsigned int>("delivery.max-in-flight"           , 64);
+  batchSize              = CFG->get<unsigned int>("delivery.batch-size"              , 1);
+  timeoutMs              = CFG->get<unsigned int>("delivery.timeout-ms"              , 5000);
+  retryInitialMs         = CFG->get<unsigned int>("delivery.retry-initial-delay"     , 1000);
+  retryMaxMs             = CFG->get<unsigned int>("delivery.retry-max-delay"         , 60000);
+  retryMultiplier        = CFG->get<double>      ("delivery.retry-multiplier"        , 2.0);
+  maxAttempts            = CFG->get<unsigned int>("delivery.max-attempts"            , 10);
+
+  connectionsPerEndpoint = std::max(1U, connectionsPerEndpoint);
+  maxInFlight            = std::max(1U, maxInFlight);
+  batchSize              = std::max(1U, batchSize);
+  maxAttempts            = std::max(1U, maxAttempts);
+  shards                 = CFG->get<unsigned int>("delivery.shards"                  , 0);
+
+  size_t begin = 0;
+
+  while(begin <= list.size()) {
+    size_t      end   = std::min(list.find(',', begin), list.size());
+    std::string entry = list.substr(begin, end - begin);
+
+    entry.erase(0, entry.find_first_not_of(' '));
+    entry.erase(entry.find_last_not_of(' ') + 1);
+
+    size_t colon = entry.rfind(':');
+
+    if(colon == std::string::npos || colon == 0 || colon + 1 == entry.size()) {
+      throw std::runtime_error("delivery.endpoints: expected host:port, got '" + entry + "'");
+    }
+
+    DeliveryEndpoint endpoint;
+    endpoint.host = entry.substr(0, colon);
+    endpoint.port = entry.substr(colon + 1);
+    endpoints.push_back(endpoint);
+
+    begin = end + 1;
+  }
+
+  if(shards == 0) {
+    shards = endpoints.size() * connectionsPerEndpoint;
+  }
+}
+
+//--------------------------------------------------------------------------------
+DeliveryPool::DeliveryPool(SharedPduBytesQueue recieveQueue,
+                           SharedPduBytesQueue errorQueue,
+                           Converter           pduConverter) :
+  recieveQ (recieveQueue),
+  errorQ   (errorQueue),
+  converter(pduConverter),
+  shards   (settings.shards),
+  nextShard(0),
+  inFlight (0),
+  retrying (0),
+  stopping (false),
+  jitter   (static_cast<uint32_t>(time(NULL)) ^ static_cast<uint32_t>(getpid()))
+{
+  for(size_t i = 0; i < settings.endpoints.size(); ++i) {
+    makeDeliveryTransport(settings.transport, settings.endpoints[i], settings.timeoutMs); // fail at startup, not in a worker.
+  }
+
+  for(size_t i = 0; i < shards.size(); ++i) {
+    shards[i].depthStat = "delivery.shard." + boost::lexical_cast<std::string>(i) + ".depth";
+  }
+}
+
+//--------------------------------------------------------------------------------
+DeliveryPool::~DeliveryPool()
+{
+  stop();
+}
+
+//--------------------------------------------------------------------------------
+void DeliveryPool::start()
+{
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+  for(size_t i = 0; i < settings.endpoints.size(); ++i) {
+    log << "Delivering to " << settings.endpoints[i].host << ":" << settings.endpoints[i].port
+        << " over " << settings.connectionsPerEndpoint << " " << settings.transport << " connection(s)." << kisscpp::manip::flush;
+
+    for(unsigned c = 0; c < settings.connectionsPerEndpoint; ++c) {
+      workers.create_thread(boost::bind(&DeliveryPool::worker, this, settings.endpoints[i]));
+    }
+  }
+
+  log << "Ordering deliveries in " << shards.size() << " shard(s), by source address." << kisscpp::manip::flush;
+}
+
+//--------------------------------------------------------------------------------
+bool DeliveryPool::submit(SharedPduBytes pdu, PduBytesQueue::Ticket ticket)
+{
+  SharedItem item(new Item());
+  size_t     shard = shardOf(*pdu);
+
+  item->pdu       = pdu;
+  item->ticket    = ticket;
+  item->converted = false;
+  item->attempts  = 0;
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  while(!stopping && inFlight >= settings.maxInFlight) {
+    spaceAvailable.wait(lock);
+  }
+
+  if(stopping) {
+    return false;
+  }
+
+  shards[shard].items.push_back(item);
+  ++inFlight;
+
+  statSet("delivery.in-flight"   , inFlight);
+  statSet(shards[shard].depthStat, shards[shard].items.size());
+
+  if(!shards[shard].busy) { // otherwise, the worker that has it, notifies when it is done.
+    workAvailable.notify_one();
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+void DeliveryPool::stop()
+{
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+  {
+    boost::mutex::scoped_lock lock(mutex);
+
+    if(stopping) {
+      return;
+    }
+
+    stopping = true;
+    workAvailable .notify_all();
+    spaceAvailable.notify_all();
+  }
+
+  workers.join_all(); // a worker finishes the delivery it is busy with, first.
+
+  std::vector<SharedPduBytes> undelivered;
+  size_t                      held = 0;
+
+  for(std::vector<Shard>::iterator s = shards.begin(); s != shards.end(); ++s) {
+    for(std::deque<SharedItem>::iterator i = s->items.begin(); i != s->items.end(); ++i) {
+      if((*i)->ticket) {
+        ++held; // still pending in recieveBuffer, and delivered first after a restart, in order.
+      } else {
+        undelivered.push_back((*i)->pdu);
+      }
+    }
+    s->items.clear();
+  }
+
+  inFlight = 0;
+  retrying = 0;
+
+  log << "Returning " << undelivered.size() << " undelivered message(s) to the recieve buffer, "
+      << held << " are still in it." << kisscpp::manip::flush;
+
+  try {
+    recieveQ->push_batch(undelivered);
+  } catch(std::exception &e) {
+    log << "Exception: " << e.what() << kisscpp::manip::endl;
+  }
+}
+
+//--------------------------------------------------------------------------------
+void DeliveryPool::worker(DeliveryEndpoint endpoint)
+{
+  kisscpp::LogStream                      log(__PRETTY_FUNCTION__);
+  SharedDeliveryTransport                 transport = makeDeliveryTransport(settings.transport, endpoint, settings.timeoutMs);
+  ReconnectBackoff                        backoff(settings.retryInitialMs, settings.retryMaxMs, settings.retryMultiplier, 0.2);
+  std::vector<SharedItem>                 batch;
+  std::vector<const BoostPtree*>          messages;
+  std::vector<DeliveryTransport::Outcome> outcomes;
+  size_t                                  shard;
+
+  while(takeBatch(batch, shard)) {
+    messages.clear();
+
+    for(size_t i = 0; i < batch.size(); ++i) {
+      if(!batch[i]->converted) { // here, so that the recieve workers share the conversion work too.
+        converter(batch[i]->pdu, batch[i]->message);
+        batch[i]->converted = true;
+      }
+
+      messages.push_back(&batch[i]->message);
+    }
+
+    try {
+      transport->deliver(messages, outcomes);
+    } catch(std::exception &e) {
+      log << "Exception: " << e.what() << kisscpp::manip::endl;
+      outcomes.assign(batch.size(), DeliveryTransport::RETRY);
+    }
+
+    statInc("delivery.batches");
+
+    if(finish(shard, batch, outcomes)) {
+      backoff.reset();
+      continue;
+    }
+
+    // This endpoint is in trouble. Leave the work to the other connections for
+    // a while, instead of failing everything that comes along.
+    boost::system_time       until = boost::get_system_time() + backoff.next();
+    boost::mutex::scoped_lock lock(mutex);
+
+    while(!stopping && workAvailable.timed_wait(lock, until)) {
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// The head of the first shard, after the last one taken, that is neither busy
+// nor backing off. Waits until there is one.
+bool DeliveryPool::takeBatch(std::vector<SharedItem> &batch, size_t &shard)
+{
+  boost::mutex::scoped_lock lock(mutex);
+
+  batch.clear();
+
+  while(!stopping) {
+    boost::system_time now      = boost::get_system_time();
+    boost::system_time earliest = boost::posix_time::pos_infin; // of the shards that are backing off.
+
+    for(size_t n = 0; n < shards.size(); ++n) {
+      size_t  index = (nextShard + n) % shards.size();
+      Shard  &s     = shards[index];
+
+      if(s.busy || s.items.empty()) {
+        continue;
+      }
+
+      if(!s.notBefore.is_not_a_date_time() && s.notBefore > now) {
+        earliest = std::min(earliest, s.notBefore);
+        continue;
+      }
+
+      while(batch.size() < settings.batchSize && !s.items.empty()) {
+        batch.push_back(s.items.front());
+        s.items.pop_front();
+
+        if(batch.back()->attempts > 0) {
+          --retrying;
+        }
+      }
+
+      s.busy    = true;
+      shard     = index;
+      nextShard = (index + 1) % shards.size();
+
+      statSet(s.depthStat            , s.items.size());
+      statSet("delivery.retry-depth", retrying);
+      return true;
+    }
+
+    if(earliest.is_pos_infinity()) {
+      workAvailable.wait(lock);
+    } else {
+      workAvailable.timed_wait(lock, earliest);
+    }
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------------------
+// Returns false if anything in the batch has to be retried. That, and
+// everything after it in the batch, goes back to the head of its shard, in its
+// original order. Those after it are not done yet, whatever their outcome, or
+// the application would get them before the one retried; one that was already
+// delivered, is delivered again.
+bool DeliveryPool::finish(size_t shard, const std::vector<SharedItem> &batch, const std::vector<DeliveryTransport::Outcome> &outcomes)
+{
+  std::vector<SharedItem> delivered;
+  std::vector<SharedItem> rejected;
+  std::vector<SharedItem> again;
+  bool                    allDone  = true;
+  unsigned                attempts = 0;
+  bool                    requeue  = false; // the rest of the batch goes back too.
+
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    Shard                    &s = shards[shard];
+
+    for(size_t i = 0; i < batch.size(); ++i) {
+      DeliveryTransport::Outcome outcome = (i < outcomes.size()) ? outcomes[i] : DeliveryTransport::RETRY;
+
+      if((outcome == DeliveryTransport::RETRY && ++batch[i]->attempts < settings.maxAttempts) || requeue) {
+        again.push_back(batch[i]);
+        attempts = std::max(attempts, batch[i]->attempts);
+        statInc("delivery.retried");
+        allDone = false;
+        requeue = true;
+        continue;
+      }
+
+      if(outcome == DeliveryTransport::DELIVERED) {
+        delivered.push_back(batch[i]);
+        statInc("delivery.delivered");
+      } else {
+        rejected.push_back(batch[i]);
+        allDone = allDone && (outcome == DeliveryTransport::REJECTED);
+      }
+
+      --inFlight;
+    }
+
+    s.items.insert(s.items.begin(), again.begin(), again.end());
+    retrying += again.size();
+    s.notBefore = again.empty() ? boost::system_time() : boost::get_system_time() + retryDelay(attempts);
+    s.busy      = false;
+
+    statSet("delivery.in-flight"  , inFlight);
+    statSet("delivery.retry-depth", retrying);
+    statSet(s.depthStat            , s.items.size());
+
+    spaceAvailable.notify_all();
+    workAvailable .notify_all(); // this shard is free again, and its backoff may be due sooner than what the others wait for.
+  }
+
+  for(size_t i = 0; i < delivered.size(); ++i) {
+    recieveQ->done(delivered[i]->ticket);
+  }
+
+  for(size_t i = 0; i < rejected.size(); ++i) {
+    reject(rejected[i]);
+  }
+
+  return allDone;
+}
+
+//--------------------------------------------------------------------------------
+// FNV-1a of the source address. A PDU we can't read an address from, goes to shard 0.
+size_t DeliveryPool::shardOf(const std::string &pdu) const
+{
+  DeliverSmView view(pdu);
+
+  if(shards.size() < 2 || !view.valid()) {
+    return 0;
+  }
+
+  std::string address = view.sourceAddr();
+  uint32_t    hash    = 2166136261U;
+
+  for(std::string::const_iterator i = address.begin(); i != address.end(); ++i) {
+    hash ^= (uint8_t)*i;
+    hash *= 16777619U;
+  }
+
+  return hash % shards.size();
+}
+
+//--------------------------------------------------------------------------------
+// initial * multiplier^(attempts - 1), up to the max, +/- 20%. Called with mutex held.
+boost::posix_time::time_duration DeliveryPool::retryDelay(unsigned attempts)
+{
+  boost::random::uniform_real_distribution<double> randomiser(0.8, 1.2);
+
+  double delay = settings.retryInitialMs * std::pow(std::max(1.0, settings.retryMultiplier), (double)(attempts - 1));
+
+  delay = std::min(delay, (double)std::max(settings.retryInitialMs, settings.retryMaxMs));
+
+  return boost::posix_time::milliseconds(static_cast<long>(delay * randomiser(jitter)));
+}
+
+//--------------------------------------------------------------------------------
+void DeliveryPool::reject(SharedItem item)
+{
+  statInc("delivery.rejected");
+
+  try {
+    errorQ->push(item->pdu);
+    recieveQ->done(item->ticket); // only once it is safe in rcv_errBuffer.
+  } catch(std::exception &e) {
+    KLOG(ERROR) << "Exception: " << e.what() << kisscpp::manip::endl;
+  }
+}
@@ -0,0 +1,151 @@
+// File  : delivery_pool.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _DELIVERY_POOL_HPP_
+#define _DELIVERY_POOL_HPP_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include <kisscpp/boost_ptree.hpp>
+
+#include "cfg.hpp"
+#include "stat.hpp"
+#include "pdu_queue.hpp"
+#include "delivery_transport.hpp"
+
+//--------------------------------------------------------------------------------
+// The "delivery" config section.
+struct DeliverySettings
+{
+  DeliverySettings();
+
+  std::vector<DeliveryEndpoint> endpoints;              // "delivery.endpoints": host:port[,host:port...]
+  std::string                   transport;              // "kisscpp" or "stream". See delivery_transport.hpp.
+  unsigned                      connectionsPerEndpoint; // one worker thread, and one transport, per connection.
+  unsigned                      shards;                 // ordering domains. Defaults to the number of workers.
+  unsigned                      maxInFlight;            // messages taken from recieveBuffer, but not yet delivered.
+  unsigned                      batchSize;              // max messages per delivery.
+  unsigned                      timeoutMs;
+  unsigned                      retryInitialMs;
+  unsigned                      retryMaxMs;
+  double                        retryMultiplier;
+  unsigned                      maxAttempts;            // then the message goes to rcv_errBuffer.
+};
+
+//--------------------------------------------------------------------------------
+// Delivers inbound messages to the application, over a pool of connections to
+// one or more endpoints. The pool's workers are the recieve workers: they turn
+// PDUs into requests, and deliver them, in parallel.
+//
+// Messages are sharded by a hash of their source address. Each shard is
+// delivered in order, one batch at a time, so a subscriber's messages (e.g. the
+// parts of a multipart reply, or a run of delivery receipts) reach the
+// application in the order the message centre sent them. Unrelated subscribers
+// proceed in parallel, on whichever worker is free. When a message in a batch
+// has to be retried, the rest of the batch is retried with it, so with a
+// batch size above 1, a message that already arrived may arrive again, after
+// the one before it.
+//
+// submit() blocks while maxInFlight messages are in the pool, so a slow
+// application backs up into recieveBuffer, rather than into memory. A batch
+// that could not be delivered goes back to the head of its shard, which then
+// waits out the backoff; other shards keep flowing.
+//
+// The deliver_sm_resp went to the message centre when the message was queued,
+// so the pool must not lose what it holds. With the segment backend, a message
+// stays pending in recieveBuffer, under the ticket it was submitted with,
+// until it was delivered, or is in rcv_errBuffer. After a crash it is
+// delivered again, so the application may see it twice. The paged backend has
+// no tickets: up to maxInFlight messages, including those waiting out a retry,
+// are then only in memory, and a crash loses them.
+class DeliveryPool : private boost::noncopyable
+{
+  public:
+    typedef boost::function<void (SharedPduBytes, BoostPtree &)> Converter; // PDU to smppin request.
+
+    DeliveryPool(SharedPduBytesQueue recieveQueue,
+                 SharedPduBytesQueue errorQueue,
+                 Converter           pduConverter);
+    ~DeliveryPool();
+
+    void start ();
+    bool submit(SharedPduBytes pdu, PduBytesQueue::Ticket ticket); // false once stop() was called.
+    void stop  ();                   // undelivered messages without a ticket, go back to recieveBuffer.
+
+  private:
+    struct Item
+    {
+      SharedPduBytes        pdu;
+      PduBytesQueue::Ticket ticket;    // recieveBuffer keeps the message until this is done(). 0 for the paged backend.
+      BoostPtree            message;   // converted by a worker, once.
+      bool                  converted;
+      unsigned              attempts;
+    };
+
+    typedef boost::shared_ptr<Item> SharedItem;
+
+    struct Shard
+    {
+      Shard() : busy(false) {}
+
+      std::deque<SharedItem> items;
+      bool                   busy;      // a worker is delivering this shard's head.
+      boost::system_time     notBefore; // backoff after a failed delivery.
+      std::string            depthStat;
+    };
+
+    void                             worker    (DeliveryEndpoint endpoint);
+    bool                             takeBatch (std::vector<SharedItem> &batch, size_t &shard);
+    bool                             finish    (size_t shard, const std::vector<SharedItem> &batch, const std::vector<DeliveryTransport::Outcome> &outcomes);
+    size_t                           shardOf   (const std::string &pdu) const;
+    boost::posix_time::time_duration retryDelay(unsigned attempts);
+    void                             reject    (SharedItem item);
+
+    DeliverySettings          settings;
+    SharedPduBytesQueue       recieveQ;
+    SharedPduBytesQueue       errorQ;
+    Converter                 converter;
+    std::vector<Shard>        shards;
+    size_t                    nextShard;      // where the next takeBatch() starts looking, so every shard gets its turn.
+    size_t                    inFlight;       // every shard's items, and whatever the workers are delivering.
+    size_t                    retrying;       // items back in their shard, for another attempt. "delivery.retry-depth".
+    bool                      stopping;
+    boost::mutex              mutex;
+    boost::condition_variable workAvailable;
+    boost::condition_variable spaceAvailable;
+    boost::random::mt19937    jitter;
+    boost::thread_group       workers;
+};
+
+typedef boost::shared_ptr<DeliveryPool> SharedDeliveryPool;
+
+#endif // _DELIVERY_POOL_HPP_
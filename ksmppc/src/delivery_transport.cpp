@@ -0,0 +1,271 @@
+// File  : delivery_transport.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <kisscpp/client.hpp>
+#include <kisscpp/logstream.hpp>
+#include <kisscpp/request_status.hpp>
+
+#include "log.hpp"
+#include "delivery_transport.hpp"
+
+namespace {
+  //--------------------------------------------------------------------------------
+  void setResult(const boost::system::error_code &result, boost::system::error_code *ec)
+  {
+    *ec = result;
+  }
+
+  //--------------------------------------------------------------------------------
+  void setIoResult(const boost::system::error_code &result, size_t, boost::system::error_code *ec)
+  {
+    *ec = result;
+  }
+
+  //--------------------------------------------------------------------------------
+  // What the application's kcm-sts says about one message. RQST_UNKNOWN is the
+  // application's own failure, and is worth another try. Any other failure is
+  // about the message, and would fail again. No kcm-sts at all, is no answer.
+  DeliveryTransport::Outcome outcomeOf(const BoostPtree &response)
+  {
+    boost::optional<int> status = response.get_optional<int>("kcm-sts");
+
+    if(!status || *status == kisscpp::RQST_UNKNOWN) {
+      return DeliveryTransport::RETRY;
+    }
+
+    return (*status == kisscpp::RQST_SUCCESS) ? DeliveryTransport::DELIVERED : DeliveryTransport::REJECTED;
+  }
+}
+
+//--------------------------------------------------------------------------------
+KisscppTransport::KisscppTransport(const DeliveryEndpoint &ep, unsigned timeoutMs) :
+  endpoint      (ep),
+  timeoutSeconds(std::max(1U, (timeoutMs + 999) / 1000)) // kisscpp::client counts in seconds.
+{
+}
+
+//--------------------------------------------------------------------------------
+void KisscppTransport::deliver(const std::vector<const BoostPtree*> &messages, std::vector<Outcome> &outcomes)
+{
+  outcomes.assign(messages.size(), RETRY);
+
+  for(size_t i = 0; i < messages.size(); ++i) {
+    BoostPtree request(*messages[i]);
+    BoostPtree response;
+
+    request.put("kcm-cmd", "smppin");
+    request.put("kcm-hst", endpoint.host);
+    request.put("kcm-prt", endpoint.port);
+
+    try {
+      kisscpp::client requestSender(request, &response, timeoutSeconds); // Instantiation of the kisscpp::client class, sends the message.
+      outcomes[i] = outcomeOf(response);
+    } catch(kisscpp::RetryableCommsFailure &e) {
+      KLOG(WARNING) << "Retryable comms failure: " << e.what() << kisscpp::manip::endl;
+      return; // the endpoint is down. The rest of the batch is retried with this one.
+    } catch(kisscpp::PerminantCommsFailure &e) {
+      KLOG(ERROR) << "Perminant comms failure: " << e.what() << kisscpp::manip::endl;
+      outcomes[i] = REJECTED;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+StreamTransport::StreamTransport(const DeliveryEndpoint &ep, unsigned timeoutMs) :
+  endpoint (ep),
+  timeout  (timeoutMs),
+  socket_  (io_service),
+  timer    (io_service),
+  connected(false),
+  pending  (false),
+  nextId   (0)
+{
+}
+
+//--------------------------------------------------------------------------------
+StreamTransport::~StreamTransport()
+{
+  disconnect();
+}
+
+//--------------------------------------------------------------------------------
+void StreamTransport::deliver(const std::vector<const BoostPtree*> &messages, std::vector<Outcome> &outcomes)
+{
+  outcomes.assign(messages.size(), RETRY);
+
+  if(!connected && !connect()) {
+    return;
+  }
+
+  std::ostringstream        requests;
+  unsigned long             firstId = nextId;
+  boost::system::error_code ec;
+
+  for(size_t i = 0; i < messages.size(); ++i) {
+    BoostPtree request(*messages[i]);
+
+    request.put("kcm-cmd", "smppin");
+    request.put("id"     , nextId++);
+
+    boost::property_tree::write_json(requests, request, false); // one line, newline terminated.
+  }
+
+  std::string out = requests.str();
+
+  boost::asio::async_write(socket_, boost::asio::buffer(out), boost::bind(&setIoResult, _1, _2, &ec));
+
+  if(!await(ec)) {
+    KLOG(WARNING) << "Delivery to " << endpoint.host << ":" << endpoint.port << " failed: " << ec.message() << kisscpp::manip::flush;
+    disconnect();
+    return;
+  }
+
+  for(size_t i = 0; i < messages.size(); ++i) {
+    BoostPtree  response;
+    std::string line;
+
+    boost::asio::async_read_until(socket_, responses, '\n', boost::bind(&setIoResult, _1, _2, &ec));
+
+    if(!await(ec)) {
+      KLOG(WARNING) << "No response from " << endpoint.host << ":" << endpoint.port << ": " << ec.message() << kisscpp::manip::flush;
+      disconnect(); // whatever was not answered, is retried.
+      return;
+    }
+
+    std::istream is(&responses);
+    std::getline(is, line);
+
+    try {
+      std::istringstream ls(line);
+      boost::property_tree::read_json(ls, response);
+    } catch(boost::property_tree::json_parser_error &e) {
+      KLOG(WARNING) << "Unreadable response from " << endpoint.host << ":" << endpoint.port << ": " << e.what() << kisscpp::manip::flush;
+      disconnect(); // we can no longer tell which response is whose.
+      return;
+    }
+
+    if(response.get<unsigned long>("id", firstId + i) != firstId + i) {
+      KLOG(WARNING) << "Out of order response from " << endpoint.host << ":" << endpoint.port << kisscpp::manip::flush;
+      disconnect();
+      return;
+    }
+
+    outcomes[i] = outcomeOf(response);
+  }
+}
+
+//--------------------------------------------------------------------------------
+bool StreamTransport::connect()
+{
+  kisscpp::LogStream        log(__PRETTY_FUNCTION__);
+  boost::system::error_code ec;
+  tcp::resolver             resolver(io_service);
+  tcp::resolver::iterator   i = resolver.resolve(tcp::resolver::query(endpoint.host, endpoint.port), ec);
+  tcp::resolver::iterator   end;
+
+  for(; !ec && i != end; ++i) {
+    disconnect();
+
+    ec = boost::asio::error::would_block;
+    socket_.async_connect(*i, boost::bind(&setResult, _1, &ec));
+
+    if(await(ec)) {
+      boost::asio::ip::tcp::no_delay noDelay(true);
+      socket_.set_option(noDelay, ec);
+
+      log << "Connected to " << endpoint.host << ":" << endpoint.port << kisscpp::manip::flush;
+      connected = true;
+      return true;
+    }
+  }
+
+  KLOG(WARNING) << "Could not connect to " << endpoint.host << ":" << endpoint.port << ": " << ec.message() << kisscpp::manip::flush;
+  disconnect();
+  return false;
+}
+
+//--------------------------------------------------------------------------------
+void StreamTransport::disconnect()
+{
+  boost::system::error_code ignored;
+
+  socket_.close(ignored);
+  responses.consume(responses.size());
+  connected = false;
+}
+
+//--------------------------------------------------------------------------------
+// The blocking-with-a-timeout pattern: the operation was started with a
+// handler that sets ec. A timer closes the socket if it takes too long, which
+// completes the operation with operation_aborted.
+bool StreamTransport::await(boost::system::error_code &ec)
+{
+  ec      = boost::asio::error::would_block;
+  pending = true;
+
+  timer.expires_from_now(timeout);
+  timer.async_wait(boost::bind(&StreamTransport::handle_timer, this, boost::asio::placeholders::error));
+
+  io_service.reset();
+
+  while(ec == boost::asio::error::would_block && io_service.run_one()) {
+  }
+
+  pending = false;
+
+  timer.cancel();
+  io_service.reset();
+  io_service.poll(); // the timer's handler, so it can't touch the next operation.
+
+  return !ec;
+}
+
+//--------------------------------------------------------------------------------
+void StreamTransport::handle_timer(const boost::system::error_code &error)
+{
+  if(error != boost::asio::error::operation_aborted && pending) {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  }
+}
+
+//--------------------------------------------------------------------------------
+SharedDeliveryTransport makeDeliveryTransport(const std::string      &type,
+                                              const DeliveryEndpoint &endpoint,
+                                              unsigned                timeoutMs)
+{
+  if(type == "kisscpp") {
+    return SharedDeliveryTransport(new KisscppTransport(endpoint, timeoutMs));
+  }
+
+  if(type == "stream") {
+    return SharedDeliveryTransport(new StreamTransport(endpoint, timeoutMs));
+  }
+
+  throw std::runtime_error("Unknown delivery transport: " + type);
+}
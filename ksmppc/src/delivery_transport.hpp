@@ -0,0 +1,114 @@
+// File  : delivery_transport.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _DELIVERY_TRANSPORT_HPP_
+#define _DELIVERY_TRANSPORT_HPP_
+
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <kisscpp/boost_ptree.hpp>
+
+using boost::asio::ip::tcp;
+
+//--------------------------------------------------------------------------------
+struct DeliveryEndpoint
+{
+  std::string host;
+  std::string port;
+};
+
+//--------------------------------------------------------------------------------
+// How inbound messages get to one application endpoint. Every delivery worker
+// owns a transport, so a transport is only ever used by one thread.
+class DeliveryTransport : private boost::noncopyable
+{
+  public:
+    enum Outcome {
+      DELIVERED,
+      RETRY,     // the endpoint could not be reached, did not answer in time, or answered RQST_UNKNOWN.
+      REJECTED   // the endpoint will never take this message: any other kcm-sts but RQST_SUCCESS.
+    };
+
+    virtual ~DeliveryTransport() {}
+
+    // Delivers messages as one batch. outcomes gets one Outcome per message, in order.
+    virtual void deliver(const std::vector<const BoostPtree*> &messages, std::vector<Outcome> &outcomes) = 0;
+};
+
+typedef boost::shared_ptr<DeliveryTransport> SharedDeliveryTransport;
+
+//--------------------------------------------------------------------------------
+// What ksmppcd has always done: a kisscpp::client, and so a new connection, per
+// request. Every message goes as an "smppin" request of its own, also when the
+// worker hands over a batch. For applications that can't keep a connection open.
+class KisscppTransport : public DeliveryTransport
+{
+  public:
+    KisscppTransport(const DeliveryEndpoint &endpoint, unsigned timeoutMs);
+
+    void deliver(const std::vector<const BoostPtree*> &messages, std::vector<Outcome> &outcomes);
+
+  private:
+    DeliveryEndpoint endpoint;
+    unsigned         timeoutSeconds;
+};
+
+//--------------------------------------------------------------------------------
+// One persistent connection, carrying newline delimited JSON; the same framing
+// as ksmppcd's own streaming ingest. Every message in a batch is written as an
+// "smppin" request with an "id", before any response is read. The responses
+// must come back in order, one line each, with kcm-sts. The connection is made
+// on first use, and again after any failure.
+class StreamTransport : public DeliveryTransport
+{
+  public:
+    StreamTransport(const DeliveryEndpoint &endpoint, unsigned timeoutMs);
+    ~StreamTransport();
+
+    void deliver(const std::vector<const BoostPtree*> &messages, std::vector<Outcome> &outcomes);
+
+  private:
+    bool connect      ();
+    void disconnect   ();
+    bool await        (boost::system::error_code &ec); // runs io_service until ec is set, or the timeout closes the socket.
+    void handle_timer (const boost::system::error_code &error);
+
+    DeliveryEndpoint            endpoint;
+    boost::posix_time::millisec timeout;
+    boost::asio::io_service     io_service;
+    tcp::socket                 socket_;
+    boost::asio::deadline_timer timer;
+    boost::asio::streambuf      responses;
+    bool                        connected;
+    bool                        pending;  // an operation is waiting in await().
+    unsigned long               nextId;
+};
+
+// "kisscpp" or "stream". Throws std::runtime_error for anything else.
+SharedDeliveryTransport makeDeliveryTransport(const std::string      &type,
+                                              const DeliveryEndpoint &endpoint,
+                                              unsigned                timeoutMs);
+
+#endif // _DELIVERY_TRANSPORT_HPP_
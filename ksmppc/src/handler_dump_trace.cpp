@@ -0,0 +1,42 @@
+// File  : handler_dump_trace.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "handler_dump_trace.hpp"
+
+void DumpTraceHandler::run(const BoostPtree& request, BoostPtree& response)
+{
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+  std::string fileName = request.get<std::string>("file", defaultFile);
+
+  try {
+    size_t records = TRACE_RING->dump(fileName);
+
+    log << "Dumped " << records << " PDU(s) to " << fileName << kisscpp::manip::endl;
+
+    response.put("kcm-sts", kisscpp::RQST_SUCCESS);
+    response.put("file"   , fileName);
+    response.put("records", records);
+  } catch (std::exception& e) {
+    log << "Exception: " << e.what() << kisscpp::manip::endl;
+    response.put("kcm-sts", kisscpp::RQST_UNKNOWN);
+    response.put("kcm-erm", e.what());
+  }
+}
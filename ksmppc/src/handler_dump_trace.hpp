@@ -0,0 +1,57 @@
+// File  : handler_dump_trace.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HANDLER_DUMP_TRACE_HPP_
+#define _HANDLER_DUMP_TRACE_HPP_
+
+#include <string>
+
+#include <kisscpp/logstream.hpp>
+#include <kisscpp/request_handler.hpp>
+#include <kisscpp/request_status.hpp>
+#include <kisscpp/boost_ptree.hpp>
+
+#include "cfg.hpp"
+#include "pdu_trace.hpp"
+
+// Writes a copy of the PDU trace ring to a file, for ksmppc-trace to decode.
+//   file : where to write it, defaults to pdu-trace-ring.dump-file (optional)
+class DumpTraceHandler : public kisscpp::RequestHandler
+{
+  public:
+    DumpTraceHandler() :
+      kisscpp::RequestHandler("dump-trace", "Dumps the PDU trace ring to a file.")
+    {
+      kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+      defaultFile = CFG->get<std::string>("pdu-trace-ring.dump-file", "/tmp/ksmppc.trace");
+    };
+
+    ~DumpTraceHandler() {};
+
+    void run(const BoostPtree& request, BoostPtree& response);
+
+  protected:
+
+  private:
+    std::string defaultFile;
+};
+
+#endif
@@ -18,48 +18,41 @@
 // along with the ksmppcd application.
 // If not, see <http://www.gnu.org/licenses/>.
 
+#include "log.hpp"
 #include "handler_send.hpp"
 
 void SendHandler::run(const BoostPtree& request, BoostPtree& response)
 {
-  // TODO: basic validation on the various parts of the request
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   try {
-
-    SharedPduSubmitSm  submitPDU;
-
-    submitPDU.reset(new smpp_pdu::PDU_submit_sm());
-
-    submitPDU->service_type             = request.get<std::string>("service-type"          ,"");
-    submitPDU->source_addr     .ton     = request.get<uint8_t>    ("source-addr-ton"       ,CFG->get<uint8_t>("smpp-session.default-type-of-number"));
-    submitPDU->source_addr     .npi     = request.get<uint8_t>    ("source-addr-npi"       ,CFG->get<uint8_t>("smpp-session.default-number-plan-indicator"));
-    submitPDU->source_addr     .address = request.get<std::string>("source-addr");
-    submitPDU->destination_addr.ton     = request.get<uint8_t>    ("destination-addr-ton"  ,CFG->get<uint8_t>("smpp-session.default-type-of-number"));
-    submitPDU->destination_addr.npi     = request.get<uint8_t>    ("destination-addr-npi"  ,CFG->get<uint8_t>("smpp-session.default-number-plan-indicator"));
-    submitPDU->destination_addr.address = request.get<std::string>("destination-addr");
-    submitPDU->esm_class                = request.get<uint8_t>    ("esm-class"             ,0);
-    submitPDU->protocol_id              = request.get<uint8_t>    ("protocol-id"           ,0);
-    submitPDU->priority_flag            = request.get<uint8_t>    ("priority-flag"         ,0);
-    submitPDU->schedule_delivery_time   = request.get<std::string>("schedule-delivery-time",""); // TODO: Deal with propper encoding of time here.
-    submitPDU->validity_period          = request.get<std::string>("validity-period"       ,"");
-    submitPDU->registered_delivery      = request.get<uint8_t>    ("registered-delivery"   ,3);
-    submitPDU->replace_if_present_flag  = request.get<uint8_t>    ("replace-if-presentFlag",0);
-    submitPDU->data_coding              = request.get<uint8_t>    ("data-coding"           ,3);
-    submitPDU->sm_default_msg_id        = request.get<uint8_t>    ("sm-default-msg-id"     ,0);
-    submitPDU->short_message            = request.get<std::string>("short-message");
-
-    // TODO: deal with support for TLV that overrides short-message parameter:
-    // message-payload TLV. in spec: 4.8.4.36
-
-    sendingQ->push(submitPDU);
-
+    bool          durable;
+    SubmitSmParts parts;
+
+    builder.build(request, parts, durable);
+
+    if(parts.size() == 1) {
+      if(durable || !sessions->send_fast(parts[0])) { // the fast lane skips the disk, when it has room.
+        sendingQ->push(parts[0]); // on a durable queue, returns once the message is on disk.
+      }
+    } else {
+      std::vector<SharedSmppPdu> group(parts.begin(), parts.end());
+
+      if(durable || !sessions->send_group(group)) {
+        sendingQ->push_batch(group); // next to each other. All or none on the segment backend; see PartialPushError for paged.
+      }
+      response.put("parts", parts.size());
+    }
+
+    response.put("kcm-sts", kisscpp::RQST_SUCCESS);
+  } catch (std::invalid_argument& e) {
+    response.put("kcm-sts", kisscpp::RQST_INVALID_PARAMETER);
+    response.put("kcm-erm", e.what());
+  } catch (PartialPushError& e) {
+    KLOG(ERROR) << "Exception: " << e.what() << ", after " << e.pushed << " parts" << kisscpp::manip::endl;
+    response.put("kcm-sts", kisscpp::RQST_UNKNOWN);
+    response.put("kcm-erm", "Only some parts of the message could be queued");
   } catch (std::exception& e) {
-    log << "Exception: " << e.what() << kisscpp::manip::endl;
+    KLOG(ERROR) << "Exception: " << e.what() << kisscpp::manip::endl;
     response.put("kcm-sts", kisscpp::RQST_UNKNOWN);
     response.put("kcm-erm", e.what());
   }
-
-  response.put("kcm-sts", kisscpp::RQST_SUCCESS);
 }
-
@@ -32,17 +32,29 @@
 
 #include "util.hpp"
 #include "cfg.hpp"
-#include "smpppdu_queue.hpp"
+#include "pdu_queue.hpp"
+#include "session_pool.hpp"
+#include "submit_sm_builder.hpp"
 
 class SendHandler : public kisscpp::RequestHandler
 {
   public:
-    SendHandler(SharedSafeSmppPduQ snQ) :
+    SendHandler(SharedSmppPduQueue snQ, SharedSessionPool pool) :
       kisscpp::RequestHandler("send", "Used for sending messages.")
     {
       kisscpp::LogStream log(__PRETTY_FUNCTION__);
 
       sendingQ = snQ;
+      sessions = pool;
+    };
+
+    // With a builder of its own, instead of one from the config.
+    SendHandler(SharedSmppPduQueue snQ, SharedSessionPool pool, const SubmitSmBuilder &b) :
+      kisscpp::RequestHandler("send", "Used for sending messages."),
+      builder(b)
+    {
+      sendingQ = snQ;
+      sessions = pool;
     };
 
     ~SendHandler() {};
@@ -52,7 +64,9 @@ class SendHandler : public kisscpp::RequestHandler
   protected:
 
   private:
-    SharedSafeSmppPduQ sendingQ;
+    SharedSmppPduQueue sendingQ;
+    SharedSessionPool  sessions; // for messages that need not survive a restart. See "durable" in the request.
+    SubmitSmBuilder    builder;
 };
 
 #endif
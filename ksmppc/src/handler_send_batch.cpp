@@ -0,0 +1,147 @@
+// File  : handler_send_batch.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+
+#include "log.hpp"
+#include "handler_send_batch.hpp"
+
+namespace {
+  //--------------------------------------------------------------------------------
+  // A single part goes down the fast lane. The parts of a long message go to one
+  // session together. False if they have to be queued after all.
+  bool sendNow(const SubmitSmParts &parts, SharedSessionPool sessions)
+  {
+    if(parts.size() == 1) {
+      return sessions->send_fast(parts[0]);
+    }
+
+    return sessions->send_group(std::vector<SharedSmppPdu>(parts.begin(), parts.end()));
+  }
+}
+
+//--------------------------------------------------------------------------------
+size_t submitMessages(std::vector<PendingSend> &sends,
+                      SharedSmppPduQueue        sendingQ,
+                      SharedSessionPool         sessions)
+{
+  std::vector<SharedSmppPdu> toQueue;
+  std::vector<size_t>        queuedAt; // index in sends, of each message with parts in toQueue.
+  size_t                     rejected = 0;
+
+  toQueue .reserve(sends.size());
+  queuedAt.reserve(sends.size());
+
+  for(size_t i = 0; i < sends.size(); ++i) {
+    const SubmitSmParts &parts = sends[i].parts;
+
+    if(parts.empty()) {
+      ++rejected;
+      continue;
+    }
+
+    if(!sends[i].durable && sendNow(parts, sessions)) {
+      continue;
+    }
+
+    toQueue .insert(toQueue.end(), parts.begin(), parts.end());
+    queuedAt.push_back(i);
+  }
+
+  size_t      pushed = 0; // items of toQueue that made it into the queue.
+  std::string error;
+
+  try {
+    sendingQ->push_batch(toQueue); // one sync for the lot, on a durable queue.
+    return rejected;
+  } catch(PartialPushError &e) {
+    KLOG(ERROR) << "Exception: " << e.what() << ", after " << e.pushed << " of " << toQueue.size() << kisscpp::manip::endl;
+    pushed = e.pushed;
+    error  = e.what();
+  } catch(std::exception &e) {
+    KLOG(ERROR) << "Exception: " << e.what() << kisscpp::manip::endl;
+    error = e.what();
+  }
+
+  for(size_t i = 0, first = 0; i < queuedAt.size(); ++i) {
+    PendingSend &send = sends[queuedAt[i]];
+    size_t       last = first + send.parts.size(); // send's parts are toQueue[first, last).
+
+    if(last > pushed) { // a message that was queued keeps RQST_SUCCESS. Failing it would have the client send it twice.
+      send.status = kisscpp::RQST_UNKNOWN;
+      send.error  = (first < pushed) ? "Only some parts of the message could be queued" : error;
+      ++rejected;
+    }
+
+    first = last;
+  }
+
+  return rejected;
+}
+
+//--------------------------------------------------------------------------------
+void SendBatchHandler::run(const BoostPtree& request, BoostPtree& response)
+{
+  boost::optional<const BoostPtree&> messages = request.get_child_optional("messages");
+
+  if(!messages || messages->empty()) {
+    response.put("kcm-sts", kisscpp::RQST_INVALID_PARAMETER);
+    response.put("kcm-erm", "messages must be a non empty array");
+    return;
+  }
+
+  if(messages->size() > maxMessages) {
+    response.put("kcm-sts", kisscpp::RQST_INVALID_PARAMETER);
+    response.put("kcm-erm", "Too many messages in one batch");
+    return;
+  }
+
+  std::vector<PendingSend> sends(messages->size());
+  size_t                   index = 0;
+
+  for(BoostPtree::const_iterator i = messages->begin(); i != messages->end(); ++i, ++index) {
+    try {
+      builder.build(i->second, sends[index].parts, sends[index].durable);
+    } catch(std::invalid_argument &e) {
+      sends[index].status = kisscpp::RQST_INVALID_PARAMETER;
+      sends[index].error  = e.what();
+    }
+  }
+
+  size_t rejected = submitMessages(sends, sendingQ, sessions);
+
+  response.put("kcm-sts" , kisscpp::RQST_SUCCESS);
+  response.put("accepted", sends.size() - rejected);
+  response.put("rejected", rejected);
+
+  BoostPtree &results = response.add_child("results", BoostPtree()); // filled in place: it is as long as the batch.
+
+  for(size_t i = 0; i < sends.size(); ++i) {
+    BoostPtree &result = results.push_back(std::make_pair("", BoostPtree()))->second;
+
+    result.put("kcm-sts", sends[i].status);
+
+    if(sends[i].status != kisscpp::RQST_SUCCESS) {
+      result.put("kcm-erm", sends[i].error);
+    } else if(sends[i].parts.size() > 1) {
+      result.put("parts", sends[i].parts.size());
+    }
+  }
+}
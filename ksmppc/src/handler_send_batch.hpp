@@ -0,0 +1,104 @@
+// File  : handler_send_batch.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HANDLER_SEND_BATCH_HPP_
+#define _HANDLER_SEND_BATCH_HPP_
+
+#include <string>
+#include <vector>
+
+#include <kisscpp/logstream.hpp>
+#include <kisscpp/request_handler.hpp>
+#include <kisscpp/request_status.hpp>
+#include <kisscpp/boost_ptree.hpp>
+
+#include "cfg.hpp"
+#include "pdu_queue.hpp"
+#include "session_pool.hpp"
+#include "submit_sm_builder.hpp"
+
+//--------------------------------------------------------------------------------
+// One message of a batch, between building its submit_sm and answering for it.
+struct PendingSend
+{
+  PendingSend() : durable(true), status(kisscpp::RQST_SUCCESS) {}
+
+  SubmitSmParts parts;   // empty if the message was rejected by the builder. More than one for a long message.
+  bool          durable;
+  int           status;  // kcm-sts for this message.
+  std::string   error;   // kcm-erm, if status is not RQST_SUCCESS.
+};
+
+//--------------------------------------------------------------------------------
+// Sends the non-durable messages down the fast lane where it has room, and
+// queues the rest with one push_batch(). The parts of a long message go to one
+// session together, or next to each other in the queue, so that
+// sendingProcessor() keeps them together too. Updates status and error of the ones
+// that could not be queued. Returns the number of messages rejected, counting
+// the ones the builder already rejected. Shared by send-batch and the
+// streaming ingest.
+size_t submitMessages(std::vector<PendingSend> &sends,
+                      SharedSmppPduQueue        sendingQ,
+                      SharedSessionPool         sessions);
+
+//--------------------------------------------------------------------------------
+// Sends many messages in one request.
+//   messages : an array of messages, each with the parameters of the send command.
+// The response carries accepted and rejected counts, and a results array with
+// kcm-sts (and kcm-erm on failure) for each message, in request order, and parts
+// for a message that was segmented. Valid
+// messages are queued with a single push, whatever is wrong with the others.
+class SendBatchHandler : public kisscpp::RequestHandler
+{
+  public:
+    SendBatchHandler(SharedSmppPduQueue snQ, SharedSessionPool pool) :
+      kisscpp::RequestHandler("send-batch", "Used for sending many messages at once.")
+    {
+      kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+      sendingQ    = snQ;
+      sessions    = pool;
+      maxMessages = CFG->get<unsigned int>("send-batch.max-messages", 10000);
+    };
+
+    // With a builder and limit of its own, instead of ones from the config.
+    SendBatchHandler(SharedSmppPduQueue snQ, SharedSessionPool pool, const SubmitSmBuilder &b, unsigned maxMsgs) :
+      kisscpp::RequestHandler("send-batch", "Used for sending many messages at once."),
+      builder(b)
+    {
+      sendingQ    = snQ;
+      sessions    = pool;
+      maxMessages = maxMsgs;
+    };
+
+    ~SendBatchHandler() {};
+
+    void run(const BoostPtree& request, BoostPtree& response);
+
+  protected:
+
+  private:
+    SharedSmppPduQueue sendingQ;
+    SharedSessionPool  sessions;
+    unsigned           maxMessages; // larger batches are refused as a whole.
+    SubmitSmBuilder    builder;
+};
+
+#endif
@@ -0,0 +1,60 @@
+// File  : handler_trace.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "handler_trace.hpp"
+
+void TraceHandler::run(const BoostPtree& request, BoostPtree& response)
+{
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+  boost::optional<std::string> pduTrace = request.get_optional<std::string>("pdu-trace");
+  boost::optional<std::string> logLevel = request.get_optional<std::string>("log-level");
+  int                          session  = request.get<int>("session", -1);
+
+  response.put("kcm-sts", kisscpp::RQST_SUCCESS);
+
+  if(pduTrace) {
+    if(*pduTrace != "on" && *pduTrace != "off") {
+      response.put("kcm-sts", kisscpp::RQST_INVALID_PARAMETER);
+      response.put("kcm-erm", "pdu-trace must be \"on\" or \"off\"");
+      return;
+    }
+
+    if(!sessions->setPduTrace(*pduTrace == "on", session)) {
+      response.put("kcm-sts", kisscpp::RQST_INVALID_PARAMETER);
+      response.put("kcm-erm", "No such session");
+      return;
+    }
+
+    log << "PDU trace " << *pduTrace << " for session " << session << kisscpp::manip::endl;
+  }
+
+  if(logLevel) {
+    if(!setLogLevel(*logLevel)) {
+      response.put("kcm-sts", kisscpp::RQST_INVALID_PARAMETER);
+      response.put("kcm-erm", "Unknown log-level");
+      return;
+    }
+
+    log << "Log level set to " << *logLevel << kisscpp::manip::endl;
+  }
+
+  response.put("log-level", getLogLevel());
+}
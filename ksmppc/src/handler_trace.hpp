@@ -0,0 +1,59 @@
+// File  : handler_trace.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HANDLER_TRACE_HPP_
+#define _HANDLER_TRACE_HPP_
+
+#include <string>
+
+#include <kisscpp/logstream.hpp>
+#include <kisscpp/request_handler.hpp>
+#include <kisscpp/request_status.hpp>
+#include <kisscpp/boost_ptree.hpp>
+
+#include "log.hpp"
+#include "session_pool.hpp"
+
+// Turns PDU trace mode (hex dumps of every PDU) on or off, and sets the log level, at runtime.
+//   pdu-trace : "on" or "off"                                  (optional)
+//   session   : the session to trace, every session if not set (optional)
+//   log-level : "error", "warning", "info", "debug" or "trace" (optional)
+class TraceHandler : public kisscpp::RequestHandler
+{
+  public:
+    TraceHandler(SharedSessionPool s) :
+      kisscpp::RequestHandler("trace", "Toggles PDU trace mode, and sets the log level.")
+    {
+      kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+      sessions = s;
+    };
+
+    ~TraceHandler() {};
+
+    void run(const BoostPtree& request, BoostPtree& response);
+
+  protected:
+
+  private:
+    SharedSessionPool sessions;
+};
+
+#endif
@@ -0,0 +1,364 @@
+// File  : ingest_server.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <boost/lexical_cast.hpp>
+
+#include <kisscpp/request_status.hpp>
+
+#include "log.hpp"
+
+#include "ingest_server.hpp"
+
+//--------------------------------------------------------------------------------
+IngestSettings::IngestSettings()
+{
+  address          = CFG->get<std::string> ("ingest.address"           , "0.0.0.0");
+  port             = CFG->get<unsigned int>("ingest.port"              , 0);
+  highWatermark    = CFG->get<unsigned int>("ingest.high-watermark"    , 100000);
+  highWatermark    = std::max(1U, highWatermark);    // 0 would pause ingest for good.
+  lowWatermark     = CFG->get<unsigned int>("ingest.low-watermark"     , highWatermark / 2);
+  maxLineLength    = CFG->get<unsigned int>("ingest.max-line-length"   , 65536);
+  maxPendingWrites = CFG->get<unsigned int>("ingest.max-pending-writes", 64);
+  maxPendingWrites = std::max(1U, maxPendingWrites); // 0 would never read a single request.
+
+  if(lowWatermark > highWatermark) {
+    lowWatermark = highWatermark;
+  }
+}
+
+//--------------------------------------------------------------------------------
+IngestConnection::IngestConnection(boost::asio::io_service &io_service,
+                                   const IngestSettings    &cfg,
+                                   SharedSmppPduQueue       snQ,
+                                   SharedSessionPool        pool) :
+  settings  (cfg),
+  socket_   (io_service),
+  strand    (io_service),
+  pauseTimer(io_service),
+  sendingQ  (snQ),
+  sessions  (pool),
+  reading   (false),
+  paused    (false),
+  closed    (false)
+{
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::start()
+{
+  statInc("ingest.connections");
+  strand.post(boost::bind(&IngestConnection::start_read, shared_from_this()));
+}
+
+//--------------------------------------------------------------------------------
+// Flow control lives here. Nothing is read from the client while sendingBuffer
+// is over the high watermark, or while the client is not reading its responses.
+// TCP does the rest, by filling up the client's send buffer.
+void IngestConnection::start_read()
+{
+  if(reading || closed || backlogged()) { // handle_write() calls us again, once the client catches up.
+    return;
+  }
+
+  size_t queued = sendingQ->size();
+
+  if(paused ? (queued > settings.lowWatermark) : (queued >= settings.highWatermark)) {
+    if(!paused) {
+      paused = true;
+      statInc("ingest.paused");
+    }
+
+    reading = true;
+    pauseTimer.expires_from_now(boost::posix_time::milliseconds(10));
+    pauseTimer.async_wait(strand.wrap(boost::bind(&IngestConnection::handle_pause, shared_from_this(), boost::asio::placeholders::error)));
+    return;
+  }
+
+  paused  = false;
+  reading = true;
+
+  socket_.async_read_some(boost::asio::buffer(readChunk, sizeof(readChunk)),
+                          strand.wrap(boost::bind(&IngestConnection::handle_read,
+                                                  shared_from_this(),
+                                                  boost::asio::placeholders::error,
+                                                  boost::asio::placeholders::bytes_transferred)));
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::handle_pause(const boost::system::error_code &error)
+{
+  reading = false;
+
+  if(error != boost::asio::error::operation_aborted) {
+    start_read();
+  }
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::handle_read(const boost::system::error_code &error, size_t bytesRead)
+{
+  reading = false;
+
+  if(error) {
+    close();
+    return;
+  }
+
+  inbox.append(readChunk, bytesRead);
+
+  process_lines();
+
+  if(inbox.size() > settings.maxLineLength) {
+    KLOG(WARNING) << "Ingest request longer than " << settings.maxLineLength << " bytes. Closing the connection." << kisscpp::manip::flush;
+    close();
+    return;
+  }
+
+  start_read();
+}
+
+//--------------------------------------------------------------------------------
+// Every complete line in inbox, is one request. They are all submitted
+// together, so that a durable sending queue syncs once for the lot.
+void IngestConnection::process_lines()
+{
+  std::vector<PendingSend> sends;
+  std::vector<std::string> ids;
+  size_t                   begin = 0;
+  size_t                   end;
+
+  while((end = inbox.find('\n', begin)) != std::string::npos) {
+    size_t length = end - begin;
+
+    if(length > 0 && inbox[end - 1] == '\r') {
+      --length;
+    }
+
+    if(length > 0) {
+      sends.push_back(PendingSend());
+      ids  .push_back(std::string());
+
+      try {
+        settings.builder.build(inbox.data() + begin, length, sends.back().parts, sends.back().durable, ids.back());
+      } catch(std::invalid_argument &e) {
+        sends.back().status = kisscpp::RQST_INVALID_PARAMETER;
+        sends.back().error  = e.what();
+      }
+    }
+
+    begin = end + 1;
+  }
+
+  inbox.erase(0, begin);
+
+  if(sends.empty()) {
+    return;
+  }
+
+  submitMessages(sends, sendingQ, sessions);
+
+  std::string responses;
+
+  for(size_t i = 0; i < sends.size(); ++i) {
+    appendResponse(responses, ids[i], sends[i]);
+  }
+
+  statSet("ingest.last-batch-size", sends.size());
+
+  queue_response(responses);
+}
+
+//--------------------------------------------------------------------------------
+// One line of JSON, the way write_json() would have written it.
+void IngestConnection::appendResponse(std::string &out, const std::string &id, const PendingSend &send)
+{
+  if(!id.empty()) {
+    out += "{\"id\":";
+    appendJsonString(out, id);
+    out += ',';
+  } else {
+    out += '{';
+  }
+
+  out += "\"kcm-sts\":\"";
+  out += boost::lexical_cast<std::string>(send.status);
+  out += '"';
+
+  if(send.status != kisscpp::RQST_SUCCESS) {
+    out += ",\"kcm-erm\":";
+    appendJsonString(out, send.error);
+  } else if(send.parts.size() > 1) {
+    out += ",\"parts\":\"";
+    out += boost::lexical_cast<std::string>(send.parts.size());
+    out += '"';
+  }
+
+  out += "}\n";
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::appendJsonString(std::string &out, const std::string &value)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  out += '"';
+
+  for(std::string::const_iterator i = value.begin(); i != value.end(); ++i) {
+    unsigned char c = *i;
+
+    switch(c) {
+      case '"' : out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n";  break;
+      case '\r': out += "\\r";  break;
+      case '\t': out += "\\t";  break;
+      default  :
+        if(c < 0x20) {
+          out += "\\u00";
+          out += hex[c >> 4];
+          out += hex[c & 0x0F];
+        } else {
+          out += c;
+        }
+        break;
+    }
+  }
+
+  out += '"';
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::queue_response(const std::string &response)
+{
+  writeQ.push_back(response);
+
+  if(writeQ.size() == 1) {
+    start_write();
+  }
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::start_write()
+{
+  boost::asio::async_write(socket_,
+                           boost::asio::buffer(writeQ.front()),
+                           strand.wrap(boost::bind(&IngestConnection::handle_write, shared_from_this(), boost::asio::placeholders::error)));
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::handle_write(const boost::system::error_code &error)
+{
+  if(error) {
+    close();
+    return;
+  }
+
+  writeQ.pop_front();
+
+  if(!writeQ.empty()) {
+    start_write();
+  }
+
+  start_read(); // in case we stopped reading, because of backlogged().
+}
+
+//--------------------------------------------------------------------------------
+bool IngestConnection::backlogged()
+{
+  return writeQ.size() >= settings.maxPendingWrites;
+}
+
+//--------------------------------------------------------------------------------
+void IngestConnection::close()
+{
+  if(closed) {
+    return;
+  }
+
+  boost::system::error_code ignored;
+
+  closed = true;
+  pauseTimer.cancel(ignored);
+  socket_.close(ignored);
+  statDec("ingest.connections");
+}
+
+//--------------------------------------------------------------------------------
+IngestServer::IngestServer(boost::asio::io_service &io_service,
+                           SharedSmppPduQueue       snQ,
+                           SharedSessionPool        pool) :
+  io_service_(io_service),
+  acceptor   (io_service),
+  sendingQ   (snQ),
+  sessions   (pool)
+{
+}
+
+//--------------------------------------------------------------------------------
+void IngestServer::start()
+{
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+  tcp::endpoint endpoint(boost::asio::ip::address::from_string(settings.address), settings.port);
+
+  acceptor.open      (endpoint.protocol());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+  acceptor.bind      (endpoint);
+  acceptor.listen    ();
+
+  log << "Streaming ingest on " << settings.address << ":" << settings.port << kisscpp::manip::flush;
+
+  start_accept();
+}
+
+//--------------------------------------------------------------------------------
+void IngestServer::stop()
+{
+  boost::system::error_code ignored;
+  acceptor.close(ignored);
+}
+
+//--------------------------------------------------------------------------------
+void IngestServer::start_accept()
+{
+  SharedIngestConnection connection(new IngestConnection(io_service_, settings, sendingQ, sessions));
+
+  acceptor.async_accept(connection->socket(),
+                        boost::bind(&IngestServer::handle_accept, this, connection, boost::asio::placeholders::error));
+}
+
+//--------------------------------------------------------------------------------
+void IngestServer::handle_accept(SharedIngestConnection connection, const boost::system::error_code &error)
+{
+  if(error == boost::asio::error::operation_aborted) { // stop()
+    return;
+  }
+
+  if(!error) {
+    connection->start();
+  } else {
+    KLOG(WARNING) << "Ingest accept failed: " << error.message() << kisscpp::manip::flush;
+  }
+
+  start_accept();
+}
+
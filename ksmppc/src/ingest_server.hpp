@@ -0,0 +1,139 @@
+// File  : ingest_server.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _INGEST_SERVER_HPP_
+#define _INGEST_SERVER_HPP_
+
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <kisscpp/logstream.hpp>
+#include <kisscpp/boost_ptree.hpp>
+
+#include "cfg.hpp"
+#include "stat.hpp"
+#include "pdu_queue.hpp"
+#include "session_pool.hpp"
+#include "submit_sm_builder.hpp"
+#include "handler_send_batch.hpp"
+
+using boost::asio::ip::tcp;
+
+//--------------------------------------------------------------------------------
+// Settings for the streaming ingest, from the "ingest" config section.
+struct IngestSettings
+{
+  IngestSettings();
+
+  std::string address;
+  unsigned    port;             // 0: no streaming ingest.
+  unsigned    highWatermark;    // stop reading from clients once sendingBuffer holds this many messages,
+  unsigned    lowWatermark;     // and carry on once it is down to this many.
+  unsigned    maxLineLength;    // a longer request closes the connection.
+  unsigned    maxPendingWrites; // stop reading from a client that does not read its responses.
+
+  SubmitSmBuilder builder;      // shared by every connection.
+};
+
+//--------------------------------------------------------------------------------
+// One long lived client connection. Every line the client sends is a JSON
+// object with the parameters of the send command, and an optional "id". Every
+// line it gets back is a JSON object with that id, kcm-sts, and kcm-erm on
+// failure. Requests may be pipelined: everything that arrived in one read is
+// built straight from the JSON text, without a ptree, and queued together, with
+// a single push to the sending queue. Responses are written in request order.
+class IngestConnection : public boost::enable_shared_from_this<IngestConnection>,
+                         private boost::noncopyable
+{
+  public:
+    IngestConnection(boost::asio::io_service &io_service,
+                     const IngestSettings    &settings,
+                     SharedSmppPduQueue       snQ,
+                     SharedSessionPool        pool);
+
+    tcp::socket &socket() { return socket_; }
+    void         start ();
+
+  private:
+    void        start_read    ();
+    void        handle_read   (const boost::system::error_code &error, size_t bytesRead);
+    void        handle_pause  (const boost::system::error_code &error);
+    void        process_lines ();
+    void        queue_response(const std::string &response);
+    void        start_write   ();
+    void        handle_write  (const boost::system::error_code &error);
+    void        close         ();
+    bool        backlogged    ();
+
+    static void appendResponse  (std::string &out, const std::string &id, const PendingSend &send);
+    static void appendJsonString(std::string &out, const std::string &value);
+
+    const IngestSettings            &settings;
+    tcp::socket                      socket_;
+    boost::asio::io_service::strand  strand;
+    boost::asio::deadline_timer      pauseTimer;
+    SharedSmppPduQueue               sendingQ;
+    SharedSessionPool                sessions;
+    char                             readChunk[8192];
+    std::string                      inbox;            // what was read, but is not a complete line yet.
+    std::deque<std::string>          writeQ;           // responses, in request order. The front one is being written.
+    bool                             reading;          // a read, or a pause, is outstanding.
+    bool                             paused;           // waiting for sendingBuffer to drain to the low watermark.
+    bool                             closed;
+};
+
+typedef boost::shared_ptr<IngestConnection> SharedIngestConnection;
+
+//--------------------------------------------------------------------------------
+// Accepts streaming ingest connections. Runs on whatever threads run the
+// io_service it was given; each connection is strand protected.
+class IngestServer : private boost::noncopyable
+{
+  public:
+    IngestServer(boost::asio::io_service &io_service,
+                 SharedSmppPduQueue       snQ,
+                 SharedSessionPool        pool);
+    ~IngestServer() {};
+
+    bool enabled() const { return settings.port != 0; }
+    void start  ();
+    void stop   ();
+
+  private:
+    void start_accept ();
+    void handle_accept(SharedIngestConnection connection, const boost::system::error_code &error);
+
+    boost::asio::io_service &io_service_;
+    IngestSettings           settings;
+    tcp::acceptor            acceptor;
+    SharedSmppPduQueue       sendingQ;
+    SharedSessionPool        sessions;
+};
+
+typedef boost::shared_ptr<IngestServer> SharedIngestServer;
+
+#endif // _INGEST_SERVER_HPP_
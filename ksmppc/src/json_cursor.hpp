@@ -0,0 +1,284 @@
+// File  : json_cursor.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _JSON_CURSOR_HPP_
+#define _JSON_CURSOR_HPP_
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+//--------------------------------------------------------------------------------
+// Just enough of a JSON reader, for one flat request object. Strings are
+// unescaped into a buffer the caller keeps reusing. Throws
+// std::invalid_argument, "Invalid JSON: ...", on anything it can not read.
+class JsonCursor
+{
+  public:
+    JsonCursor(const char *json, size_t length) : p(json), end(json + length) {}
+
+    bool atEnd() { skipSpace(); return p == end; }
+
+    bool next(char c)
+    {
+      skipSpace();
+
+      if(p != end && *p == c) {
+        ++p;
+        return true;
+      }
+
+      return false;
+    }
+
+    void expect(char c)
+    {
+      if(!next(c)) {
+        fail("expected '" + std::string(1, c) + "'");
+      }
+    }
+
+    //--------------------------------------------------------------------------------
+    // A string, number, true, false or null, as text. Objects and arrays are skipped, and give "".
+    void value(std::string &out)
+    {
+      skipSpace();
+      out.clear();
+
+      if(p == end) {
+        fail("expected a value");
+      }
+
+      if(*p == '"') {
+        string(out);
+      } else if(*p == '{' || *p == '[') {
+        skipNested();
+      } else {
+        const char *start = p;
+
+        while(p != end && *p != ',' && *p != '}' && *p != ']' && !isSpace(*p)) {
+          ++p;
+        }
+
+        if(!isLiteral(start, p)) {
+          fail("expected a value");
+        }
+
+        if(!(p - start == 4 && std::memcmp(start, "null", 4) == 0)) {
+          out.assign(start, p);
+        }
+      }
+    }
+
+    //--------------------------------------------------------------------------------
+    void string(std::string &out)
+    {
+      skipSpace();
+      out.clear();
+
+      if(p == end || *p != '"') {
+        fail("expected a string");
+      }
+
+      ++p;
+
+      for(;;) {
+        const char *run = p; // copy runs without escapes in one go.
+
+        while(p != end && *p != '"' && *p != '\\') {
+          ++p;
+        }
+
+        out.append(run, p);
+
+        if(p == end) {
+          fail("unterminated string");
+        }
+
+        if(*p++ == '"') {
+          return;
+        }
+
+        if(p == end) {
+          fail("unterminated string");
+        }
+
+        switch(*p++) {
+          case '"' : out += '"';  break;
+          case '\\': out += '\\'; break;
+          case '/' : out += '/';  break;
+          case 'b' : out += '\b'; break;
+          case 'f' : out += '\f'; break;
+          case 'n' : out += '\n'; break;
+          case 'r' : out += '\r'; break;
+          case 't' : out += '\t'; break;
+          case 'u' : codePoint(out); break;
+          default  : fail("invalid escape");
+        }
+      }
+    }
+
+  private:
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skipSpace()
+    {
+      while(p != end && isSpace(*p)) {
+        ++p;
+      }
+    }
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    //--------------------------------------------------------------------------------
+    // true, false, null, or a number: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    static bool isLiteral(const char *s, const char *e)
+    {
+      size_t n = e - s;
+
+      if((n == 4 && std::memcmp(s, "true", 4) == 0) || (n == 5 && std::memcmp(s, "false", 5) == 0) || (n == 4 && std::memcmp(s, "null", 4) == 0)) {
+        return true;
+      }
+
+      if(s != e && *s == '-') { ++s; }
+
+      if(s == e || !isDigit(*s)) { return false; }
+      if(*s == '0')              { ++s; }
+      else                       { while(s != e && isDigit(*s)) { ++s; } }
+
+      if(s != e && *s == '.') {
+        if(++s == e || !isDigit(*s)) { return false; }
+        while(s != e && isDigit(*s)) { ++s; }
+      }
+
+      if(s != e && (*s == 'e' || *s == 'E')) {
+        ++s;
+        if(s != e && (*s == '+' || *s == '-')) { ++s; }
+        if(s == e || !isDigit(*s))             { return false; }
+        while(s != e && isDigit(*s))           { ++s; }
+      }
+
+      return s == e;
+    }
+
+    //--------------------------------------------------------------------------------
+    // Only the strings and the brackets are checked; what is between them is not looked at.
+    void skipNested()
+    {
+      std::string ignored;
+      std::string closers; // what each open bracket wants, innermost last.
+
+      while(p != end) {
+        switch(*p) {
+          case '"': string(ignored); continue;
+          case '{': closers += '}'; break;
+          case '[': closers += ']'; break;
+          case '}':
+          case ']':
+            if(*p != closers[closers.size() - 1]) {
+              fail("mismatched brackets");
+            }
+
+            closers.erase(closers.size() - 1);
+
+            if(closers.empty()) {
+              ++p;
+              return;
+            }
+            break;
+          default : break;
+        }
+        ++p;
+      }
+
+      fail("unterminated object or array");
+    }
+
+    //--------------------------------------------------------------------------------
+    unsigned hex4()
+    {
+      unsigned result = 0;
+
+      for(int i = 0; i < 4; ++i, ++p) {
+        if(p == end) {
+          fail("unterminated string");
+        }
+
+        char c = *p;
+
+        result <<= 4;
+
+        if     (c >= '0' && c <= '9') { result |= c - '0';      }
+        else if(c >= 'a' && c <= 'f') { result |= c - 'a' + 10; }
+        else if(c >= 'A' && c <= 'F') { result |= c - 'A' + 10; }
+        else                          { fail("invalid \\u escape"); }
+      }
+
+      return result;
+    }
+
+    //--------------------------------------------------------------------------------
+    // A unicode escape, and its low surrogate if it has one, as UTF-8. The same bytes read_json() gives.
+    void codePoint(std::string &out)
+    {
+      unsigned cp = hex4();
+
+      if(cp >= 0xD800 && cp <= 0xDBFF) {
+        if(end - p < 6 || p[0] != '\\' || p[1] != 'u') {
+          fail("invalid surrogate pair");
+        }
+
+        p += 2;
+
+        unsigned low = hex4();
+
+        if(low < 0xDC00 || low > 0xDFFF) {
+          fail("invalid surrogate pair");
+        }
+
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+      } else if(cp >= 0xDC00 && cp <= 0xDFFF) {
+        fail("invalid surrogate pair");
+      }
+
+      if(cp < 0x80) {
+        out += (char)cp;
+      } else if(cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+      } else if(cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+      } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+      }
+    }
+
+    void fail(const std::string &why) { throw std::invalid_argument("Invalid JSON: " + why); }
+
+    const char *p;
+    const char *end;
+};
+
+#endif // _JSON_CURSOR_HPP_
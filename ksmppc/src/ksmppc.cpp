@@ -24,13 +24,19 @@
 ksmppc::ksmppc(const std::string &instance,
                const bool        &runAsDaemon) :
   Server(1, "ksmppc", instance, runAsDaemon),
-  running(true)
+  running(true),
+  consumerBatchSize(std::max(1U, CFG->get<unsigned int>("queues.consumer-batch-size", 32)))
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  if(!setLogLevel(CFG->get<std::string>("ksmppc-log.level", "info"))) {
+    KLOG(WARNING) << "Unknown ksmppc-log.level, using " << getLogLevel() << kisscpp::manip::endl;
+  }
 
   constructQueues();
+  startTraceRing();
   startSessions();
   registerHandlers();
+  startIngest();
+  startDelivery();
 
   threadGroup.create_thread(boost::bind(&ksmppc::recieveProcessor, this));
   threadGroup.create_thread(boost::bind(&ksmppc::sendingProcessor, this));
@@ -39,22 +45,27 @@ ksmppc::ksmppc(const std::string &instance,
 //--------------------------------------------------------------------------------
 ksmppc::~ksmppc()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   running = false;
   stop();
-  session->stop();
+  sessions->stop();
+
+  if(ingest) {
+    ingest->stop();
+  }
+  ingestIoService.stop();
+
+  sendingBuffer->interrupt(); // release the processor threads, if they are waiting.
+  recieveBuffer->interrupt();
+  delivery->stop();           // and before recieveProcessor() can stop, whatever it is waiting to submit.
   threadGroup.join_all();
 }
 
 //--------------------------------------------------------------------------------
 void ksmppc::constructQueues()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  sendingBuffer.reset(new SafeSmppPduQ("sendingBuffer", "/tmp", 10)); // TODO: The working direcory needs to be obtained from the Config file.
-  recieveBuffer.reset(new SafeSmppPduQ("recieveBuffer", "/tmp", 10));
-  rcv_errBuffer.reset(new SafeSmppPduQ("rcv_errBuffer", "/tmp", 10));
+  sendingBuffer = makeSmppPduQueue ("sendingBuffer"); // backend and directory come from the "queues" config section.
+  recieveBuffer = makePduBytesQueue("recieveBuffer");
+  rcv_errBuffer = makePduBytesQueue("rcv_errBuffer");
 
   statQue("queues.sending",sendingBuffer);
   statQue("queues.recieve",recieveBuffer);
@@ -64,54 +75,115 @@ void ksmppc::constructQueues()
 //--------------------------------------------------------------------------------
 void ksmppc::registerHandlers()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   if(makeBindType(CFG->get<std::string>("smpp-session.bind-type")) != RX) { // conditional creation of send handler. i.e. If we only recieve, no sending can take place.
-    sendHandler.reset(new SendHandler(sendingBuffer));
+    sendHandler.reset(new SendHandler(sendingBuffer, sessions));
     register_handler(sendHandler);
+
+    sendBatchHandler.reset(new SendBatchHandler(sendingBuffer, sessions));
+    register_handler(sendBatchHandler);
+  }
+
+  traceHandler.reset(new TraceHandler(sessions));
+  register_handler(traceHandler);
+
+  dumpTraceHandler.reset(new DumpTraceHandler());
+  register_handler(dumpTraceHandler);
+}
+
+//--------------------------------------------------------------------------------
+void ksmppc::startTraceRing()
+{
+  unsigned    slots     = CFG->get<unsigned int>("pdu-trace-ring.slots"     , 4096);
+  unsigned    slotSize  = CFG->get<unsigned int>("pdu-trace-ring.slot-size" , 256);
+  std::string fileName  = CFG->get<std::string> ("pdu-trace-ring.file"      , "");
+  std::string crashFile = CFG->get<std::string> ("pdu-trace-ring.crash-file", "");
+
+  if(slots == 0) {
+    KLOG(INFO) << "PDU trace ring disabled." << kisscpp::manip::endl;
+    return;
+  }
+
+  try {
+    TRACE_RING->open(slots, slotSize, fileName);
+  } catch(std::runtime_error &e) {
+    KLOG(WARNING) << e.what() << ". Keeping the PDU trace ring in memory instead." << kisscpp::manip::endl;
+    TRACE_RING->open(slots, slotSize);
+  }
+
+  if(!crashFile.empty()) {
+    TRACE_RING->dumpOnCrash(crashFile);
   }
 }
 
 //--------------------------------------------------------------------------------
 void ksmppc::startSessions()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  unsigned ioThreads = CFG->get<unsigned int>("smpp-session.io-threads", 1); // sessions are strand protected, any number will do.
+
+  if(ioThreads < 1) {
+    ioThreads = 1;
+  }
 
-  session.reset(new SessionManager(sessionIoService, recieveBuffer));
-  threadGroup.create_thread(boost::bind(&boost::asio::io_service::run, &sessionIoService));
+  sessions.reset(new SessionPool(sessionIoService, recieveBuffer, sendingBuffer));
+
+  KLOG(INFO) << "Running sessions on " << ioThreads << " thread(s)." << kisscpp::manip::flush;
+
+  for(unsigned i = 0; i < ioThreads; ++i) {
+    threadGroup.create_thread(boost::bind(&boost::asio::io_service::run, &sessionIoService));
+  }
 }
 
 //--------------------------------------------------------------------------------
+// The streaming ingest: long lived connections, carrying newline delimited send
+// requests. Off unless ingest.port is set, and never for a reciever only bind.
+void ksmppc::startIngest()
+{
+  if(makeBindType(CFG->get<std::string>("smpp-session.bind-type")) == RX) {
+    return;
+  }
+
+  ingest.reset(new IngestServer(ingestIoService, sendingBuffer, sessions));
+
+  if(!ingest->enabled()) {
+    ingest.reset();
+    return;
+  }
+
+  unsigned ioThreads = std::max(1U, CFG->get<unsigned int>("ingest.io-threads", 1));
+
+  ingest->start();
+
+  for(unsigned i = 0; i < ioThreads; ++i) {
+    threadGroup.create_thread(boost::bind(&boost::asio::io_service::run, &ingestIoService));
+  }
+}
+
+//--------------------------------------------------------------------------------
+void ksmppc::startDelivery()
+{
+  delivery.reset(new DeliveryPool(recieveBuffer, rcv_errBuffer, boost::bind(&ksmppc::smpp2ptree, this, _1, _2)));
+  delivery->start();
+}
+
+//--------------------------------------------------------------------------------
+// Only moves PDUs from recieveBuffer to their shard in the delivery pool. The
+// pool's workers convert and deliver them, in parallel. See DeliveryPool.
 void ksmppc::recieveProcessor()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  std::vector<SharedPduBytes>        batch;
+  std::vector<PduBytesQueue::Ticket> tickets;
 
   while(running) {
-    if(recieveBuffer->empty()) {
-      sleep(1); // yes, sleep(1), not yield or sleep(0). sleep(1)!
-                // spinning threads that do nothing but consume CPU are bad in the real world.
-                // Any suggestions around avoiding this would be welcomed.
-    } else {
-      SharedSmppPdu pdu = recieveBuffer->pop();
-
-      try {
-        BoostPtree request;
-        BoostPtree response;
-
-        smpp2ptree(pdu, request);
-
-        request.put("kcm-cmd", "smppin");
-        request.put("kcm-hst", "localhost");
-        request.put("kcm-prt", "9100");
-
-        kisscpp::client requestSender(request, &response, 5); // Instantiation of the kisscpp::client class, sends the message.
-
-      } catch(kisscpp::RetryableCommsFailure &e) {
-        log << "Retryable comms failure: " << e.what() << kisscpp::manip::endl;
-        recieveBuffer->push(pdu);
-      } catch(kisscpp::PerminantCommsFailure &e) {
-        log << "Perminant comms failure: " << e.what() << kisscpp::manip::endl;
-        rcv_errBuffer->push(pdu);
+    batch  .clear();
+    tickets.clear();
+
+    recieveBuffer->pop_batch(batch, tickets, consumerBatchSize, 1000); // returns as soon as something arrives, or on shutdown.
+
+    for(size_t i = 0; i < batch.size(); ++i) {
+      // Blocks while delivery.max-in-flight messages are on their way. false on
+      // shutdown: a message with a ticket is still in recieveBuffer then.
+      if(!delivery->submit(batch[i], tickets[i]) && !tickets[i]) {
+        recieveBuffer->push(batch[i]);
       }
     }
   }
@@ -120,62 +192,96 @@ void ksmppc::recieveProcessor()
 //--------------------------------------------------------------------------------
 void ksmppc::sendingProcessor()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  std::vector<SharedSmppPdu> batch;
 
   while(running) {
-    if(sendingBuffer->empty()) {
-      sleep(1); // yes, sleep(1), not yield or sleep(0); sleep(1)!
-                // spinning threads that do nothing but consume CPU are bad in the real world.
-                // Any suggestions around avoiding this would be welcomed.
-    } else {
-      boost::shared_ptr<smpp_pdu::SMPP_PDU> pdu = sendingBuffer->pop();
-      if(pdu) {
-        session->send_pdu(pdu);
+    if(!sessions->wait_available(1000)) { // nothing may leave sendingBuffer, before there is a bind to take it.
+      continue;
+    }
+
+    batch.clear();
+
+    sendingBuffer->pop_batch(batch, consumerBatchSize, 1000);
+
+    for(size_t i = 0; i < batch.size(); ) {
+      ConcatInfo first;
+
+      if(!concatInfo(batch[i], first) || first.total < 2) {
+        if(!sessions->send_pdu(batch[i])) { // the session we picked was lost in the meantime.
+          sendingBuffer->push(batch[i]);
+        }
+        ++i;
+        continue;
+      }
+
+      // The parts of a long message were queued next to each other: push_batch() lets no other push in
+      // between, on either backend, and this is the only thread popping. They go to one session together.
+      std::vector<SharedSmppPdu> group(1, batch[i]);
+      ConcatInfo                 next;
+
+      while(group.size() < first.total) {
+        if(i + group.size() == batch.size()) { // the rest of the message did not fit this batch.
+          SharedSmppPdu more = sendingBuffer->pop_wait(100);
+
+          if(!more) {
+            break;
+          }
+          batch.push_back(more);
+        }
+
+        const SharedSmppPdu &candidate = batch[i + group.size()];
+
+        if(!concatInfo(candidate, next) || next.reference != first.reference || next.total != first.total) {
+          break;
+        }
+        group.push_back(candidate);
       }
+
+      if(!sessions->send_group(group)) {
+        sendingBuffer->push_batch(group);
+      }
+      i += group.size();
     }
   }
 }
 
 //--------------------------------------------------------------------------------
-void ksmppc::smpp2ptree(SharedSmppPdu pdu, BoostPtree &pt)
+void ksmppc::smpp2ptree(SharedPduBytes pdu, BoostPtree &pt)
 {
-  kisscpp::LogStream     log(__PRETTY_FUNCTION__);
-  smpp_pdu::CommandId cmdid = pdu->command_id;
+  if(pdu->size() < 16) { // not even a PDU header.
+    return;
+  }
 
-  switch(cmdid.value()) {
-    case smpp_pdu::CommandId::DataSm               : dataSm2Ptree   (pdu, pt); break;
-    case smpp_pdu::CommandId::DeliverSm            : deliverSm2Ptree(pdu, pt); break;
+  switch(smpp_pdu::get_command_id(reinterpret_cast<const uint8_t *>(pdu->data()))) {
+    case smpp_pdu::CommandId::DataSm               : dataSm2Ptree   (pdu                , pt); break;
+    case smpp_pdu::CommandId::DeliverSm            : deliverSm2Ptree(DeliverSmView(*pdu), pt); break;
     default                                            : /*TODO: Throw some kind of error*/ break;
   }
 
 }
 
 //--------------------------------------------------------------------------------
-void ksmppc::dataSm2Ptree(SharedSmppPdu pdu, BoostPtree &pt)
+void ksmppc::dataSm2Ptree(SharedPduBytes pdu, BoostPtree &pt)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
   /*not implemented yet*/
 }
 
 //--------------------------------------------------------------------------------
-void ksmppc::deliverSm2Ptree(SharedSmppPdu pdu, BoostPtree &pt)
+// Only reads the fields it forwards. Nothing here needs a decoded PDU_deliver_sm.
+void ksmppc::deliverSm2Ptree(const DeliverSmView &view, BoostPtree &pt)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  SharedPduDeliverSm tpdu = boost::dynamic_pointer_cast<smpp_pdu::PDU_deliver_sm>(pdu);
-
-  pt.put("service-type"           , tpdu->service_type            .data());
-  pt.put("source-addr"            , tpdu->source_addr.address     .data());
-  pt.put("destination-addr"       , tpdu->destination_addr.address.data());
-  pt.put("esm-class"              , tpdu->esm_class               .data());
-  pt.put("protocol-id"            , tpdu->protocol_id             .data());
-  pt.put("priority-flag"          , tpdu->priority_flag           .data());
-  pt.put("schedule-delivery-time" , tpdu->schedule_delivery_time  .data());
-  pt.put("validity-period"        , tpdu->validity_period         .data());
-  pt.put("registered-delivery"    , tpdu->registered_delivery     .data());
-  pt.put("replace-if-present-flag", tpdu->replace_if_present_flag .data());
-  pt.put("data-coding"            , tpdu->data_coding             .data());
-  pt.put("sm-default-msg-id"      , tpdu->sm_default_msg_id       .data());
-  pt.put("short-message"          , tpdu->short_message           .data());
+  pt.put("service-type"           , view.serviceType         ());
+  pt.put("source-addr"            , view.sourceAddr          ());
+  pt.put("destination-addr"       , view.destinationAddr     ());
+  pt.put("esm-class"              , (unsigned)view.esmClass            ());
+  pt.put("protocol-id"            , (unsigned)view.protocolId          ());
+  pt.put("priority-flag"          , (unsigned)view.priorityFlag        ());
+  pt.put("schedule-delivery-time" , view.scheduleDeliveryTime());
+  pt.put("validity-period"        , view.validityPeriod      ());
+  pt.put("registered-delivery"    , (unsigned)view.registeredDelivery  ());
+  pt.put("replace-if-present-flag", (unsigned)view.replaceIfPresentFlag());
+  pt.put("data-coding"            , (unsigned)view.dataCoding          ());
+  pt.put("sm-default-msg-id"      , (unsigned)view.smDefaultMsgId      ());
+  pt.put("short-message"          , view.message             ());
 }
 
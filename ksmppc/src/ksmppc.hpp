@@ -21,11 +21,11 @@
 #ifndef _KSMPPC_HPP_
 #define _KSMPPC_HPP_
 
+#include <algorithm>
 #include <boost/thread.hpp>
 #include <smpppdu_all.hpp>
 
 #include <kisscpp/server.hpp>
-#include <kisscpp/client.hpp>
 #include <kisscpp/ptree_queue.hpp>
 #include <kisscpp/logstream.hpp>
 
@@ -33,8 +33,17 @@
 #include "stat.hpp"
 #include "util.hpp"
 #include "session_manager.hpp"
+#include "session_pool.hpp"
 #include "handler_send.hpp"
-#include "smpppdu_queue.hpp"
+#include "handler_send_batch.hpp"
+#include "handler_trace.hpp"
+#include "ingest_server.hpp"
+#include "delivery_pool.hpp"
+#include "handler_dump_trace.hpp"
+#include "pdu_trace.hpp"
+#include "pdu_queue.hpp"
+#include "deliver_sm_view.hpp"
+#include "message_segmenter.hpp"
 
 // ----------------------- TODO: -----------------------------
 //*- Gnu automake implementation
@@ -62,7 +71,7 @@
 // - Allow submit_multi_sm if config sais that MC supports it.
 // - Allow data_sm if config sais that MC supports it.
 // - Messaging:
-//   -- Multi-Part messages. i.e. Messages exceeding 160 characters.
+//*  -- Multi-Part messages. i.e. Messages exceeding 160 characters.
 //   -- Binary SMS sending & recieving. 
 //*- SMPP_PDU something funky with the message creation. ---: Testing show's it's sorted. Keep it in mind though.
 // - Handlers;
@@ -75,8 +84,6 @@
 // - deb generation
 // - rpm generation
 
-typedef boost::shared_ptr<SessionManager>   SharedSession;
-
 class ksmppc : public kisscpp::Server
 {
   public:
@@ -87,24 +94,34 @@ class ksmppc : public kisscpp::Server
   protected:
     void constructQueues();
     void registerHandlers();
+    void startTraceRing();
     void startSessions();
+    void startIngest();
+    void startDelivery();
     void startThreads();
     void recieveProcessor();
     void sendingProcessor();
 
-    void smpp2ptree     (SharedSmppPdu pdu, BoostPtree &pt);
-    void dataSm2Ptree   (SharedSmppPdu pdu, BoostPtree &pt);
-    void deliverSm2Ptree(SharedSmppPdu pdu, BoostPtree &pt);
+    void smpp2ptree     (SharedPduBytes       pdu , BoostPtree &pt);
+    void dataSm2Ptree   (SharedPduBytes       pdu , BoostPtree &pt);
+    void deliverSm2Ptree(const DeliverSmView &view, BoostPtree &pt);
 
   private:
-    SharedSafeSmppPduQ          sendingBuffer;
-    SharedSafeSmppPduQ          recieveBuffer;
-    SharedSafeSmppPduQ          rcv_errBuffer; //Recieving-error buffer. Perminant comms failures go here
-    SharedSession               session;
+    SharedSmppPduQueue          sendingBuffer;
+    SharedPduBytesQueue         recieveBuffer;
+    SharedPduBytesQueue         rcv_errBuffer; //Recieving-error buffer. Perminant comms failures go here
+    SharedSessionPool           sessions;
+    SharedIngestServer          ingest;
+    SharedDeliveryPool          delivery;
     bool                        running;
+    unsigned                    consumerBatchSize; // max items a processor thread takes from its queue per wake up.
     kisscpp::RequestHandlerPtr  sendHandler;
+    kisscpp::RequestHandlerPtr  sendBatchHandler;
+    kisscpp::RequestHandlerPtr  traceHandler;
+    kisscpp::RequestHandlerPtr  dumpTraceHandler;
     boost::asio::io_service     sessionIoService;
     boost::asio::io_service     clientIoService;
+    boost::asio::io_service     ingestIoService;
     boost::thread_group         threadGroup;
 };
 
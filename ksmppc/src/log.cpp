@@ -0,0 +1,45 @@
+// File  : log.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "log.hpp"
+
+boost::atomic<int> runtimeLogLevel(KLOG_LEVEL_INFO);
+
+//--------------------------------------------------------------------------------
+static const char *levelNames[] = { "error", "warning", "info", "debug", "trace" };
+
+//--------------------------------------------------------------------------------
+bool setLogLevel(const std::string &levelName)
+{
+  for(int i = KLOG_LEVEL_ERROR; i <= KLOG_LEVEL_TRACE; ++i) {
+    if(levelName == levelNames[i]) {
+      runtimeLogLevel = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------------------
+std::string getLogLevel()
+{
+  return levelNames[runtimeLogLevel.load()];
+}
@@ -0,0 +1,62 @@
+// File  : log.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _LOG_HPP_
+#define _LOG_HPP_
+
+#include <string>
+
+#include <boost/atomic.hpp>
+
+#include <kisscpp/logstream.hpp>
+
+//--------------------------------------------------------------------------------
+// Leveled logging on top of kisscpp::LogStream.
+//
+//   KLOG(DEBUG) << "posting PDU to txQ." << kisscpp::manip::flush;
+//
+// A disabled level costs a single branch: no LogStream is constructed and none
+// of the << operands are evaluated. Levels above KLOG_MAX_LEVEL are compiled
+// out altogether, e.g. ./configure CPPFLAGS=-DKLOG_MAX_LEVEL=KLOG_LEVEL_INFO
+// Below that, the level is set at runtime through "ksmppc-log.level".
+#define KLOG_LEVEL_ERROR   0
+#define KLOG_LEVEL_WARNING 1
+#define KLOG_LEVEL_INFO    2
+#define KLOG_LEVEL_DEBUG   3
+#define KLOG_LEVEL_TRACE   4
+
+#ifndef KLOG_MAX_LEVEL
+#define KLOG_MAX_LEVEL     KLOG_LEVEL_TRACE
+#endif
+
+extern boost::atomic<int> runtimeLogLevel;
+
+bool        setLogLevel (const std::string &levelName); // "error", "warning", "info", "debug" or "trace". false if unknown.
+std::string getLogLevel ();
+
+inline bool logLevelEnabled(int level)
+{
+  return (level <= KLOG_MAX_LEVEL && level <= runtimeLogLevel.load(boost::memory_order_relaxed));
+}
+
+#define KLOG_ENABLED(level) (logLevelEnabled(KLOG_LEVEL_##level))
+#define KLOG(level)         if(!KLOG_ENABLED(level)) {} else kisscpp::LogStream(__PRETTY_FUNCTION__)
+
+#endif // _LOG_HPP_
@@ -0,0 +1,312 @@
+// File  : message_segmenter.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <ctime>
+#include <stdexcept>
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include "message_segmenter.hpp"
+
+namespace {
+  const uint8_t  UDHI            = 0x40;  // esm_class: short_message starts with a user data header.
+  const uint8_t  IEI_CONCAT_8    = 0x00;  // concatenated short messages, 8 bit reference.
+  const uint8_t  IEI_CONCAT_16   = 0x08;  // concatenated short messages, 16 bit reference.
+  const size_t   MAX_SM_LENGTH   = 254;   // sm_length is a single octet.
+  const size_t   SINGLE_SEPTETS  = 160;
+  const size_t   SINGLE_OCTETS   = 140;
+
+  //--------------------------------------------------------------------------------
+  // Characters from the GSM 03.38 extension table, that take an escape septet as well.
+  bool gsmExtended(uint8_t c)
+  {
+    switch(c) {
+      case '^': case '{': case '}': case '\\': case '[': case '~': case ']': case '|': return true;
+      default : return false;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+ConcatReferences *ConcatReferences::instance()
+{
+  static ConcatReferences refs;
+  return &refs;
+}
+
+//--------------------------------------------------------------------------------
+// Random starting points, so that references handed out before a restart are
+// not handed out again right after it.
+ConcatReferences::ConcatReferences()
+{
+  boost::random::mt19937 generator(static_cast<uint32_t>(time(NULL)) ^ static_cast<uint32_t>(getpid()));
+
+  for(size_t i = 0; i < SLOTS; ++i) {
+    counters[i].store(static_cast<uint16_t>(generator()), boost::memory_order_relaxed);
+  }
+}
+
+//--------------------------------------------------------------------------------
+uint16_t ConcatReferences::next(const std::string &destination)
+{
+  uint32_t hash = 2166136261U; // FNV-1a
+
+  for(std::string::const_iterator i = destination.begin(); i != destination.end(); ++i) {
+    hash ^= (uint8_t)*i;
+    hash *= 16777619U;
+  }
+
+  return counters[hash % SLOTS].fetch_add(1, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------
+// Only PDUs with UDHI set get looked at, and then only the UDH at the start of
+// short_message.
+bool concatInfo(const SharedSmppPdu &pdu, ConcatInfo &info)
+{
+  SharedPduSubmitSm submit = boost::dynamic_pointer_cast<smpp_pdu::PDU_submit_sm>(pdu);
+
+  if(!submit || !submit->esm_class.bits_set(UDHI)) {
+    return false;
+  }
+
+  std::string sm     = (std::string)submit->short_message;
+  size_t      udhEnd = sm.empty() ? 0 : 1 + (uint8_t)sm[0];
+
+  if(udhEnd > sm.size()) {
+    return false;
+  }
+
+  for(size_t p = 1; p + 2 <= udhEnd; p += 2 + (uint8_t)sm[p + 1]) {
+    uint8_t iei    = sm[p];
+    size_t  length = (uint8_t)sm[p + 1];
+
+    if(p + 2 + length > udhEnd) {
+      return false;
+    }
+
+    if(iei == IEI_CONCAT_8 && length == 3) {
+      info.reference = (uint8_t)sm[p + 2];
+      info.total     = sm[p + 3];
+      info.sequence  = sm[p + 4];
+      return (info.total > 0);
+    }
+
+    if(iei == IEI_CONCAT_16 && length == 4) {
+      info.reference = ((uint8_t)sm[p + 2] << 8) | (uint8_t)sm[p + 3];
+      info.total     = sm[p + 4];
+      info.sequence  = sm[p + 5];
+      return (info.total > 0);
+    }
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------------------
+MessageSegmenter::MessageSegmenter()
+{
+  configure(CFG->get<unsigned int>("segmentation.reference-bits", 8),
+            CFG->get<unsigned int>("segmentation.max-parts"     , 16));
+}
+
+//--------------------------------------------------------------------------------
+MessageSegmenter::MessageSegmenter(unsigned referenceBits, unsigned partsAllowed)
+{
+  configure(referenceBits, partsAllowed);
+}
+
+//--------------------------------------------------------------------------------
+void MessageSegmenter::configure(unsigned referenceBits, unsigned partsAllowed)
+{
+  sixteenBit = (referenceBits == 16);
+  maxParts   = partsAllowed;
+
+  if(maxParts < 1 || maxParts > 255) { // the UDH counts parts in one octet.
+    maxParts = 255;
+  }
+}
+
+//--------------------------------------------------------------------------------
+MessageSegmenter::Alphabet MessageSegmenter::alphabetOf(uint8_t dataCoding)
+{
+  if((dataCoding & 0xF0) == 0xF0) {                  // data coding/message class group.
+    return (dataCoding & 0x04) ? OCTETS : GSM7;
+  }
+
+  if((dataCoding & 0xC0) == 0x00 && dataCoding >= 0x10) { // general data coding group, with a message class.
+    switch((dataCoding >> 2) & 0x03) {
+      case 0 : return GSM7;
+      case 2 : return UCS2;
+      default: return OCTETS;
+    }
+  }
+
+  switch(dataCoding) {
+    case 0 : // MC default alphabet
+    case 1 : return GSM7;  // IA5
+    case 8 : return UCS2;
+    default: return OCTETS;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// The octets of text, from at, that must stay together. cost gets what they take
+// up on the air interface: septets for GSM7, octets otherwise.
+size_t MessageSegmenter::unitLength(Alphabet alphabet, const std::string &text, size_t at, size_t &cost)
+{
+  size_t  left = text.size() - at;
+  uint8_t c    = text[at];
+
+  switch(alphabet) {
+    case GSM7:
+      if(c == 0x1B && left > 1) {               // an escape the caller already encoded.
+        cost = 2;
+        return 2;
+      }
+
+      if(c < 0x80) {
+        cost = gsmExtended(c) ? 2 : 1;
+        return 1;
+      }
+
+      // Not GSM or ASCII, so it is taken as UTF-8, which the MC converts. Keep a
+      // sequence together. The euro sign is in the extension table.
+      cost = (left >= 3 && c == 0xE2 && (uint8_t)text[at + 1] == 0x82 && (uint8_t)text[at + 2] == 0xAC) ? 2 : 1;
+
+      if((c & 0xE0) == 0xC0) { return std::min<size_t>(2, left); }
+      if((c & 0xF0) == 0xE0) { return std::min<size_t>(3, left); }
+      if((c & 0xF8) == 0xF0) { return std::min<size_t>(4, left); }
+      return 1;
+
+    case UCS2:
+      if((c & 0xFC) == 0xD8 && left >= 4) {     // high surrogate; keep its pair.
+        cost = 4;
+        return 4;
+      }
+      cost = 2;
+      return 2;
+
+    default:
+      cost = 1;
+      return 1;
+  }
+}
+
+//--------------------------------------------------------------------------------
+size_t MessageSegmenter::capacity(Alphabet alphabet, size_t udhLength)
+{
+  switch(alphabet) {
+    case GSM7: return SINGLE_SEPTETS - (udhLength * 8 + 6) / 7; // the UDH is padded to a septet boundary.
+    case UCS2: return (SINGLE_OCTETS - udhLength) & ~(size_t)1;
+    default  : return SINGLE_OCTETS - udhLength;
+  }
+}
+
+//--------------------------------------------------------------------------------
+void MessageSegmenter::segment(const smpp_pdu::PDU_submit_sm  &base,
+                               uint8_t                         esmClass,
+                               uint8_t                         dataCoding,
+                               const std::string              &destination,
+                               const std::string              &text,
+                               std::vector<SharedPduSubmitSm> &parts) const
+{
+  Alphabet alphabet = alphabetOf(dataCoding);
+
+  parts.clear();
+
+  if(alphabet == UCS2 && (text.size() % 2) != 0) {
+    throw std::invalid_argument("short-message is not UCS2: odd number of octets");
+  }
+
+  size_t total = 0;
+
+  for(size_t at = 0, cost; at < text.size(); total += cost) {
+    at += unitLength(alphabet, text, at, cost);
+  }
+
+  // A UDH from the caller, or a message that fits as it is.
+  if((esmClass & UDHI) || (total <= capacity(alphabet, 0) && text.size() <= MAX_SM_LENGTH)) {
+    if(text.size() > MAX_SM_LENGTH) {
+      throw std::invalid_argument("short-message is longer than 254 octets");
+    }
+
+    SharedPduSubmitSm pdu(new smpp_pdu::PDU_submit_sm(base));
+    pdu->short_message = text;
+    parts.push_back(pdu);
+    return;
+  }
+
+  size_t                   udhLength = sixteenBit ? 7 : 6;
+  size_t                   room      = capacity(alphabet, udhLength);
+  std::vector<std::string> pieces;
+  size_t                   start     = 0;
+  size_t                   used      = 0;
+
+  for(size_t at = 0; at < text.size(); ) {
+    size_t cost;
+    size_t length = unitLength(alphabet, text, at, cost);
+
+    if(used + cost > room || (at + length - start) > MAX_SM_LENGTH - udhLength) {
+      pieces.push_back(text.substr(start, at - start));
+      start = at;
+      used  = 0;
+    }
+
+    used += cost;
+    at   += length;
+  }
+
+  pieces.push_back(text.substr(start));
+
+  if(pieces.size() > maxParts) {
+    throw std::invalid_argument("short-message needs " + boost::lexical_cast<std::string>(pieces.size()) +
+                                " parts, more than segmentation.max-parts");
+  }
+
+  uint16_t    reference = CONCAT_REFS->next(destination);
+  std::string udh;
+
+  if(sixteenBit) {
+    udh += (char)0x06;
+    udh += (char)IEI_CONCAT_16;
+    udh += (char)0x04;
+    udh += (char)(reference >> 8);
+    udh += (char)(reference & 0xFF);
+  } else {
+    udh += (char)0x05;
+    udh += (char)IEI_CONCAT_8;
+    udh += (char)0x03;
+    udh += (char)(reference & 0xFF);
+  }
+
+  udh += (char)pieces.size();
+
+  for(size_t i = 0; i < pieces.size(); ++i) {
+    SharedPduSubmitSm pdu(new smpp_pdu::PDU_submit_sm(base));
+
+    pdu->esm_class     = (uint8_t)(esmClass | UDHI);
+    pdu->short_message = udh + (char)(i + 1) + pieces[i];
+
+    parts.push_back(pdu);
+  }
+}
@@ -0,0 +1,109 @@
+// File  : message_segmenter.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _MESSAGE_SEGMENTER_HPP_
+#define _MESSAGE_SEGMENTER_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <smpppdu_all.hpp>
+
+#include "cfg.hpp"
+#include "sharedsmpppdu.hpp"
+#include "smpppdu_queue.hpp"
+
+//--------------------------------------------------------------------------------
+// Concatenation reference numbers, per destination. The same destination gets
+// consecutive references, so two long messages to one handset never share one
+// while both may still be in flight. Destinations are hashed into a fixed table
+// of counters; destinations that share a counter still never see a reference
+// repeat, before the counter wraps.
+class ConcatReferences : private boost::noncopyable
+{
+  public:
+    static ConcatReferences *instance();
+
+    uint16_t next(const std::string &destination); // the caller masks it to 8 bits, for 8 bit references.
+
+  private:
+    ConcatReferences();
+    ~ConcatReferences() {}
+
+    enum { SLOTS = 4096 };
+
+    boost::atomic<uint16_t> counters[SLOTS];
+};
+
+#define CONCAT_REFS ConcatReferences::instance()
+
+//--------------------------------------------------------------------------------
+// What the concatenation UDH of a message part says.
+struct ConcatInfo
+{
+  uint16_t reference;
+  uint8_t  total;
+  uint8_t  sequence;  // 1 based.
+};
+
+// False if pdu is not a submit_sm, or has no concatenation information element in its UDH.
+bool concatInfo(const SharedSmppPdu &pdu, ConcatInfo &info);
+
+//--------------------------------------------------------------------------------
+// Splits a message that does not fit one submit_sm into parts, with a
+// concatenation UDH in each, by the limits of its data_coding:
+//   GSM 7 bit (data_coding 0 and 1) : 160 septets, 153 per part (152 with 16 bit references).
+//                                     Escaped characters count 2, and are never split.
+//   UCS2      (data_coding 8)       : 140 octets, 134 per part (132). Never splits a surrogate pair.
+//   anything else                   : 140 octets, 134 per part (133).
+// The segmentation config section sets reference-bits (8 or 16) and max-parts.
+class MessageSegmenter
+{
+  public:
+    MessageSegmenter();                                      // from the segmentation config section.
+    MessageSegmenter(unsigned referenceBits, unsigned partsAllowed);
+
+    // base has every field but short_message set. parts gets one submit_sm if text
+    // fits in one. Throws std::invalid_argument if it needs more than max-parts.
+    void segment(const smpp_pdu::PDU_submit_sm        &base,
+                 uint8_t                               esmClass,
+                 uint8_t                               dataCoding,
+                 const std::string                    &destination,
+                 const std::string                    &text,
+                 std::vector<SharedPduSubmitSm>       &parts) const;
+
+  private:
+    enum Alphabet { GSM7, OCTETS, UCS2 };
+
+    static Alphabet alphabetOf(uint8_t dataCoding);
+    static size_t   unitLength(Alphabet alphabet, const std::string &text, size_t at, size_t &cost);
+    static size_t   capacity  (Alphabet alphabet, size_t udhLength);
+
+    void            configure (unsigned referenceBits, unsigned partsAllowed);
+
+    bool     sixteenBit; // reference size.
+    unsigned maxParts;
+};
+
+#endif // _MESSAGE_SEGMENTER_HPP_
@@ -0,0 +1,137 @@
+// File  : mpsc_ring.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _MPSC_RING_HPP_
+#define _MPSC_RING_HPP_
+
+#include <cstddef>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+//--------------------------------------------------------------------------------
+// Bounded, lock free queue, for any number of producers and one consumer at a
+// time. Every cell carries a sequence number, that tells a producer whether the
+// cell is free for the lap it is on, and the consumer whether it was filled.
+// Producers only contend on the compare-exchange of the enqueue position.
+//
+// "One consumer at a time" is all that's needed; e.g. whatever runs on a strand.
+template <class T>
+class MpscRing : private boost::noncopyable
+{
+  public:
+    explicit MpscRing(size_t requestedCapacity) :
+      cells     (NULL),
+      mask      (0),
+      enqueuePos(0),
+      dequeuePos(0)
+    {
+      size_t cap = 2;
+
+      while(cap < requestedCapacity) {
+        cap <<= 1;
+      }
+
+      cells = new Cell[cap];
+      mask  = cap - 1;
+
+      for(size_t i = 0; i < cap; ++i) {
+        cells[i].sequence.store(i, boost::memory_order_relaxed);
+      }
+    }
+
+    ~MpscRing() { delete [] cells; }
+
+    //--------------------------------------------------------------------------------
+    // Any thread. False if the ring is full.
+    bool push(const T &item)
+    {
+      size_t pos = enqueuePos.load(boost::memory_order_relaxed);
+      Cell  *cell;
+
+      for(;;) {
+        cell = &cells[pos & mask];
+
+        intptr_t dif = (intptr_t)cell->sequence.load(boost::memory_order_acquire) - (intptr_t)pos;
+
+        if(dif == 0) {
+          if(enqueuePos.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) {
+            break;
+          }
+        } else if(dif < 0) {
+          return false; // the consumer has not emptied this cell since the last lap.
+        } else {
+          pos = enqueuePos.load(boost::memory_order_relaxed); // another producer took it.
+        }
+      }
+
+      cell->data = item;
+      cell->sequence.store(pos + 1, boost::memory_order_release);
+
+      return true;
+    }
+
+    //--------------------------------------------------------------------------------
+    // The consumer only. False if the ring is empty.
+    bool pop(T &item)
+    {
+      size_t pos  = dequeuePos.load(boost::memory_order_relaxed);
+      Cell  *cell = &cells[pos & mask];
+
+      if((intptr_t)cell->sequence.load(boost::memory_order_acquire) - (intptr_t)(pos + 1) < 0) {
+        return false;
+      }
+
+      item       = cell->data;
+      cell->data = T(); // don't keep the item alive until the next lap.
+      cell->sequence.store(pos + mask + 1, boost::memory_order_release);
+      dequeuePos.store(pos + 1, boost::memory_order_relaxed);
+
+      return true;
+    }
+
+    // Approximate, when called while producers are busy.
+    size_t size() const
+    {
+      size_t e = enqueuePos.load(boost::memory_order_relaxed);
+      size_t d = dequeuePos.load(boost::memory_order_relaxed);
+      return (e > d) ? (e - d) : 0;
+    }
+
+    bool   empty   () const { return size() == 0; }
+    size_t capacity() const { return mask + 1;    }
+
+  private:
+    struct Cell
+    {
+      boost::atomic<size_t> sequence;
+      T                     data;
+    };
+
+    Cell                  *cells;
+    size_t                 mask;
+    char                   pad0[64];   // keep the producers' and the consumer's positions on separate cache lines.
+    boost::atomic<size_t>  enqueuePos;
+    char                   pad1[64];
+    boost::atomic<size_t>  dequeuePos;
+};
+
+#endif // _MPSC_RING_HPP_
@@ -0,0 +1,93 @@
+// File  : pdu_queue.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdexcept>
+
+#include <kisscpp/logstream.hpp>
+
+#include "cfg.hpp"
+#include "pdu_queue.hpp"
+
+namespace {
+  //--------------------------------------------------------------------------------
+  // Settings for one queue. Anything not set for the queue itself, falls back
+  // to "queues.<setting>", and then to the built in default.
+  struct QueueSettings
+  {
+    explicit QueueSettings(const std::string &name)
+    {
+      std::string key = "queues." + name + ".";
+
+      directory    = CFG->get<std::string> (key + "directory"       , CFG->get<std::string> ("queues.directory"       , "/tmp"));
+      backend      = CFG->get<std::string> (key + "backend"         , CFG->get<std::string> ("queues.backend"         , "paged"));
+      itemsPerPage = CFG->get<unsigned int>(key + "page-size"       , CFG->get<unsigned int>("queues.page-size"       , 10));
+      segmentSize  = CFG->get<unsigned int>(key + "segment-size"    , CFG->get<unsigned int>("queues.segment-size"    , 16 * 1024 * 1024));
+      durable      = CFG->get<bool>        (key + "durable"         , CFG->get<bool>        ("queues.durable"         , false));
+      windowUs     = CFG->get<unsigned int>(key + "commit-window-us", CFG->get<unsigned int>("queues.commit-window-us", 1000));
+      maxBatch     = CFG->get<unsigned int>(key + "commit-max-batch", CFG->get<unsigned int>("queues.commit-max-batch", 64));
+
+      if(backend != "paged" && backend != "segment") {
+        throw std::runtime_error("Unknown backend for queue " + name + ": " + backend);
+      }
+
+      kisscpp::LogStream log(__PRETTY_FUNCTION__);
+      log << "Queue " << name << ": " << backend << " backend, in " << directory << kisscpp::manip::flush;
+
+      if(durable && !segmented()) {
+        log << "Queue " << name << ": durable is only honoured by the segment backend." << kisscpp::manip::endl;
+      }
+    }
+
+    bool segmented() const { return backend == "segment"; }
+
+    std::string directory;
+    std::string backend;
+    unsigned    itemsPerPage;
+    unsigned    segmentSize;
+    bool        durable;     // push() returns once the item is on disk. See SegmentLog.
+    unsigned    windowUs;
+    unsigned    maxBatch;
+  };
+}
+
+//--------------------------------------------------------------------------------
+SharedSmppPduQueue makeSmppPduQueue(const std::string &name)
+{
+  QueueSettings s(name);
+
+  if(s.segmented()) {
+    return SharedSmppPduQueue(new SegmentPduQueue<smpp_pdu::SMPP_PDU, SmppPduWireCodec>(name, s.directory, s.segmentSize, s.durable, s.windowUs, s.maxBatch));
+  }
+
+  return SharedSmppPduQueue(new PagedPduQueue<smpp_pdu::SMPP_PDU, SmppPduBase64Bicoder>(name, s.directory, s.itemsPerPage));
+}
+
+//--------------------------------------------------------------------------------
+SharedPduBytesQueue makePduBytesQueue(const std::string &name)
+{
+  QueueSettings s(name);
+
+  if(s.segmented()) {
+    return SharedPduBytesQueue(new SegmentPduQueue<std::string, PduBytesWireCodec>(name, s.directory, s.segmentSize, s.durable, s.windowUs, s.maxBatch));
+  }
+
+  return SharedPduBytesQueue(new PagedPduQueue<std::string, PduBytesBase64Bicoder>(name, s.directory, s.itemsPerPage));
+}
+
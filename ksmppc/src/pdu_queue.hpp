@@ -0,0 +1,344 @@
+// File  : pdu_queue.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _PDU_QUEUE_HPP_
+#define _PDU_QUEUE_HPP_
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "smpppdu_queue.hpp"
+#include "segment_log.hpp"
+
+//--------------------------------------------------------------------------------
+// Thrown by push_batch(), when the first pushed items were queued, and the rest not.
+class PartialPushError : public std::runtime_error
+{
+  public:
+    PartialPushError(const std::string &what, size_t count) : std::runtime_error(what), pushed(count) {}
+
+    size_t pushed;
+};
+
+//--------------------------------------------------------------------------------
+// The persisted, thread safe FIFO every application level buffer is built on.
+// Which backend sits behind it, is chosen per queue. See makeSmppPduQueue().
+//
+// Consumers block in pop_wait() or pop_batch(), and are woken by the next
+// push(), instead of polling empty().
+//
+// The ticketed pop_batch() lets a consumer keep what it took on disk, until it
+// calls done(), so a crash in between doesn't lose it. Only the segment backend
+// can do that. The paged one hands out ticket 0, and its items are gone from
+// disk as soon as they are popped.
+template <class T>
+class PduQueue
+{
+  public:
+    typedef SegmentLog::Ticket Ticket; // 0: nothing to be done() with.
+
+    PduQueue() : interrupted(false) {}
+    virtual ~PduQueue() {}
+
+    //--------------------------------------------------------------------------------
+    // Throws if a durable queue could not persist the item.
+    void push(boost::shared_ptr<T> item)
+    {
+      doPush(item);
+
+      boost::mutex::scoped_lock lock(waitMutex); // a waiter is either still checking, or already waiting. Not in between.
+      itemPushed.notify_one();
+    }
+
+    //--------------------------------------------------------------------------------
+    // The items go in in order, with no other push in between. On a durable
+    // queue they share one sync. Throws PartialPushError if only some of them
+    // were queued (the paged backend can't take them back), and any other
+    // exception if none were.
+    void push_batch(const std::vector<boost::shared_ptr<T> > &items)
+    {
+      if(items.empty()) {
+        return;
+      }
+
+      try {
+        doPushBatch(items);
+      } catch(PartialPushError &) {
+        boost::mutex::scoped_lock lock(waitMutex);
+        itemPushed.notify_all();
+        throw;
+      }
+
+      boost::mutex::scoped_lock lock(waitMutex);
+      itemPushed.notify_all();
+    }
+
+    boost::shared_ptr<T> pop  () { return doPop(NULL); } // an empty pointer if there is nothing to pop.
+    bool                 empty() { return doEmpty(); }
+    size_t               size () { return doSize();  }
+
+    //--------------------------------------------------------------------------------
+    // Waits up to timeoutMs for an item. An empty pointer on timeout, or once interrupt() was called.
+    boost::shared_ptr<T> pop_wait(unsigned timeoutMs)
+    {
+      return waitPop(timeoutMs, NULL);
+    }
+
+    //--------------------------------------------------------------------------------
+    // Waits like pop_wait() for the first item, then takes whatever else is
+    // ready, up to maxItems in all, without waiting again. Returns the number of items added to batch.
+    size_t pop_batch(std::vector<boost::shared_ptr<T> > &batch, size_t maxItems, unsigned timeoutMs)
+    {
+      return popBatch(batch, NULL, maxItems, timeoutMs);
+    }
+
+    //--------------------------------------------------------------------------------
+    // The same, with a ticket per item in tickets. Each item stays on disk
+    // until done() is called with its ticket, and is popped again after a
+    // restart if that never happens.
+    size_t pop_batch(std::vector<boost::shared_ptr<T> > &batch, std::vector<Ticket> &tickets, size_t maxItems, unsigned timeoutMs)
+    {
+      return popBatch(batch, &tickets, maxItems, timeoutMs);
+    }
+
+    void done(Ticket ticket)
+    {
+      if(ticket) {
+        doDone(ticket);
+      }
+    }
+
+    //--------------------------------------------------------------------------------
+    // Releases every waiting consumer, and makes later waits return at once. For shutdown.
+    void interrupt()
+    {
+      boost::mutex::scoped_lock lock(waitMutex);
+      interrupted = true;
+      itemPushed.notify_all();
+    }
+
+  protected:
+    //--------------------------------------------------------------------------------
+    // Backends that can do better than one push per item, override this.
+    virtual void doPushBatch(const std::vector<boost::shared_ptr<T> > &items)
+    {
+      for(size_t i = 0; i < items.size(); ++i) {
+        try {
+          doPush(items[i]);
+        } catch(std::exception &e) {
+          rethrowPartial(e, i);
+        }
+      }
+    }
+
+    //--------------------------------------------------------------------------------
+    // From a catch block, for a batch whose first pushed items are already queued.
+    static void rethrowPartial(const std::exception &e, size_t pushed)
+    {
+      if(pushed == 0) {
+        throw;
+      }
+      throw PartialPushError(e.what(), pushed);
+    }
+
+    virtual void                 doDone (Ticket)                    {}
+
+    virtual void                 doPush (boost::shared_ptr<T> item) = 0;
+    virtual boost::shared_ptr<T> doPop  (Ticket *ticket)            = 0; // only sets ticket, if it is not NULL.
+    virtual bool                 doEmpty()                          = 0;
+    virtual size_t               doSize ()                          = 0;
+
+  private:
+    //--------------------------------------------------------------------------------
+    boost::shared_ptr<T> waitPop(unsigned timeoutMs, Ticket *ticket)
+    {
+      boost::system_time        deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMs);
+      boost::mutex::scoped_lock lock(waitMutex);
+      boost::shared_ptr<T>      item;
+
+      while(!interrupted && !(item = doPop(ticket))) {
+        if(!itemPushed.timed_wait(lock, deadline)) {
+          return doPop(ticket);
+        }
+      }
+
+      return item;
+    }
+
+    //--------------------------------------------------------------------------------
+    size_t popBatch(std::vector<boost::shared_ptr<T> > &batch, std::vector<Ticket> *tickets, size_t maxItems, unsigned timeoutMs)
+    {
+      Ticket               ticket = 0;
+      boost::shared_ptr<T> item   = waitPop(timeoutMs, tickets ? &ticket : NULL);
+      size_t               count  = 0;
+
+      while(item) {
+        batch.push_back(item);
+
+        if(tickets) {
+          tickets->push_back(ticket);
+        }
+
+        if(++count >= maxItems) {
+          break;
+        }
+
+        item = doPop(tickets ? &ticket : NULL);
+      }
+
+      return count;
+    }
+
+    boost::mutex              waitMutex;
+    boost::condition_variable itemPushed;
+    bool                      interrupted;
+};
+
+//--------------------------------------------------------------------------------
+// kisscpp's paged queue: base64 encoded items, in page files.
+template <class T, class Bicoder>
+class PagedPduQueue : public PduQueue<T>
+{
+  public:
+    PagedPduQueue(const std::string &name, const std::string &directory, unsigned itemsPerPage) :
+      queue(name, directory, itemsPerPage) {}
+
+  protected:
+    //--------------------------------------------------------------------------------
+    // pushMutex keeps a single push from landing between the items of a batch.
+    void doPush(boost::shared_ptr<T> item)
+    {
+      boost::mutex::scoped_lock lock(pushMutex);
+      queue.push(item);
+    }
+
+    //--------------------------------------------------------------------------------
+    // One item at a time, so not all or none: see PartialPushError.
+    void doPushBatch(const std::vector<boost::shared_ptr<T> > &items)
+    {
+      boost::mutex::scoped_lock lock(pushMutex);
+
+      for(size_t i = 0; i < items.size(); ++i) {
+        try {
+          queue.push(items[i]);
+        } catch(std::exception &e) {
+          PduQueue<T>::rethrowPartial(e, i);
+        }
+      }
+    }
+
+    //--------------------------------------------------------------------------------
+    boost::shared_ptr<T> doPop(typename PduQueue<T>::Ticket *ticket)
+    {
+      if(ticket) {
+        *ticket = 0;
+      }
+      return queue.pop();
+    }
+
+    bool                 doEmpty()                          { return queue.empty(); }
+    size_t               doSize ()                          { return queue.size();  }
+
+  private:
+    kisscpp::ThreadsafePersistedQueue<T, Bicoder> queue;
+    boost::mutex                                  pushMutex;
+};
+
+//--------------------------------------------------------------------------------
+// Wire format items, in a SegmentLog. No base64, and no page files.
+template <class T, class Codec>
+class SegmentPduQueue : public PduQueue<T>
+{
+  public:
+    SegmentPduQueue(const std::string &name,
+                    const std::string &directory,
+                    size_t             segmentSize,
+                    bool               durable        = false,
+                    unsigned           commitWindowUs = 1000,
+                    unsigned           commitMaxBatch = 64) :
+      log(name, directory, segmentSize, durable, commitWindowUs, commitMaxBatch) {}
+
+  protected:
+    void doPush(boost::shared_ptr<T> item)
+    {
+      std::string wire = Codec::encode(item);
+      log.append(wire.data(), wire.size());
+    }
+
+    void doPushBatch(const std::vector<boost::shared_ptr<T> > &items)
+    {
+      std::vector<std::string> wire(items.size());
+
+      for(size_t i = 0; i < items.size(); ++i) {
+        wire[i] = Codec::encode(items[i]);
+      }
+
+      log.append(wire);
+    }
+
+    boost::shared_ptr<T> doPop(SegmentLog::Ticket *ticket)
+    {
+      std::string wire;
+      return log.pop(wire, ticket) ? Codec::decode(wire) : boost::shared_ptr<T>();
+    }
+
+    void doDone(SegmentLog::Ticket ticket) { log.done(ticket); }
+
+    bool   doEmpty() { return log.empty(); }
+    size_t doSize () { return log.size();  }
+
+  private:
+    SegmentLog log;
+};
+
+//--------------------------------------------------------------------------------
+struct SmppPduWireCodec
+{
+  static std::string                           encode(boost::shared_ptr<smpp_pdu::SMPP_PDU> pdu) { return pdu->encode();             }
+  static boost::shared_ptr<smpp_pdu::SMPP_PDU> decode(const std::string &wire)                    { return smppPduFromWire(wire.c_str()); }
+};
+
+//--------------------------------------------------------------------------------
+struct PduBytesWireCodec
+{
+  static std::string                    encode(boost::shared_ptr<std::string> bytes) { return *bytes; }
+  static boost::shared_ptr<std::string> decode(const std::string &wire)              { return boost::make_shared<std::string>(wire); }
+};
+
+typedef PduQueue<smpp_pdu::SMPP_PDU>     SmppPduQueue;
+typedef boost::shared_ptr<SmppPduQueue>  SharedSmppPduQueue;
+
+typedef PduQueue<std::string>            PduBytesQueue;
+typedef boost::shared_ptr<PduBytesQueue> SharedPduBytesQueue;
+
+// Both read "queues.<name>.backend" ("paged" or "segment") and the settings that go with it.
+SharedSmppPduQueue  makeSmppPduQueue (const std::string &name);
+SharedPduBytesQueue makePduBytesQueue(const std::string &name);
+
+#endif // _PDU_QUEUE_HPP_
+
@@ -0,0 +1,279 @@
+// File  : pdu_trace.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+
+#include <new>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <climits>
+#include <ctime>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pdu_trace.hpp"
+
+static const char    traceMagic[8] = { 'K', 'S', 'M', 'P', 'P', 'T', 'R', '1' };
+static const size_t  headerSize    = (sizeof(PduTraceRing::Header) + 7) & ~(size_t)7;
+
+static char          crashFile[PATH_MAX]; // set by dumpOnCrash(), used from the signal handler.
+static PduTraceRing *crashRing = NULL;
+
+//--------------------------------------------------------------------------------
+static int64_t clockNs(clockid_t clk)
+{
+  struct timespec ts;
+  clock_gettime(clk, &ts);
+  return ((int64_t)ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+//--------------------------------------------------------------------------------
+PduTraceRing *PduTraceRing::instance()
+{
+  static PduTraceRing ring;
+  return &ring;
+}
+
+//--------------------------------------------------------------------------------
+PduTraceRing::~PduTraceRing()
+{
+  if(mapped) {
+    munmap(header, mappedSize);
+  } else {
+    delete [] reinterpret_cast<uint8_t*>(header);
+  }
+}
+
+//--------------------------------------------------------------------------------
+void PduTraceRing::open(unsigned slotCount, unsigned slotSize, const std::string &fileName)
+{
+  if(header) {
+    throw std::runtime_error("PDU trace ring is already open");
+  }
+
+  slotSize = std::min<unsigned>(slotSize, 0xFFFF); // SlotHeader::captured is 16 bits.
+
+  uint32_t count      = 1;
+  uint32_t recordSize = (sizeof(SlotHeader) + slotSize + 7) & ~7U;
+
+  while(count < slotCount) {
+    count <<= 1;
+  }
+
+  size_t   total  = headerSize + ((size_t)count * recordSize); // ringSize(), before there is a header.
+  uint8_t *memory = NULL;
+
+  if(fileName.empty()) {
+    memory = new uint8_t[total];
+  } else {
+    std::string previous = fileName + ".prev"; // keep what the last run recorded, it may be why we were restarted.
+    rename(fileName.c_str(), previous.c_str());
+
+    int fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(fd < 0 || ftruncate(fd, total) != 0) {
+      if(fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("Could not create PDU trace file: " + fileName);
+    }
+
+    void *m = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(m == MAP_FAILED) {
+      throw std::runtime_error("Could not map PDU trace file: " + fileName);
+    }
+
+    memory     = static_cast<uint8_t*>(m);
+    mapped     = true;
+    mappedSize = total;
+  }
+
+  memset(memory, 0, total);
+
+  Header *h = new (memory) Header;
+
+  memcpy(h->magic, traceMagic, sizeof(traceMagic));
+  h->version          = 1;
+  h->slotCount        = count;
+  h->slotSize         = slotSize;
+  h->recordSize       = recordSize;
+  h->realtimeOffsetNs = clockNs(CLOCK_REALTIME) - clockNs(CLOCK_MONOTONIC);
+  h->next.store(0);
+
+  for(uint32_t i = 0; i < count; ++i) {
+    new (memory + headerSize + ((size_t)i * recordSize)) SlotHeader;
+  }
+
+  header = h;
+}
+
+//--------------------------------------------------------------------------------
+void PduTraceRing::write_record(Direction direction, uint32_t sessionId, const uint8_t *pdu, size_t length)
+{
+  uint64_t    n        = header->next.fetch_add(1, boost::memory_order_relaxed);
+  SlotHeader *slot     = slotAt(reinterpret_cast<uint8_t*>(header), n);
+  size_t      captured = (length < header->slotSize) ? length : header->slotSize;
+
+  slot->stamp.store(0, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+
+  slot->monotonicNs = clockNs(CLOCK_MONOTONIC);
+  slot->sessionId   = sessionId;
+  slot->length      = length;
+  slot->captured    = captured;
+  slot->direction   = direction;
+  memcpy(reinterpret_cast<uint8_t*>(slot + 1), pdu, captured);
+
+  slot->stamp.store(n + 1, boost::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------
+size_t PduTraceRing::dump(const std::string &fileName)
+{
+  if(!header) {
+    throw std::runtime_error("PDU trace ring is not open");
+  }
+
+  std::string tmpName = fileName + ".tmp";
+  FILE       *f       = fopen(tmpName.c_str(), "wb");
+
+  if(!f) {
+    throw std::runtime_error("Could not create PDU trace dump: " + fileName);
+  }
+
+  std::vector<uint8_t> buffer(headerSize > header->recordSize ? headerSize : header->recordSize, 0);
+  Header              *h       = new (&buffer[0]) Header;
+  size_t               records = 0;
+  bool                 ok      = true;
+
+  memcpy(h->magic, header->magic, sizeof(h->magic));
+  h->version          = header->version;
+  h->slotCount        = header->slotCount;
+  h->slotSize         = header->slotSize;
+  h->recordSize       = header->recordSize;
+  h->realtimeOffsetNs = header->realtimeOffsetNs;
+  h->next.store(header->next.load());
+
+  ok = (fwrite(&buffer[0], headerSize, 1, f) == 1);
+
+  for(uint32_t i = 0; ok && i < header->slotCount; ++i) {
+    SlotHeader *slot   = slotAt(reinterpret_cast<uint8_t*>(header), i);
+    uint64_t    before = slot->stamp.load(boost::memory_order_acquire);
+
+    memcpy(&buffer[0], slot, header->recordSize);
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+
+    uint64_t    after  = slot->stamp.load(boost::memory_order_relaxed);
+    SlotHeader *copy   = reinterpret_cast<SlotHeader*>(&buffer[0]);
+
+    copy->stamp.store((before == after) ? before : 0); // torn: it was being written while we copied it.
+
+    if(copy->stamp.load() != 0) {
+      ++records;
+    }
+
+    ok = (fwrite(&buffer[0], header->recordSize, 1, f) == 1);
+  }
+
+  ok = (fclose(f) == 0) && ok;
+
+  if(!ok || rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    throw std::runtime_error("Could not write PDU trace dump: " + fileName);
+  }
+
+  return records;
+}
+
+//--------------------------------------------------------------------------------
+void PduTraceRing::dumpOnCrash(const std::string &fileName)
+{
+  struct sigaction sa;
+  int              signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+  strncpy(crashFile, fileName.c_str(), sizeof(crashFile) - 1);
+  crashRing = this;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = &PduTraceRing::crash_handler;
+  sa.sa_flags   = SA_RESETHAND; // the default action, i.e. the core dump, follows when we re-raise.
+  sigemptyset(&sa.sa_mask);
+
+  for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); ++i) {
+    sigaction(signals[i], &sa, NULL);
+  }
+}
+
+//--------------------------------------------------------------------------------
+void PduTraceRing::crash_handler(int sig)
+{
+  // Async signal safe: a raw copy of the ring, written with open(2) and write(2) only.
+  // Records that were being written when we crashed, are told apart by their stamp.
+  if(crashRing && crashRing->header) {
+    int fd = ::open(crashFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if(fd >= 0) {
+      const uint8_t *p    = reinterpret_cast<const uint8_t*>(crashRing->header);
+      size_t         left = ringSize(crashRing->header);
+
+      while(left > 0) {
+        ssize_t n = write(fd, p, left);
+        if(n <= 0) {
+          break;
+        }
+        p    += n;
+        left -= n;
+      }
+
+      close(fd);
+    }
+  }
+
+  raise(sig);
+}
+
+//--------------------------------------------------------------------------------
+bool PduTraceRing::validHeader(const Header *h)
+{
+  return (memcmp(h->magic, traceMagic, sizeof(traceMagic)) == 0 &&
+          h->version    == 1                                      &&
+          h->slotCount  >  0                                      &&
+          (h->slotCount & (h->slotCount - 1)) == 0                &&
+          h->recordSize >= sizeof(SlotHeader) + h->slotSize);
+}
+
+//--------------------------------------------------------------------------------
+PduTraceRing::SlotHeader *PduTraceRing::slotAt(uint8_t *base, uint64_t recordNumber)
+{
+  const Header *h = reinterpret_cast<const Header*>(base);
+
+  return reinterpret_cast<SlotHeader*>(base + headerSize + ((size_t)(recordNumber & (h->slotCount - 1)) * h->recordSize));
+}
+
+//--------------------------------------------------------------------------------
+size_t PduTraceRing::ringSize(const Header *h)
+{
+  return headerSize + ((size_t)h->slotCount * h->recordSize);
+}
@@ -0,0 +1,105 @@
+// File  : pdu_trace.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _PDU_TRACE_HPP_
+#define _PDU_TRACE_HPP_
+
+#include <string>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+
+//--------------------------------------------------------------------------------
+// An always-on flight recorder for raw PDUs: a fixed number of fixed size
+// slots, written round robin. Recording a PDU is a fetch-add and a memcpy.
+// PDUs larger than a slot are truncated, but keep their full length.
+//
+// Every slot carries a stamp (its record number + 1) that is zeroed while the
+// slot is being written, so readers can tell a torn record from a good one.
+//
+// The ring lives either in memory, or in a memory mapped file. A mapped ring
+// survives a crash of the process as is. dump() writes a consistent copy of
+// either kind in the same format, for the ksmppc-trace tool to decode.
+//
+// File layout: Header, followed by slotCount records of recordSize bytes. Each
+// record is a SlotHeader, followed by slotSize bytes of PDU.
+class PduTraceRing
+{
+  public:
+    enum Direction { RX = 1, TX = 2 };
+
+    struct Header {
+      char                     magic[8];           // "KSMPPTR1"
+      uint32_t                 version;
+      uint32_t                 slotCount;          // a power of 2
+      uint32_t                 slotSize;           // bytes of PDU kept per slot
+      uint32_t                 recordSize;         // sizeof(SlotHeader) + slotSize, 8 byte aligned
+      int64_t                  realtimeOffsetNs;   // add to a slot's monotonicNs, to get nanoseconds since the epoch.
+      boost::atomic<uint64_t>  next;               // records written so far
+    };
+
+    struct SlotHeader {
+      boost::atomic<uint64_t>  stamp;              // record number + 1. 0 while being written.
+      uint64_t                 monotonicNs;
+      uint32_t                 sessionId;
+      uint32_t                 length;             // of the PDU
+      uint16_t                 captured;           // bytes of it in the slot
+      uint8_t                  direction;
+      uint8_t                  reserved[5];
+    };
+
+    static PduTraceRing *instance();
+
+    // slotCount is rounded up to a power of 2, and slotSize is capped at 65535. An empty fileName keeps the ring in memory.
+    // Throws std::runtime_error if the file can't be mapped.
+    void     open           (unsigned slotCount, unsigned slotSize, const std::string &fileName = "");
+    bool     isOpen         () { return (header != NULL); }
+
+    void     record         (Direction direction, uint32_t sessionId, const uint8_t *pdu, size_t length)
+    {
+      if(header) {
+        write_record(direction, sessionId, pdu, length);
+      }
+    }
+
+    size_t   dump           (const std::string &fileName); // returns the number of records written. Throws std::runtime_error.
+    void     dumpOnCrash    (const std::string &fileName); // SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT write the ring to fileName.
+
+    // For readers of a ring file.
+    static bool        validHeader(const Header *h);
+    static SlotHeader *slotAt     (uint8_t *base, uint64_t recordNumber);
+    static size_t      ringSize   (const Header *h);               // bytes, the header included.
+
+  private:
+    PduTraceRing() : header(NULL), mapped(false), mappedSize(0) {}
+    ~PduTraceRing();
+
+    void write_record(Direction direction, uint32_t sessionId, const uint8_t *pdu, size_t length);
+
+    static void crash_handler(int sig);
+
+    Header  *header;     // also the start of the ring's memory.
+    bool     mapped;
+    size_t   mappedSize;
+};
+
+#define TRACE_RING PduTraceRing::instance()
+
+#endif // _PDU_TRACE_HPP_
@@ -22,59 +22,30 @@
 #define _RAWPDU_HPP_
 
 #include <smpppdu_all.hpp>
-#include <boost/shared_ptr.hpp>
 
+//--------------------------------------------------------------------------------
+// A view of one complete PDU, as it sits in the session's receive buffer.
+// RawPdu does not own the bytes; it is only valid until the next socket read.
 class RawPdu
 {
-
   public:
-    RawPdu() :
-      header    (NULL),
-      fullBuffer(NULL),
-      body      (NULL)
-    {
-      header = new uint8_t[16];
-    }
-
-    ~RawPdu()
-    {
-      if(header && fullBuffer) {
-        delete [] fullBuffer;
-      } else if(header) {
-        delete [] header;
-      }
-    }
+    RawPdu() : frame(NULL) {}
+    explicit RawPdu(uint8_t *f) : frame(f) {}
+    ~RawPdu() {}
 
-    uint8_t *bodyBuf()
-    {
-      if(header) {
-        if(fullBuffer) delete fullBuffer;
-        fullBuffer = new uint8_t[cmd_length()];
-        memcpy(fullBuffer, header, 16);
-        delete [] header;
-        header     = fullBuffer;
-        body       = fullBuffer + 16;
-      }
-      return body;
-    }
+    void        set       (uint8_t *f) { frame = f; }
 
-    uint8_t    *data      () { return fullBuffer; }
-    uint8_t    *headerBuf () { return header; }
-    const char *c_str     () { return (fullBuffer)?reinterpret_cast<const char *>(fullBuffer):NULL; }
+    uint8_t    *data      () { return frame; }
+    const char *c_str     () { return reinterpret_cast<const char *>(frame); }
 
     uint32_t    bodyLength() { return (cmd_length() - 16); }
-    uint32_t    cmd_length() { return (header)?smpp_pdu::get_command_length (header):0; }
-    uint32_t    cmd_id    () { return (header)?smpp_pdu::get_command_id     (header):0; }
-    uint32_t    cmd_status() { return (header)?smpp_pdu::get_command_status (header):0; }
-    uint32_t    seq_num   () { return (header)?smpp_pdu::get_sequence_number(header):0; }
-      
+    uint32_t    cmd_length() { return (frame)?smpp_pdu::get_command_length (frame):0; }
+    uint32_t    cmd_id    () { return (frame)?smpp_pdu::get_command_id     (frame):0; }
+    uint32_t    cmd_status() { return (frame)?smpp_pdu::get_command_status (frame):0; }
+    uint32_t    seq_num   () { return (frame)?smpp_pdu::get_sequence_number(frame):0; }
+
   private:
-    uint8_t  *header;
-    uint8_t  *fullBuffer;
-    uint8_t  *body;
-    uint32_t  cmdLength;
+    uint8_t *frame;
 };
 
-typedef boost::shared_ptr<RawPdu> SharedRawPdu;
-
 #endif // _RAWPDU_HPP_
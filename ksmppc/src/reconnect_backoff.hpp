@@ -0,0 +1,96 @@
+// File  : reconnect_backoff.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _RECONNECT_BACKOFF_HPP_
+#define _RECONNECT_BACKOFF_HPP_
+
+#include <ctime>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+//--------------------------------------------------------------------------------
+// Exponential backoff for re-connect attempts.
+// Every call to next() returns the current delay, randomised by +/- jitter, and
+// then grows the delay by 'multiplier', up to 'maxDelay'. reset() is called once
+// a bind succeeds.
+class ReconnectBackoff
+{
+  public:
+    ReconnectBackoff(unsigned initialDelayMs,
+                     unsigned maxDelayMs,
+                     double   multiplier,
+                     double   jitter) :
+      initial   (initialDelayMs),
+      maximum   ((maxDelayMs > initialDelayMs) ? maxDelayMs : initialDelayMs),
+      factor    ((multiplier >= 1.0) ? multiplier : 1.0),
+      spread    ((jitter < 0.0) ? 0.0 : ((jitter > 1.0) ? 1.0 : jitter)),
+      current   (initial),
+      generator (seed(this))
+    {
+    }
+
+    ~ReconnectBackoff() {}
+
+    boost::posix_time::time_duration next()
+    {
+      boost::random::uniform_real_distribution<double> randomiser(1.0 - spread, 1.0 + spread);
+      double delay = current * randomiser(generator);
+
+      current *= factor;
+      if(current > maximum) {
+        current = maximum;
+      }
+
+      return boost::posix_time::milliseconds(static_cast<long>(delay));
+    }
+
+    void reset() { current = initial; }
+
+  private:
+    //--------------------------------------------------------------------------------
+    // Sessions, and delivery workers, are built together, in the same second and
+    // process. Each one's address, and the clock's nanoseconds, keep them from
+    // drawing the same delays, and so reconnecting in lockstep after an outage.
+    static uint32_t seed(const void *self)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+
+      uint64_t mix = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(self));
+
+      mix ^= (static_cast<uint64_t>(time(NULL)) << 32) ^ static_cast<uint64_t>(getpid()) ^ static_cast<uint64_t>(ts.tv_nsec);
+      mix *= 0x9E3779B97F4A7C15ULL; // spreads the address' few changing bits over the top ones.
+
+      return static_cast<uint32_t>(mix >> 32);
+    }
+
+    double                   initial;   // milliseconds
+    double                   maximum;   // milliseconds
+    double                   factor;
+    double                   spread;    // fraction of the delay, i.e. 0.2 == +/- 20%
+    double                   current;   // milliseconds
+    boost::random::mt19937   generator;
+};
+
+#endif // _RECONNECT_BACKOFF_HPP_
@@ -0,0 +1,112 @@
+// File  : rx_buffer.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _RX_BUFFER_HPP_
+#define _RX_BUFFER_HPP_
+
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+#include <smpppdu_all.hpp>
+
+#include "rawpdu.hpp"
+
+//--------------------------------------------------------------------------------
+// Per session receive buffer. The socket reads as many bytes as it has into the
+// free space at the end of the buffer, after which every complete PDU is framed
+// in place, by its command_length. Bytes of an incomplete PDU are moved to the
+// front of the buffer before the next read, so a frame is always contiguous and
+// can be handed out as a RawPdu view, without copying it.
+class RxBuffer
+{
+  public:
+    enum FrameStatus { FRAME_READY, FRAME_INCOMPLETE, FRAME_INVALID };
+
+    RxBuffer(size_t capacity, uint32_t maxPduSize) :
+      buffer    ((capacity > 16) ? capacity : 16),
+      maxPdu    (maxPduSize),
+      head      (0),
+      tail      (0)
+    {
+    }
+
+    ~RxBuffer() {}
+
+    void clear() { head = 0; tail = 0; }
+
+    // Makes room for the next read. Call before every read.
+    void prepare()
+    {
+      size_t pending = tail - head;
+
+      if(head > 0) {
+        if(pending > 0) {
+          memmove(&buffer[0], &buffer[head], pending);
+        }
+        head = 0;
+        tail = pending;
+      }
+
+      if(pending >= 16) {                          // a PDU bigger than the buffer, grow to fit it.
+        uint32_t length = smpp_pdu::get_command_length(&buffer[0]);
+        if(length > buffer.size() && length <= maxPdu) {
+          buffer.resize(length);
+        }
+      }
+    }
+
+    uint8_t *writePtr  () { return &buffer[tail]; }
+    size_t   writeSpace() { return (buffer.size() - tail); }
+    void     commit    (size_t bytesRead) { tail += bytesRead; }
+
+    // Frames the next complete PDU, if there is one.
+    FrameStatus nextFrame(RawPdu &frame)
+    {
+      size_t pending = tail - head;
+
+      if(pending < 16) {
+        return FRAME_INCOMPLETE;
+      }
+
+      uint32_t length = smpp_pdu::get_command_length(&buffer[head]);
+
+      if(length < 16 || length > maxPdu) {
+        return FRAME_INVALID;
+      }
+
+      if(pending < length) {
+        return FRAME_INCOMPLETE;
+      }
+
+      frame.set(&buffer[head]);
+      head += length;
+
+      return FRAME_READY;
+    }
+
+  private:
+    std::vector<uint8_t> buffer;
+    uint32_t             maxPdu;  // anything claiming to be bigger than this is a protocol error.
+    size_t               head;    // start of the first unframed byte
+    size_t               tail;    // end of the bytes read so far
+};
+
+#endif // _RX_BUFFER_HPP_
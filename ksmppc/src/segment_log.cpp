@@ -0,0 +1,626 @@
+// File  : segment_log.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/crc.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "stat.hpp"
+#include "segment_log.hpp"
+
+namespace {
+  const char     segmentMagic[8] = { 'K', 'S', 'M', 'P', 'P', 'S', 'G', '1' };
+  const uint32_t headerSize      = 64;
+  const uint32_t recordHeader    = 12;        // length, state, checksum.
+  const uint32_t minSegmentSize  = 64 * 1024;
+  const size_t   maxSpares       = 2;         // more than this many spent segments are deleted.
+
+  const uint32_t RECORD_PENDING  = 0x444e4550; // "PEND"
+  const uint32_t RECORD_POPPED   = 0x454e4f44; // "DONE"
+
+  struct SegmentHeader
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t number;
+    uint32_t segmentSize;
+  };
+
+  inline uint32_t  padded(uint32_t length)     { return (length + 3) & ~3U; }
+  inline uint32_t *field (uint8_t *p, int i)   { return reinterpret_cast<uint32_t*>(p) + i; }
+}
+
+//--------------------------------------------------------------------------------
+SegmentLog::SegmentLog(const std::string &name,
+                       const std::string &directory,
+                       size_t             segmentSize,
+                       bool               durableLog,
+                       unsigned           windowUs,
+                       unsigned           maxBatch) :
+  logName       (name),
+  dir           (directory),
+  segSize       (std::max<size_t>(minSegmentSize, (segmentSize + 4095) & ~(size_t)4095)),
+  nextNumber    (0),
+  count         (0),
+  durable       (durableLog),
+  commitWindowUs(windowUs),
+  commitMaxBatch(std::max(1U, maxBatch)),
+  statPrefix    ("queues." + name + "."),
+  appended      (0),
+  committed     (0),
+  committing    (false),
+  failed        (false)
+{
+  recover();
+
+  if(segments.empty()) {
+    newSegment();
+  }
+}
+
+//--------------------------------------------------------------------------------
+SegmentLog::~SegmentLog()
+{
+  for(size_t i = 0; i < segments.size(); ++i) {
+    closeSegment(segments[i]);
+  }
+
+  for(size_t i = 0; i < retiring.size(); ++i) {
+    closeSegment(retiring[i]);
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::append(const char *data, size_t length)
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  checkFailed();
+  checkFits(length);
+  write(data, length);
+  waitDurable(lock);
+}
+
+//--------------------------------------------------------------------------------
+// All of the records, or none of them, are appended. A durable log returns once
+// they are all on disk, normally after a single sync.
+void SegmentLog::append(const std::vector<std::string> &records)
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  checkFailed();
+
+  for(size_t i = 0; i < records.size(); ++i) {
+    checkFits(records[i].size());
+  }
+
+  for(size_t i = 0; i < records.size(); ++i) {
+    write(records[i].data(), records[i].size());
+  }
+
+  if(!records.empty()) {
+    waitDurable(lock);
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::checkFailed()
+{
+  if(failed) {
+    throw std::runtime_error("Segment log failed an earlier sync, and takes no more records: " + logName);
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::checkFits(size_t length)
+{
+  if(recordHeader + padded(length) + headerSize + sizeof(uint32_t) > segSize) {
+    throw std::runtime_error("Record too large for segment log: " + logName);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// With the lock held, and checkFits() passed.
+void SegmentLog::write(const char *data, size_t length)
+{
+  uint32_t needed = recordHeader + padded(length);
+
+  if(segments.back().writeOffset + needed + sizeof(uint32_t) > segSize) { // always leave room for the terminating 0 length.
+    newSegment();
+  }
+
+  Segment &seg = segments.back();
+  uint8_t *rec = seg.base + seg.writeOffset;
+
+  memcpy(rec + recordHeader, data, length);
+  *field(rec, 1) = RECORD_PENDING;
+  *field(rec, 2) = checksum(seg.number, rec + recordHeader, length);
+  *field(rec + needed, 0) = 0;                  // a scan stops here, whatever an earlier use of the file left behind.
+  *field(rec, 0) = static_cast<uint32_t>(length); // last, it is what makes the record visible to a scan.
+
+  seg.writeOffset += needed;
+  ++count;
+
+  if(durable) {
+    ++appended;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Returns once every record written so far is on disk.
+void SegmentLog::waitDurable(boost::mutex::scoped_lock &lock)
+{
+  if(!durable) {
+    return;
+  }
+
+  uint64_t ticket = appended;
+
+  if(appended - committed >= commitMaxBatch) {
+    batchCv.notify_one();
+  }
+
+  while(committed < ticket) {
+    checkFailed(); // our record was rolled back.
+
+    if(committing) {
+      committedCv.wait(lock);
+    } else {
+      commit(lock); // we lead this batch.
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Reads on past segments that are read to the end, but still hold records
+// that were not done() yet.
+bool SegmentLog::pop(std::string &record, Ticket *ticket)
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  retireSpent();
+
+  for(size_t i = 0; i < segments.size(); ++i) {
+    Segment &seg   = segments[i];
+    uint32_t limit = durable ? seg.durableOffset : seg.writeOffset; // a durable log only hands out what is on disk.
+
+    // Records done() out of order, before a restart.
+    while(seg.readOffset < limit && *field(seg.base + seg.readOffset, 1) == RECORD_POPPED) {
+      seg.readOffset += recordHeader + padded(*field(seg.base + seg.readOffset, 0));
+    }
+
+    if(seg.readOffset >= limit) {
+      if(seg.readOffset < seg.writeOffset) {
+        return false; // the next record waits for its commit.
+      }
+      continue;
+    }
+
+    uint8_t *rec    = seg.base + seg.readOffset;
+    uint32_t length = *field(rec, 0);
+
+    record.assign(reinterpret_cast<const char*>(rec + recordHeader), length);
+
+    if(ticket) {
+      *ticket = (seg.number << 32) | seg.readOffset;
+      ++seg.held;
+    } else {
+      *field(rec, 1) = RECORD_POPPED;
+    }
+
+    seg.readOffset += recordHeader + padded(length);
+    --count;
+
+    return true;
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::done(Ticket ticket)
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  uint64_t number = ticket >> 32;
+  uint32_t offset = static_cast<uint32_t>(ticket);
+
+  for(size_t i = 0; i < segments.size(); ++i) {
+    if(segments[i].number == number && segments[i].held > 0 && offset < segments[i].readOffset) {
+      *field(segments[i].base + offset, 1) = RECORD_POPPED;
+      --segments[i].held;
+      break;
+    }
+  }
+
+  retireSpent();
+}
+
+//--------------------------------------------------------------------------------
+bool SegmentLog::empty()
+{
+  boost::mutex::scoped_lock lock(mtx);
+  return count == 0;
+}
+
+//--------------------------------------------------------------------------------
+size_t SegmentLog::size()
+{
+  boost::mutex::scoped_lock lock(mtx);
+  return count;
+}
+
+//--------------------------------------------------------------------------------
+size_t SegmentLog::segmentCount()
+{
+  boost::mutex::scoped_lock lock(mtx);
+  return segments.size();
+}
+
+//--------------------------------------------------------------------------------
+// Picks up the segments a previous run left behind, oldest first.
+void SegmentLog::recover()
+{
+  DIR *d = opendir(dir.c_str());
+
+  if(!d) {
+    throw std::runtime_error("Could not open segment log directory: " + dir);
+  }
+
+  std::string           prefix = logName + ".";
+  std::vector<uint64_t> numbers;
+
+  for(struct dirent *e = readdir(d); e; e = readdir(d)) {
+    std::string fname(e->d_name);
+
+    if(fname.size() > prefix.size() + 4 &&
+       fname.compare(0, prefix.size(), prefix) == 0 &&
+       fname.compare(fname.size() - 4, 4, ".seg") == 0) {
+      std::string digits = fname.substr(prefix.size(), fname.size() - prefix.size() - 4);
+
+      if(digits.find_first_not_of("0123456789") == std::string::npos) {
+        numbers.push_back(strtoull(digits.c_str(), NULL, 10));
+      }
+    }
+  }
+
+  closedir(d);
+  std::sort(numbers.begin(), numbers.end());
+
+  for(size_t i = 0; i < numbers.size(); ++i) {
+    Segment seg;
+
+    if(!openSegment(segmentPath(numbers[i]), numbers[i], seg, false)) {
+      continue; // not one of ours, or damaged beyond use.
+    }
+
+    scanSegment(seg);
+    segments.push_back(seg);
+    nextNumber = numbers[i] + 1;
+  }
+
+  retireSpent();
+}
+
+//--------------------------------------------------------------------------------
+bool SegmentLog::openSegment(const std::string &path, uint64_t number, Segment &seg, bool create)
+{
+  int fd = ::open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+
+  if(fd < 0) {
+    if(create) {
+      throw std::runtime_error("Could not create segment: " + path);
+    }
+    return false;
+  }
+
+  struct stat st;
+
+  if(fstat(fd, &st) != 0 || (!create && st.st_size != (off_t)segSize) || (create && ftruncate(fd, segSize) != 0)) {
+    close(fd);
+    if(create) {
+      throw std::runtime_error("Could not size segment: " + path);
+    }
+    return false;
+  }
+
+  void *m = mmap(NULL, segSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if(m == MAP_FAILED) {
+    close(fd);
+    throw std::runtime_error("Could not map segment: " + path);
+  }
+
+  SegmentHeader *h = static_cast<SegmentHeader*>(m);
+
+  if(create) {
+    memset(h, 0, headerSize + sizeof(uint32_t));
+    memcpy(h->magic, segmentMagic, sizeof(segmentMagic));
+    h->version     = 1;
+    h->headerSize  = headerSize;
+    h->number      = number;
+    h->segmentSize = segSize;
+  } else if(memcmp(h->magic, segmentMagic, sizeof(segmentMagic)) != 0 || h->number != number || h->segmentSize != segSize) {
+    munmap(m, segSize);
+    close(fd);
+    return false;
+  }
+
+  seg.number       = number;
+  seg.fd           = fd;
+  seg.base         = static_cast<uint8_t*>(m);
+  seg.readOffset   = headerSize;
+  seg.writeOffset   = headerSize;
+  seg.syncedOffset  = 0;          // a new file's header must reach the disk too.
+  seg.durableOffset = headerSize;
+  seg.held          = 0;
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// The first record that is not complete and intact ends the segment. Popped
+// records in front of the first pending one are skipped.
+void SegmentLog::scanSegment(Segment &seg)
+{
+  uint32_t pos         = headerSize;
+  bool     seenPending = false;
+
+  while(pos + recordHeader <= segSize) {
+    uint8_t *rec    = seg.base + pos;
+    uint32_t length = *field(rec, 0);
+    uint32_t state  = *field(rec, 1);
+
+    if(length == 0 || pos + recordHeader + padded(length) > segSize ||
+       (state != RECORD_PENDING && state != RECORD_POPPED) ||
+       *field(rec, 2) != checksum(seg.number, rec + recordHeader, length)) {
+      break;
+    }
+
+    if(state == RECORD_PENDING) {
+      if(!seenPending) {
+        seg.readOffset = pos;
+        seenPending    = true;
+      }
+      ++count;
+    }
+
+    pos += recordHeader + padded(length);
+  }
+
+  seg.writeOffset   = pos;
+  seg.syncedOffset  = pos; // whatever a previous run wrote, has had every chance to reach the disk.
+  seg.durableOffset = pos;
+
+  if(!seenPending) {
+    seg.readOffset = pos;
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::closeSegment(Segment &seg)
+{
+  munmap(seg.base, segSize);
+  close(seg.fd);
+}
+
+//--------------------------------------------------------------------------------
+// Starts the next segment, in a spare file if there is one.
+void SegmentLog::newSegment()
+{
+  uint64_t    number = nextNumber++;
+  std::string path   = segmentPath(number);
+  Segment     seg;
+
+  if(!spares.empty()) {
+    if(rename(spares.back().c_str(), path.c_str()) != 0) {
+      unlink(spares.back().c_str());
+    }
+    spares.pop_back();
+  }
+
+  openSegment(path, number, seg, true);
+  segments.push_back(seg);
+
+  if(durable) { // make the new file's name as durable as its contents will be.
+    int dfd = ::open(dir.c_str(), O_RDONLY);
+
+    if(dfd >= 0) {
+      fsync(dfd);
+      close(dfd);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Called with the lock held, by the first appender that finds its record not
+// yet on disk. Gives later appenders commitWindowUs to join the batch, then
+// syncs every segment written to since the last commit, without holding the
+// lock, so the next batch can gather in the meantime.
+void SegmentLog::commit(boost::mutex::scoped_lock &lock)
+{
+  committing = true;
+
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds(commitWindowUs);
+
+  while(appended - committed < commitMaxBatch) {
+    if(!batchCv.timed_wait(lock, deadline)) {
+      break;
+    }
+  }
+
+  uint64_t              target = appended;
+  uint64_t              batch  = appended - committed;
+  std::vector<int>      fds;
+  std::vector<uint32_t> upTo;
+  std::vector<size_t>   which;
+
+  for(size_t i = 0; i < segments.size(); ++i) {
+    if(segments[i].syncedOffset < segments[i].writeOffset) {
+      fds  .push_back(segments[i].fd);
+      upTo .push_back(segments[i].writeOffset);
+      which.push_back(segments[i].number);
+      segments[i].syncedOffset = segments[i].writeOffset;
+    }
+  }
+
+  lock.unlock();
+
+  boost::posix_time::ptime start  = boost::posix_time::microsec_clock::universal_time();
+  bool                     synced = true;
+
+  for(size_t i = 0; i < fds.size() && synced; ++i) {
+    synced = (fdatasync(fds[i]) == 0);
+  }
+
+  int64_t latency = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+
+  lock.lock();
+
+  committing = false;
+
+  if(synced) {
+    committed = target;
+
+    for(size_t i = 0; i < segments.size(); ++i) { // popping may go this far now.
+      for(size_t j = 0; j < which.size(); ++j) {
+        if(segments[i].number == which[j]) {
+          segments[i].durableOffset = std::max(segments[i].durableOffset, upTo[j]);
+        }
+      }
+    }
+  } else {
+    // A second fdatasync can report success for pages the first one lost, so
+    // nothing that was not synced before is trusted again.
+    failed = true;
+    rollBack();
+  }
+
+  for(size_t i = 0; i < retiring.size(); ++i) {
+    release(retiring[i]);
+  }
+  retiring.clear();
+
+  committedCv.notify_all();
+
+  lock.unlock();
+
+  statInc(statPrefix + "commits");
+  statSet(statPrefix + "commit-latency-us", latency);
+  statSet(statPrefix + "commit-batch-size", (int64_t)batch);
+
+  if(!synced) {
+    statInc(statPrefix + "commit-failures");
+  }
+
+  lock.lock();
+
+  checkFailed();
+}
+
+//--------------------------------------------------------------------------------
+// With the lock held, after a failed sync. Drops every record that is not known
+// to be on disk, so that neither pop() nor a restart finds records whose
+// appenders were told they failed.
+void SegmentLog::rollBack()
+{
+  for(size_t i = 0; i < segments.size(); ++i) {
+    Segment &seg = segments[i];
+
+    for(uint32_t pos = seg.durableOffset; pos < seg.writeOffset; pos += recordHeader + padded(*field(seg.base + pos, 0))) {
+      --count;
+    }
+
+    if(seg.writeOffset > seg.durableOffset) {
+      *field(seg.base + seg.durableOffset, 0) = 0;
+    }
+
+    seg.writeOffset  = seg.durableOffset;
+    seg.syncedOffset = std::min(seg.syncedOffset, seg.durableOffset);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Fully popped, and done with, segments ahead of the newest one become spares.
+void SegmentLog::retireSpent()
+{
+  while(segments.size() > 1 && segments.front().readOffset >= segments.front().writeOffset && segments.front().held == 0) {
+    retireFront();
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::retireFront()
+{
+  if(committing) { // the commit may be syncing it right now.
+    retiring.push_back(segments.front());
+  } else {
+    release(segments.front());
+  }
+
+  segments.pop_front();
+}
+
+//--------------------------------------------------------------------------------
+void SegmentLog::release(Segment &seg)
+{
+  std::string path = segmentPath(seg.number);
+
+  closeSegment(seg);
+
+  if(spares.size() < maxSpares) {
+    spares.push_back(path);
+  } else {
+    unlink(path.c_str());
+  }
+}
+
+//--------------------------------------------------------------------------------
+std::string SegmentLog::segmentPath(uint64_t number)
+{
+  char tmp[32];
+  snprintf(tmp, sizeof(tmp), "%016llu", (unsigned long long)number);
+  return dir + "/" + logName + "." + tmp + ".seg";
+}
+
+//--------------------------------------------------------------------------------
+uint32_t SegmentLog::checksum(uint64_t number, const uint8_t *data, uint32_t length)
+{
+  boost::crc_32_type crc;
+
+  crc.process_bytes(&number, sizeof(number));
+  crc.process_bytes(&length, sizeof(length));
+  crc.process_bytes(data   , length);
+
+  return crc.checksum();
+}
+
@@ -0,0 +1,130 @@
+// File  : segment_log.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _SEGMENT_LOG_HPP_
+#define _SEGMENT_LOG_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/noncopyable.hpp>
+
+//--------------------------------------------------------------------------------
+// A FIFO of byte records, kept in fixed size, memory mapped segment files
+// "<directory>/<name>.<number>.seg". Records are appended to the newest segment
+// and popped from the oldest. A segment whose records have all been popped is
+// kept as a spare, and re-used for the next segment the writer needs.
+//
+// Each record is [length][state][checksum][bytes], padded to 4 bytes. The
+// checksum covers the segment number, so records left over in a re-used file
+// never pass for new ones. On start-up the segments are scanned, and every
+// record that was written but not popped is available again.
+//
+// pop() with a ticket hands a record out, but leaves it pending on disk until
+// done() is called with that ticket. Until then a restart hands it out again,
+// and its segment, and every one after it, stays in use. Tickets may be done()
+// in any order.
+//
+// A durable log does not return from append() before the record is on disk,
+// and pop() does not hand a record out before that either. Appends arriving
+// within commitWindowUs of each other, up to commitMaxBatch of them, share one
+// fdatasync: the first waiting appender syncs on behalf of all. A failed sync is
+// not retried: the records it did not cover are rolled back, every appender
+// still waiting gets an exception, and the log refuses appends from then on.
+class SegmentLog : private boost::noncopyable
+{
+  public:
+    typedef uint64_t Ticket; // segment number, and the record's offset in it. Never 0.
+
+    SegmentLog(const std::string &name,
+               const std::string &directory,
+               size_t             segmentSize    = 16 * 1024 * 1024,
+               bool               durable        = false,
+               unsigned           commitWindowUs = 1000,
+               unsigned           commitMaxBatch = 64);
+    ~SegmentLog();
+
+    void   append(const char *data, size_t length); // throws std::runtime_error if the record can never fit in a segment, or could not be synced.
+    void   append(const std::vector<std::string> &records);
+    bool   pop   (std::string &record, Ticket *ticket = NULL); // false if there is nothing to pop.
+    void   done  (Ticket ticket);                   // the record popped with this ticket, is done with.
+    bool   empty ();
+    size_t size  ();
+
+    size_t segmentCount();                          // segments in use, spares excluded.
+
+  private:
+    struct Segment
+    {
+      uint64_t  number;
+      int       fd;
+      uint8_t  *base;
+      uint32_t  readOffset;   // next record to pop.
+      uint32_t  writeOffset;  // where the next record goes.
+      uint32_t  syncedOffset; // everything before this is being, or has been, synced.
+      uint32_t  durableOffset;// everything before this is on disk. A durable log pops no further.
+      uint32_t  held;         // records popped with a ticket, and not done() yet.
+    };
+
+    void        checkFits    (size_t length);
+    void        write        (const char *data, size_t length);
+    void        waitDurable  (boost::mutex::scoped_lock &lock);
+    void        recover      ();
+    bool        openSegment  (const std::string &path, uint64_t number, Segment &seg, bool create);
+    void        scanSegment  (Segment &seg);
+    void        closeSegment (Segment &seg);
+    void        newSegment   ();
+    void        retireSpent  ();
+    void        retireFront  ();
+    void        release      (Segment &seg);
+    void        commit       (boost::mutex::scoped_lock &lock);
+    void        rollBack     ();
+    void        checkFailed  ();
+    std::string segmentPath  (uint64_t number);
+    uint32_t    checksum     (uint64_t number, const uint8_t *data, uint32_t length);
+
+    std::string               logName;
+    std::string               dir;
+    uint32_t                  segSize;
+    boost::mutex              mtx;
+    std::deque<Segment>       segments;    // oldest first, back() is written to.
+    std::vector<std::string>  spares;      // paths of fully popped segment files.
+    uint64_t                  nextNumber;
+    size_t                    count;       // records appended, and not yet popped.
+
+    bool                      durable;
+    unsigned                  commitWindowUs;
+    unsigned                  commitMaxBatch;
+    std::string               statPrefix;  // "queues.<name>."
+    uint64_t                  appended;    // records ever appended, the last one's commit ticket.
+    uint64_t                  committed;   // every ticket up to here is on disk.
+    bool                      committing;  // an appender is syncing, others wait on committedCv.
+    bool                      failed;      // a sync failed. Nothing more is appended.
+    boost::condition_variable committedCv;
+    boost::condition_variable batchCv;     // the committing appender waits on this for its batch to fill.
+    std::vector<Segment>      retiring;    // retired during a commit, released once it is done.
+};
+
+#endif // _SEGMENT_LOG_HPP_
+
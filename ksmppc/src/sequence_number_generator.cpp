@@ -0,0 +1,163 @@
+// File  : sequence_number_generator.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <kisscpp/logstream.hpp>
+
+#include "sequence_number_generator.hpp"
+
+//--------------------------------------------------------------------------------
+SequinceNumberGenerator::SequinceNumberGenerator(const std::string &persistFile, unsigned reserveBlock) :
+  fileName (persistFile),
+  blockSize((reserveBlock > 0) ? reserveBlock : 1),
+  counter  (0),
+  reserved (0),
+  wanted   (0),
+  stopping (false)
+{
+  if(!fileName.empty()) {
+    uint64_t start = loadMark();
+    counter.store(start, boost::memory_order_relaxed);
+    storeMark(start + 2 * blockSize);
+    wanted = start + 2 * blockSize;
+    reserved.store(wanted, boost::memory_order_release);
+    writer = boost::thread(boost::bind(&SequinceNumberGenerator::markWriter, this));
+  }
+}
+
+//--------------------------------------------------------------------------------
+SequinceNumberGenerator::~SequinceNumberGenerator()
+{
+  if(writer.joinable()) {
+    {
+      boost::lock_guard<boost::mutex> guard(markMutex);
+      stopping = true;
+    }
+    markWanted.notify_one();
+    writer.join();
+  }
+}
+
+//--------------------------------------------------------------------------------
+uint32_t SequinceNumberGenerator::next()
+{
+  uint64_t n = counter.fetch_add(1, boost::memory_order_relaxed);
+
+  // The mark is kept two blocks ahead. Asking for the next one at the start of
+  // a block gives markWriter() a whole block's worth of numbers to write it in.
+  if(!fileName.empty()) {
+    if((n % blockSize) == 0) {
+      requestMark(n + 2 * blockSize);
+    }
+
+    if(n >= reserved.load(boost::memory_order_acquire)) { // markWriter() fell behind.
+      waitForMark(n);
+    }
+  }
+
+  return (uint32_t)(smpp_pdu::SequenceNumber::Min + (n % range));
+}
+
+//--------------------------------------------------------------------------------
+void SequinceNumberGenerator::requestMark(uint64_t mark)
+{
+  {
+    boost::lock_guard<boost::mutex> guard(markMutex);
+    if(mark <= wanted) { // a later block got here first.
+      return;
+    }
+    wanted = mark;
+  }
+  markWanted.notify_one();
+}
+
+//--------------------------------------------------------------------------------
+void SequinceNumberGenerator::waitForMark(uint64_t n)
+{
+  boost::unique_lock<boost::mutex> lock(markMutex);
+
+  while(n >= reserved.load(boost::memory_order_acquire) && !stopping) {
+    markStored.wait(lock);
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SequinceNumberGenerator::markWriter()
+{
+  boost::unique_lock<boost::mutex> lock(markMutex);
+
+  while(!stopping) {
+    if(wanted > reserved.load(boost::memory_order_relaxed)) {
+      uint64_t mark = wanted;
+
+      lock.unlock();
+      storeMark(mark); // a failure is logged, and the numbers are handed out anyway. As before.
+      lock.lock();
+
+      reserved.store(mark, boost::memory_order_release);
+      markStored.notify_all();
+    } else {
+      markWanted.wait(lock);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+uint64_t SequinceNumberGenerator::loadMark()
+{
+  uint64_t      mark = 0;
+  std::ifstream in(fileName.c_str());
+
+  if(in.good() && !(in >> mark)) {
+    kisscpp::LogStream log(__PRETTY_FUNCTION__);
+    log << "Could not read a sequence number mark from [" << fileName << "], starting at "
+        << smpp_pdu::SequenceNumber::Min << kisscpp::manip::flush;
+    mark = 0;
+  }
+
+  return mark;
+}
+
+//--------------------------------------------------------------------------------
+void SequinceNumberGenerator::storeMark(uint64_t mark)
+{
+  // Written to a temporary file that is renamed over the old one, so that a
+  // crash half way through never leaves us without a mark. Only the
+  // constructor and markWriter() get here, never both at once.
+  std::string tmpName = fileName + ".tmp";
+  FILE       *f       = fopen(tmpName.c_str(), "w");
+  bool        written = false;
+
+  if(f) {
+    written = (fprintf(f, "%llu\n", (unsigned long long)mark) > 0) && (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+    written = (fclose(f) == 0) && written;
+  }
+
+  if(!written || rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    kisscpp::LogStream log(__PRETTY_FUNCTION__);
+    log << "Failed to persist sequence number mark to [" << fileName << "]" << kisscpp::manip::flush;
+  }
+}
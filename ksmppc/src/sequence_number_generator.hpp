@@ -0,0 +1,72 @@
+// File  : sequence_number_generator.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _SEQUENCE_NUMBER_GENERATOR_HPP_
+#define _SEQUENCE_NUMBER_GENERATOR_HPP_
+
+#include <string>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <smpppdu_all.hpp>
+
+//--------------------------------------------------------------------------------
+// Hands out sequence numbers from SequenceNumber::Min to SequenceNumber::Max,
+// then wraps around to Min again. next() is a single atomic fetch-add.
+//
+// If a persistFile is given, a high-water mark is kept in it, reserveBlock
+// numbers ahead of what has been handed out. A restarted session continues
+// from that mark, so it won't reuse numbers that responses may still refer to.
+// The file is written by a thread of its own, once per reserveBlock numbers,
+// so next() never waits on the disk unless that thread falls a whole block behind.
+class SequinceNumberGenerator
+{
+  public:
+    SequinceNumberGenerator(const std::string &persistFile = "", unsigned reserveBlock = 10000);
+    ~SequinceNumberGenerator();
+
+    uint32_t next(); // Returns the next number in the uniformly incrementing sequence of numbers.
+
+  private:
+    uint64_t loadMark    ();
+    void     storeMark   (uint64_t mark);
+    void     requestMark (uint64_t mark);
+    void     waitForMark (uint64_t n);
+    void     markWriter  ();
+
+    static const uint64_t     range = (uint64_t)smpp_pdu::SequenceNumber::Max - smpp_pdu::SequenceNumber::Min + 1;
+
+    std::string               fileName;
+    uint64_t                  blockSize;
+    boost::atomic<uint64_t>   counter;   // numbers handed out so far, never wraps in practice.
+    boost::atomic<uint64_t>   reserved;  // the last mark markWriter() has written, or failed to write.
+    uint64_t                  wanted;    // the mark next() has asked markWriter() for.
+    bool                      stopping;
+    boost::mutex              markMutex; // only taken when a new block is reserved.
+    boost::condition_variable markWanted;
+    boost::condition_variable markStored;
+    boost::thread             writer;
+};
+
+#endif // _SEQUENCE_NUMBER_GENERATOR_HPP_
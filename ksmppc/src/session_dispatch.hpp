@@ -0,0 +1,198 @@
+// File  : session_dispatch.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _SESSION_DISPATCH_HPP_
+#define _SESSION_DISPATCH_HPP_
+
+#include <stdexcept>
+#include <stdint.h>
+
+#include <smpppdu_all.hpp>
+
+#include "rawpdu.hpp"
+
+//--------------------------------------------------------------------------------
+// The session state machine, as [state][command slot] tables, built once from
+// the rows in build(). Session is SessionManager; it is a template parameter
+// only so that the tables can be checked, and benchmarked, without a socket.
+// Session must have the State enum and every procpdu_* handler named below.
+//
+// dispatch() switches directly on a bound session's message traffic, before it
+// falls back on the table: a direct call can be inlined and predicted, a call
+// through a member pointer can't, and in production nearly every PDU is one
+// of these.
+template <class Session>
+class SessionDispatch
+{
+  public:
+    typedef void (Session::*PduHandler)(RawPdu &rawpdu);
+    enum { STATE_COUNT = Session::OUTBOUND + 1, COMMAND_SLOTS = 256 };
+
+    // Sets of states, as bit masks. Shared by the rows in build() and by dispatch().
+    enum {
+      TX_STATES    = (1U << Session::BOUND_TX) | (1U << Session::BOUND_TRX),
+      RX_STATES    = (1U << Session::BOUND_RX) | (1U << Session::BOUND_TRX),
+      BOUND_STATES = TX_STATES | RX_STATES
+    };
+
+    static bool       build            ();
+    static unsigned   commandSlot      (uint32_t commandId);
+    static void       dispatch         (Session &session, unsigned state, RawPdu &rawpdu);
+
+    static PduHandler inbound          (unsigned state, uint32_t commandId) { return inboundDispatch  [state][commandSlot(commandId)]; }
+    static bool       outboundPermitted(unsigned state, uint32_t commandId) { return outboundAllowed  [state][commandSlot(commandId)]; }
+
+  private:
+    static PduHandler inboundDispatch  [STATE_COUNT][COMMAND_SLOTS];
+    static bool       outboundAllowed  [STATE_COUNT][COMMAND_SLOTS];
+};
+
+template <class Session>
+typename SessionDispatch<Session>::PduHandler SessionDispatch<Session>::inboundDispatch[SessionDispatch<Session>::STATE_COUNT][SessionDispatch<Session>::COMMAND_SLOTS];
+
+template <class Session>
+bool SessionDispatch<Session>::outboundAllowed[SessionDispatch<Session>::STATE_COUNT][SessionDispatch<Session>::COMMAND_SLOTS];
+
+//--------------------------------------------------------------------------------
+// Every SMPP command_id maps on to one of 256 slots:
+//   bit 7     : response bit (0x80000000)
+//   bit 6     : 0x00000100, the SMPP v5 broadcast/data commands
+//   bits 0..5 : the low six bits of the command_id
+// Command ids with any other bit set land in slot 0, which nothing handles.
+template <class Session>
+unsigned SessionDispatch<Session>::commandSlot(uint32_t commandId)
+{
+  return (commandId & ~0x8000013FU) ? 0 : (((commandId >> 24) & 0x80) | ((commandId & 0x100) >> 2) | (commandId & 0x3F));
+}
+
+//--------------------------------------------------------------------------------
+// The same handler inbound() would give, for every state and command id.
+template <class Session>
+inline void SessionDispatch<Session>::dispatch(Session &session, unsigned state, RawPdu &rawpdu)
+{
+  uint32_t commandId = rawpdu.cmd_id();
+  unsigned in        = 1U << state;
+
+  if(in & BOUND_STATES) {
+    switch(commandId) {
+      case smpp_pdu::CommandId::SubmitSmResp   : if(in & TX_STATES) { session.procpdu_submit_sm_resp   (rawpdu); return; } break;
+      case smpp_pdu::CommandId::DataSmResp     : if(in & TX_STATES) { session.procpdu_data_sm_resp     (rawpdu); return; } break;
+      case smpp_pdu::CommandId::DeliverSm      : if(in & RX_STATES) { session.procpdu_deliver_sm       (rawpdu); return; } break;
+      case smpp_pdu::CommandId::DataSm         : if(in & RX_STATES) { session.procpdu_data_sm          (rawpdu); return; } break;
+      case smpp_pdu::CommandId::EnquireLink    :                      session.procpdu_enquire_link     (rawpdu); return;
+      case smpp_pdu::CommandId::EnquireLinkResp:                      session.procpdu_enquire_link_resp(rawpdu); return;
+      default                                  : break;
+    }
+  }
+
+  (session.*inbound(state, commandId))(rawpdu);
+}
+
+#define IN_STATE(S) (1U << Session::S)
+
+//--------------------------------------------------------------------------------
+template <class Session>
+bool SessionDispatch<Session>::build()
+{
+  // What we do with an inbound PDU, in which states. Any state/command pair not listed, goes to procpdu_unhandled.
+  // PDUs in the CLOSED state are not expected at all.
+  struct InboundRow { unsigned states; uint32_t commandId; PduHandler handler; };
+
+  static const unsigned bound   = BOUND_STATES;
+  static const unsigned binding = IN_STATE(OPEN) | IN_STATE(OUTBOUND);
+  static const unsigned tx      = TX_STATES;
+  static const unsigned rx      = RX_STATES;
+  static const unsigned linked  = binding | bound | IN_STATE(UNBOUND);
+
+  static const InboundRow inbound[] = {
+    { binding                   , smpp_pdu::CommandId::BindReceiverResp     , &Session::procpdu_bind_receiver_resp       },
+    { binding                   , smpp_pdu::CommandId::BindTransmitterResp  , &Session::procpdu_bind_transmitter_resp    },
+    { binding                   , smpp_pdu::CommandId::BindTransceiverResp  , &Session::procpdu_bind_transceiver_resp    },
+    { IN_STATE(OPEN)            , smpp_pdu::CommandId::Outbind              , &Session::procpdu_outbind                  },
+    { linked                    , smpp_pdu::CommandId::EnquireLink          , &Session::procpdu_enquire_link             },
+    { linked                    , smpp_pdu::CommandId::EnquireLinkResp      , &Session::procpdu_enquire_link_resp        },
+    { linked                    , smpp_pdu::CommandId::GenericNack          , &Session::procpdu_generic_nack             },
+    { bound                     , smpp_pdu::CommandId::Unbind               , &Session::procpdu_unbind                   },
+    { bound                     , smpp_pdu::CommandId::UnbindResp           , &Session::procpdu_unbind_resp              },
+    { tx                        , smpp_pdu::CommandId::BroadcastSmResp      , &Session::procpdu_broadcast_sm_resp        },
+    { tx                        , smpp_pdu::CommandId::CancelBroadcastSmResp, &Session::procpdu_cancel_broadcast_sm_resp },
+    { tx                        , smpp_pdu::CommandId::CancelSmResp         , &Session::procpdu_cancel_sm_resp           },
+    { tx                        , smpp_pdu::CommandId::DataSmResp           , &Session::procpdu_data_sm_resp             },
+    { tx                        , smpp_pdu::CommandId::QueryBroadcastSmResp , &Session::procpdu_query_broadcast_sm_resp  },
+    { tx                        , smpp_pdu::CommandId::QuerySmResp          , &Session::procpdu_query_sm_resp            },
+    { tx                        , smpp_pdu::CommandId::ReplaceSmResp        , &Session::procpdu_replace_sm_resp          },
+    { tx                        , smpp_pdu::CommandId::SubmitMultiResp      , &Session::procpdu_submit_multi_resp        },
+    { tx                        , smpp_pdu::CommandId::SubmitSmResp         , &Session::procpdu_submit_sm_resp           },
+    { rx                        , smpp_pdu::CommandId::AlertNotification    , &Session::procpdu_alert_notification       },
+    { rx                        , smpp_pdu::CommandId::DataSm               , &Session::procpdu_data_sm                  },
+    { rx                        , smpp_pdu::CommandId::DeliverSm            , &Session::procpdu_deliver_sm               }
+  };
+
+  // What we may send, in which states. Anything else is refused by do_send_pdu().
+  struct OutboundRow { unsigned states; uint32_t commandId; };
+
+  static const OutboundRow outbound[] = {
+    { tx, smpp_pdu::CommandId::BroadcastSm       },
+    { tx, smpp_pdu::CommandId::CancelBroadcastSm },
+    { tx, smpp_pdu::CommandId::CancelSm          },
+    { tx, smpp_pdu::CommandId::DataSm            },
+    { tx, smpp_pdu::CommandId::QueryBroadcastSm  },
+    { tx, smpp_pdu::CommandId::QuerySm           },
+    { tx, smpp_pdu::CommandId::ReplaceSm         },
+    { tx, smpp_pdu::CommandId::SubmitMulti       },
+    { tx, smpp_pdu::CommandId::SubmitSm          },
+    { rx, smpp_pdu::CommandId::DataSmResp        },
+    { rx, smpp_pdu::CommandId::DeliverSmResp     }
+  };
+
+  for(unsigned st = 0; st < STATE_COUNT; ++st) {
+    for(unsigned slot = 0; slot < COMMAND_SLOTS; ++slot) {
+      inboundDispatch[st][slot] = &Session::procpdu_unhandled;
+      outboundAllowed[st][slot] = false;
+    }
+  }
+
+  for(size_t i = 0; i < sizeof(inbound) / sizeof(inbound[0]); ++i) {
+    unsigned slot = commandSlot(inbound[i].commandId);
+
+    for(unsigned st = 0; st < STATE_COUNT; ++st) {
+      if(inbound[i].states & (1U << st)) {
+        if(slot == 0 || inboundDispatch[st][slot] != &Session::procpdu_unhandled) { // i.e. the rows above are wrong.
+          throw std::logic_error("SessionDispatch: conflicting inbound dispatch rows");
+        }
+        inboundDispatch[st][slot] = inbound[i].handler;
+      }
+    }
+  }
+
+  for(size_t i = 0; i < sizeof(outbound) / sizeof(outbound[0]); ++i) {
+    for(unsigned st = 0; st < STATE_COUNT; ++st) {
+      if(outbound[i].states & (1U << st)) {
+        outboundAllowed[st][commandSlot(outbound[i].commandId)] = true;
+      }
+    }
+  }
+
+  return true;
+}
+
+#undef IN_STATE
+
+#endif // _SESSION_DISPATCH_HPP_
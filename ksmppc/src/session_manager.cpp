@@ -20,41 +20,98 @@
 
 #include "session_manager.hpp"
 
+//--------------------------------------------------------------------------------
+static const char *txBatchBucketNames[] = { "tx-batch.1", "tx-batch.2-4", "tx-batch.5-16", "tx-batch.17-64", "tx-batch.65+" };
+
+static size_t batchSizeBucket(size_t batchSize) // index into txBatchBucketNames, and SessionManager::txBatchStats
+{
+  if(batchSize <=  1) return 0;
+  if(batchSize <=  4) return 1;
+  if(batchSize <= 16) return 2;
+  if(batchSize <= 64) return 3;
+  return 4;
+}
+
+//--------------------------------------------------------------------------------
+static const std::string      pduSentStat("pdu.sent");
+static boost::atomic<int64_t> pduSentTotal(0); // pdu.sent is shared by every session, so it is counted here and set once per batch.
+
 //--------------------------------------------------------------------------------
 SessionManager::SessionManager(boost::asio::io_service &io_service,
-                               SharedSafeSmppPduQ       recieveQueue) :
+                               SharedPduBytesQueue      recieveQueue,
+                               unsigned                 id,
+                               OrphanedPduHandler       orphanHandler,
+                               StateChangeHandler       stateHandler) :
+  sessionId                  (id),
+  statPrefix                 ("session." + boost::lexical_cast<std::string>(id) + "."),
+  inFlightStat               (statPrefix + "window.in-flight"),
+  orphanHandler              (orphanHandler),
+  stateHandler               (stateHandler),
   io_service_                (io_service),
+  strand                     (io_service_),
   socket_                    (io_service_),
+  endpointIndex              (0),
   enquire_link_timer         (io_service_),
   enquire_link_response_timer(io_service_),
   w4rQ_ageing_timer          (io_service_),
-  logPduFlag                 (true),                   // TODO: set to false by default after initial testing is completed.
+  throttle_timer             (io_service_),
+  reconnect_timer            (io_service_),
+  rxBuffer                   (smppcfg.getRxBufferSize(), smppcfg.getMaxPduSize()),
+  pduTrace                   (smppcfg.getPduTrace()),
   stopFlag                   (false),
   reconnectFlag              (false),
+  writeInProgress            (false),
+  windowStalled              (false),
   rxQ                        (recieveQueue),
-  currentState               (SessionManager::CLOSED)
+  currentState               (SessionManager::CLOSED),
+  seqNumGen                  (smppcfg.getSequenceNumberFile().empty() ? std::string()
+                                                                           : smppcfg.getSequenceNumberFile() + "." + boost::lexical_cast<std::string>(id),
+                              smppcfg.getSequenceNumberReserve()),
+  txThrottle                 (smppcfg.getTxThrottleLimit(), smppcfg.getTxThrottleBurst()),
+  throttleWaiting            (false),
+  throttleWaitTime           (0),
+  reconnectBackoff           (smppcfg.getReconnectInitialDelay(),
+                              smppcfg.getReconnectMaxDelay    (),
+                              smppcfg.getReconnectMultiplier  (),
+                              smppcfg.getReconnectJitter      ()),
+  w4rQ                       (smppcfg.getWindowSize(), smppcfg.getResponseTimeout()), // one tick per second
+  inFlightCount              (0),
+  pendingPosts               (0),
+  fastLane                   (smppcfg.getFastLaneSize()),
+  fastLanePosted             (false)
 {
   readCount  = 0;
   writeCount = 0;
 
-  statSet("pdu.sent"    , 0);
-  statSet("pdu.recieved", 0);
+  statSet(pduSentStat         , pduSentTotal);
+  statSet("pdu.recieved"      , 0);
+  statSet(statPrefix + "window.size"       , smppcfg.getWindowSize());
+  statSet(inFlightStat                     , 0);
+  statSet(statPrefix + "window.full-stalls", 0);
+  statSet(statPrefix + "throttle.waits"    , 0);
+  statSet(statPrefix + "throttle.wait-us"  , 0);
+  statSet(statPrefix + "reconnect-attempts", 0);
+  statSet(statPrefix + "time-to-bind-ms"   , 0);
+  statSet(statPrefix + "response-timeouts" , 0);
+  statSet(statPrefix + "fast-lane.full"    , 0);
+  statSet(statPrefix + "pdu.unhandled"     , 0);
+  statSet(statPrefix + "pdu.unsupported"   , 0);
+  statSet(statPrefix + "pdu.malformed"     , 0);
+
+  for(size_t i = 0; i < sizeof(txBatchStats) / sizeof(txBatchStats[0]); ++i) {
+    txBatchStats[i] = statPrefix + txBatchBucketNames[i];
+    statSet(txBatchStats[i], 0);
+  }
 
   start_session();
   setTxq();
-  set_w4rQ_ageing_timer();
   connect();
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::initiate()
 {
-  tcp::resolver         resolver(io_service_);
-  tcp::resolver::query  query(CFG->get<std::string>("message-centre.host"),
-                              CFG->get<std::string>("message-centre.port"));
-
-  endpoint_iterator = resolver.resolve(query);
-
+  resolve_endpoints();
   setTxq();
   connect();
 }
@@ -70,51 +127,58 @@ void SessionManager::setTxq()
     default : break;
   }
 
-  qName += "MessageTxq";
+  qName += "MessageTxq." + boost::lexical_cast<std::string>(sessionId); // every session has its own transmit queue.
 
   txQ.reset(new TransmitQ(qName, "/tmp", 10));
 
   // TODO: Make working dir and max items in que configurable.
-  // TODO: Make sure the queue name reflects at least a session id, for when there are multiple sessions.
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::connect()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-  log << "Connecting" << kisscpp::manip::flush;
-  boost::asio::async_connect(socket_,
-                             endpoint_iterator,
-                             boost::bind(&SessionManager::handle_connect, this, boost::asio::placeholders::error));
+  boost::system::error_code ignored;
+  tcp::endpoint             endpoint = endpoints[endpointIndex];
+
+  KLOG(INFO) << "Connecting to " << endpoint.address().to_string() << ":" << endpoint.port() << kisscpp::manip::flush;
+
+  socket_.close(ignored); // a failed attempt leaves the socket open, and the next address might be of a different protocol.
+  socket_.async_connect(endpoint, strand.wrap(boost::bind(&SessionManager::handle_connect, this, boost::asio::placeholders::error)));
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::setCurrentState(State p)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   currentState = p;
 
-  log << "NEW State: ";
-  switch(currentState) {
-    case OPEN     : log << "OPEN"     ; break;
-    case BOUND_TX : log << "BOUND_TX" ; break;
-    case BOUND_RX : log << "BOUND_RX" ; break;
-    case BOUND_TRX: log << "BOUND_TRX"; break;
-    case UNBOUND  : log << "UNBOUND"  ; break;
-    case CLOSED   : log << "CLOSED"   ; break;
-    case OUTBOUND : log << "OUTBOUND" ; break;
-    default       : log << "WTF"      ; break;
+  if(KLOG_ENABLED(INFO)) {
+    const char *name;
+
+    switch(currentState) {
+      case OPEN     : name = "OPEN"     ; break;
+      case BOUND_TX : name = "BOUND_TX" ; break;
+      case BOUND_RX : name = "BOUND_RX" ; break;
+      case BOUND_TRX: name = "BOUND_TRX"; break;
+      case UNBOUND  : name = "UNBOUND"  ; break;
+      case CLOSED   : name = "CLOSED"   ; break;
+      case OUTBOUND : name = "OUTBOUND" ; break;
+      default       : name = "WTF"      ; break;
+    }
+
+    KLOG(INFO) << "NEW State: " << name << kisscpp::manip::flush;
+  }
+
+  if(stateHandler) {
+    stateHandler();
   }
-  log << kisscpp::manip::flush;
 }
 
 //--------------------------------------------------------------------------------
-bool SessionManager::canSend()
+bool SessionManager::canSend(size_t inFlight)
 { 
   bool retval = false;
 
-  if(w4rQ.size() < 10) { // TODO: Make this configurable, max Items in w4rQ
+  if(inFlight < smppcfg.getWindowSize()) {
       switch(currentState) {
         case BOUND_TX:
         case BOUND_RX:
@@ -131,29 +195,195 @@ bool SessionManager::canSend()
 }
 
 //--------------------------------------------------------------------------------
-bool SessionManager::writing()
+void SessionManager::write_next()
+{
+  // Gathers as many queued PDUs as the window, the throttle and the batch limits allow, and writes them
+  // with a single async_write. Session and response PDU's are not subject to the window or the throttle.
+  if(writeInProgress) {
+    return;
+  }
+
+  size_t batchBytes = 0;
+  size_t inFlight   = w4rQ.size();
+
+  while((!txQ->empty() || !fastLane.empty())              &&
+        writeBatch.size() < smppcfg.getTxBatchMaxPdus()    &&
+        batchBytes        < smppcfg.getTxBatchMaxBytes()) {
+
+    bool sessionTraffic = txQ->sessionTrafficPending();
+
+    if(!sessionTraffic) {
+      if(throttleWaiting) { // throttle_timer will call us again once a token is available.
+        break;
+      }
+
+      if(!canSend(inFlight)) {
+        if(!windowStalled && inFlight >= smppcfg.getWindowSize()) {
+          windowStalled = true;
+          statInc(statPrefix + "window.full-stalls");
+        }
+        break;
+      }
+
+      windowStalled = false;
+
+      if(!throttle_check()) {
+        break;
+      }
+    }
+
+    SharedSmppPdu pdu;
+
+    if(sessionTraffic || !fastLane.pop(pdu)) { // fast lane messages go ahead of queued ones.
+      if(txQ->empty()) {
+        txThrottle.refund(); // a fast lane push that is not quite done yet. Its drain_fast_lane() will follow,
+        break;               // and gets the token we took for it.
+      }
+      pdu = txQ->pop();
+    }
+
+    if(!sessionTraffic) {
+      ++inFlight; // only once there is a message, like the token.
+    }
+
+    batchBytes += add_to_write_batch(pdu);
+  }
+
+  if(!writeBatch.empty()) {
+    write_batch();
+  }
+}
+
+//--------------------------------------------------------------------------------
+bool SessionManager::isBound()
 {
-  return (!txQ->empty());
+  switch(currentState) {
+    case BOUND_TX :
+    case BOUND_RX :
+    case BOUND_TRX: return true;
+    default       : return false;
+  }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::send_pdu(const SharedSmppPdu pdu)
+size_t SessionManager::load()
+{
+  // Used to pick the least busy session: messages awaiting a response, plus messages waiting to be written.
+  return (inFlightCount + pendingPosts + fastLane.size() + txQ->size());
+}
+
+//--------------------------------------------------------------------------------
+bool SessionManager::send_pdu(const SharedSmppPdu pdu)
 {
   // This is the only method that external classes should be allowed to use to get messages on to the PDU queue.
-  // Right now I don't know wither or not I'll be running into concurrency issues, by having multiple
-  // external sources access this one entry point. i.e. This is a subjec for extreme testing.
-  switch(currentState) {
-    case BOUND_TX : send4state_bound_tx (pdu); break;
-    case BOUND_RX : send4state_bound_rx (pdu); break;
-    case BOUND_TRX: send4state_bound_trx(pdu); break;
-    default       : /* throw error         */; break; // can't send without established bind error.
+  // Returns false if the session is not bound, in which case the caller remains responsible for the PDU.
+  if(!isBound()) {
+    return false; // can't send without an established bind.
   }
+
+  ++pendingPosts;
+  strand.post(boost::bind(&SessionManager::do_send_pdu, this, pdu));
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+bool SessionManager::send_group(const std::vector<SharedSmppPdu> &pdus)
+{
+  // The parts of a long message go to one session, in one post, so that nothing gets queued between them.
+  if(!isBound()) {
+    return false;
+  }
+
+  pendingPosts += pdus.size();
+  strand.post(boost::bind(&SessionManager::do_send_group, this, pdus));
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+bool SessionManager::send_fast(const SharedSmppPdu pdu)
+{
+  // Like send_pdu(), but the message goes into fastLane instead of the persisted txQ. The caller keeps
+  // responsibility for the PDU when false is returned, and is expected to fall back to the persisted path.
+  if(!isBound() || !Dispatch::outboundPermitted(currentState, pdu->command_id)) {
+    return false;
+  }
+
+  if(!fastLane.push(pdu)) {
+    statInc(statPrefix + "fast-lane.full");
+    return false;
+  }
+
+  if(!fastLanePosted.exchange(true)) { // one drain serves every push made before it runs.
+    strand.post(boost::bind(&SessionManager::drain_fast_lane, this));
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::drain_fast_lane()
+{
+  fastLanePosted = false; // before looking at the ring, so that a push from here on posts again.
+  write_next();
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::do_send_pdu(const SharedSmppPdu pdu)
+{
+  --pendingPosts;
+
+  if(!isBound()) {
+    do_write(pdu, TransmitQ::MESSAGE); // the bind was lost after send_pdu(). The message waits in the txQ,
+    return;                            // or is released to another session, when close_connection() runs.
+  }
+
+  if(Dispatch::outboundPermitted(currentState, pdu->command_id)) {
+    KLOG(DEBUG) << "posting PDU to txQ." << kisscpp::manip::flush;
+    do_write(pdu, TransmitQ::MESSAGE);
+  } else {
+    statInc(statPrefix + "pdu.unsupported");
+    KLOG(WARNING) << "unsupported PDU, command_id 0x" << std::hex << (uint32_t)pdu->command_id << std::dec
+                  << " in state " << (unsigned)currentState.load() << kisscpp::manip::flush;
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::do_send_group(const std::vector<SharedSmppPdu> pdus)
+{
+  // Every part is queued before write_next() runs, so the parts are written back to back, as far as the window allows.
+  pendingPosts -= pdus.size();
+
+  for(std::vector<SharedSmppPdu>::const_iterator i = pdus.begin(); i != pdus.end(); ++i) {
+    if(!isBound() || Dispatch::outboundPermitted(currentState, (*i)->command_id)) {
+      txQ->push(*i, TransmitQ::MESSAGE);
+    } else {
+      statInc(statPrefix + "pdu.unsupported");
+      KLOG(WARNING) << "unsupported PDU, command_id 0x" << std::hex << (uint32_t)(*i)->command_id << std::dec
+                    << " in state " << (unsigned)currentState.load() << kisscpp::manip::flush;
+    }
+  }
+
+  write_next();
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::stop()
+{
+  strand.post(boost::bind(&SessionManager::do_stop, this));
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::do_stop()
+{
+  stopFlag = true;
+  close_session(false);
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::close_session(bool re_connect /* = false */)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
   reconnectFlag = re_connect;
 
   switch(currentState) {
@@ -167,142 +397,250 @@ void SessionManager::close_session(bool re_connect /* = false */)
       break;
   };
 
-  log << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-  io_service_.post(boost::bind(&SessionManager::close_connection, this));
+  KLOG(DEBUG) << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+  strand.post(boost::bind(&SessionManager::close_connection, this));
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::start_session()
 {
-  startTime            = boost::posix_time::microsec_clock::local_time();
+  startTime        = boost::posix_time::microsec_clock::local_time();
+  connectStartTime = startTime;
+
+  resolve_endpoints();
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::resolve_endpoints()
+{
+  tcp::resolver           resolver(io_service_);
+  tcp::resolver::query    query(CFG->get<std::string>("message-centre.host"),
+                                CFG->get<std::string>("message-centre.port"));
+  tcp::resolver::iterator end;
 
-  tcp::resolver        resolver(io_service_);
-  tcp::resolver::query query(CFG->get<std::string>("message-centre.host"),
-                             CFG->get<std::string>("message-centre.port"));
+  endpoints.clear();
+  endpointIndex = 0;
+
+  for(tcp::resolver::iterator i = resolver.resolve(query); i != end; ++i) {
+    endpoints.push_back(i->endpoint());
+  }
 
-  endpoint_iterator    = resolver.resolve(query);
-  throttleNextSendTime = boost::posix_time::microsec_clock::local_time();
-  timeBetweenSends     = 1000000/smppcfg.getTxThrottleLimit(); //1000000 micro seconds in a second.
+  KLOG(INFO) << "Message centre resolved to " << endpoints.size() << " address(es)." << kisscpp::manip::flush;
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::close_connection()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   setCurrentState(SessionManager::CLOSED);
 
-  log << "Canceling timers." << kisscpp::manip::flush;
+  KLOG(DEBUG) << "Canceling timers." << kisscpp::manip::flush;
   enquire_link_timer.cancel();
   enquire_link_response_timer.cancel();
   w4rQ_ageing_timer.cancel();
+  throttle_timer.cancel();
   txQ->clearSessionQueues();
+  release_messages();
 
-  log << "Closing Socket with read count: [" << readCount
-      << "] and write count ["               << writeCount
-      << "] start time : "                   << boost::posix_time::to_iso_string(startTime)
-      << kisscpp::manip::flush;
+  KLOG(INFO) << "Closing Socket with read count: [" << readCount
+             << "] and write count ["               << writeCount
+             << "] start time : "                   << boost::posix_time::to_iso_string(startTime)
+             << kisscpp::manip::flush;
 
   socket_.close();
-  log << "Socket Closed." << kisscpp::manip::flush;
+  KLOG(DEBUG) << "Socket Closed." << kisscpp::manip::flush;
 
   if(!stopFlag && reconnectFlag) {
-    reconnectFlag = false;
-    sleep(1); // TODO; make the delay between re-connect attempts configurable.
-    connect();
+    reconnectFlag    = false;
+    connectStartTime = boost::posix_time::microsec_clock::local_time();
+    schedule_reconnect(reconnectBackoff.next());
+  } else if(stopFlag) {
+    reconnect_timer.cancel();
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::handle_connect(const boost::system::error_code& error)
+static bool isSessionManagementPdu(uint32_t commandId)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  switch(commandId) {
+    case smpp_pdu::CommandId::BindReceiver   :
+    case smpp_pdu::CommandId::BindTransmitter:
+    case smpp_pdu::CommandId::BindTransceiver:
+    case smpp_pdu::CommandId::EnquireLink    :
+    case smpp_pdu::CommandId::GenericNack    :
+    case smpp_pdu::CommandId::Outbind        :
+    case smpp_pdu::CommandId::Unbind         : return true;
+    default                                  : return false;
+  }
+}
 
-  if (!error) {
-    log << "Connected" << kisscpp::manip::flush;
+//--------------------------------------------------------------------------------
+// Messages that were not written, may go out on another connection. Responses and
+// session management PDU's are meaningless there.
+static bool isReleasable(uint32_t commandId)
+{
+  return (commandId < smpp_pdu::CommandId::BindReceiverResp && !isSessionManagementPdu(commandId));
+}
 
-    setCurrentState(SessionManager::OPEN);
+//--------------------------------------------------------------------------------
+void SessionManager::release_messages()
+{
+  // Hands the messages this session is responsible for, to the orphan handler, so that healthy sessions
+  // can deliver them. Messages that were sent, but not acknowledged, are always released.
+  // Queued messages are only released when the connection dropped. When stopping, they stay in the persisted txQ.
+  if(!orphanHandler) {
+    return;
+  }
 
-    do_bind_request();
+  std::vector<SharedSmppPdu> orphans;
 
-    SharedRawPdu trpdu;
-    trpdu.reset(new RawPdu());
+  {
+    std::vector<SharedSmppPdu> unacknowledged;
 
-    boost::asio::async_read(socket_,
-                            boost::asio::buffer(trpdu->headerBuf(), 16),
-                            boost::bind(&SessionManager::handle_read_header, this, trpdu, boost::asio::placeholders::error));
-  } else {
-    log << "Connection failed: [" << error.message() << "]" << kisscpp::manip::flush;
-    if(!stopFlag) {
-      log << "Next connection attempt in 5 seconds." << kisscpp::manip::flush;
-      sleep(5); // TODO: should be configurable.
-      connect();
-    } else {
-      log << "No further connection attempts will be made" << kisscpp::manip::flush;
+    w4rQ.drain(unacknowledged);
+    for(std::vector<SharedSmppPdu>::iterator i = unacknowledged.begin(); i != unacknowledged.end(); ++i) {
+      if(!isSessionManagementPdu((*i)->command_id)) {
+        orphans.push_back(*i);
+      }
+    }
+    update_in_flight();
+  }
+
+  // An outstanding write is aborted when the socket closes. Its messages are released along with the rest,
+  // instead of going back into this session's txQ from handle_write(). writeBuffers stays, until handle_write().
+  for(std::vector<SharedSmppPdu>::iterator i = writeBatch.begin(); i != writeBatch.end(); ++i) {
+    if(isReleasable((*i)->command_id)) {
+      orphans.push_back(*i);
+    }
+  }
+  writeBatch.clear();
+
+  if(!stopFlag) {
+    while(!txQ->empty()) {
+      SharedSmppPdu pdu = txQ->pop();
+      if(pdu) {
+        orphans.push_back(pdu);
+      }
+    }
+  }
+
+  {
+    SharedSmppPdu pdu;                 // the fast lane is not persisted, so its messages are released
+    while(fastLane.pop(pdu)) {         // even when stopping. Whoever takes them may persist them.
+      orphans.push_back(pdu);
     }
   }
+
+  KLOG(INFO) << "Releasing " << orphans.size() << " message(s)." << kisscpp::manip::flush;
+
+  if(!orphans.empty()) {
+    orphanHandler(orphans); // in one go, and in order, so the parts of a long message stay together.
+  }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::handle_read_header(SharedRawPdu rawpdu, const boost::system::error_code& error)
+void SessionManager::handle_connect(const boost::system::error_code& error)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  if (!error) {
+    KLOG(INFO) << "Connected" << kisscpp::manip::flush;
 
-  if(!error) {
-    log << "Header Read success: Command Length [" << rawpdu->cmd_length()
-        << "] body length ["                       << rawpdu->bodyLength()
-        << "]" << kisscpp::manip::flush;
+    setCurrentState(SessionManager::OPEN);
 
-    boost::asio::async_read(socket_,
-                            boost::asio::buffer(rawpdu->bodyBuf(), rawpdu->bodyLength()),
-                            boost::bind(&SessionManager::handle_read_body, this, rawpdu, boost::asio::placeholders::error));
-  } else {
-    log << "Error - closing. [" << error.message() << "]" << kisscpp::manip::flush;
+    do_bind_request();
+    set_w4rQ_ageing_timer(); // close_connection() cancelled it.
 
+    rxBuffer.clear(); // anything left over belonged to the previous connection.
+    start_read();
+  } else {
+    KLOG(WARNING) << "Connection failed: [" << error.message() << "]" << kisscpp::manip::flush;
     if(!stopFlag) {
-      if(error == boost::asio::error::eof) {
-        setCurrentState(SessionManager::CLOSED);
-        reconnectFlag = true;
-        log << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-        io_service_.post(boost::bind(&SessionManager::close_connection, this));
+      endpointIndex = (endpointIndex + 1) % endpoints.size();
+
+      if(endpointIndex != 0) { // there are addresses we have not tried yet during this round.
+        connect();
       } else {
-        log << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-        close_session(true);
+        schedule_reconnect(reconnectBackoff.next());
       }
+    } else {
+      KLOG(INFO) << "No further connection attempts will be made" << kisscpp::manip::flush;
     }
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::handle_read_body(SharedRawPdu rawpdu, const boost::system::error_code& error)
+void SessionManager::schedule_reconnect(const boost::posix_time::time_duration &delay)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  KLOG(INFO) << "Next connection attempt in " << delay.total_milliseconds() << " milliseconds." << kisscpp::manip::flush;
+  statInc(statPrefix + "reconnect-attempts");
+
+  reconnect_timer.expires_from_now(delay);
+  reconnect_timer.async_wait(strand.wrap(boost::bind(&SessionManager::handle_reconnect_timer, this, boost::asio::placeholders::error)));
+}
 
+//--------------------------------------------------------------------------------
+void SessionManager::handle_reconnect_timer(const boost::system::error_code& error)
+{
+  if(error != boost::asio::error::operation_aborted && !stopFlag) {
+    connect();
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::start_read()
+{
+  rxBuffer.prepare();
+  socket_.async_read_some(boost::asio::buffer(rxBuffer.writePtr(), rxBuffer.writeSpace()),
+                          strand.wrap(boost::bind(&SessionManager::handle_read,
+                                                  this,
+                                                  boost::asio::placeholders::error,
+                                                  boost::asio::placeholders::bytes_transferred)));
+}
+
+//--------------------------------------------------------------------------------
+void SessionManager::handle_read(const boost::system::error_code& error, size_t bytesRead)
+{
   if(!error) {
-    w4rQ_pop     (rawpdu);
-    process4state(rawpdu);
+    RawPdu                rawpdu;
+    RxBuffer::FrameStatus status;
+
+    rxBuffer.commit(bytesRead);
+
+    while((status = rxBuffer.nextFrame(rawpdu)) == RxBuffer::FRAME_READY) { // process every complete PDU we have.
+      TRACE_RING->record(PduTraceRing::RX, sessionId, rawpdu.data(), rawpdu.cmd_length());
+
+      if(pduTrace) {
+        trace_pdu("Recieved", rawpdu.data(), rawpdu.cmd_length());
+      }
 
-    SharedRawPdu nextRawPdu;
-    nextRawPdu.reset(new RawPdu());
+      if(rawpdu.cmd_id() != smpp_pdu::CommandId::DeliverSm) {
+        push_deliveries(); // whatever this PDU does, it does after the deliver_sms in front of it.
+      }
+
+      w4rQ_pop     (rawpdu);
+      process4state(rawpdu);
 
-    readCount++;
-    log << "Reading count: " << readCount << kisscpp::manip::flush;
-    statInc("pdu.recieved");
+      readCount++;
+      statInc("pdu.recieved");
+    }
 
-    boost::asio::async_read(socket_,
-                            boost::asio::buffer(nextRawPdu->headerBuf(), 16),
-                            boost::bind(&SessionManager::handle_read_header, this, nextRawPdu, boost::asio::placeholders::error));
+    push_deliveries();
+
+    if(status == RxBuffer::FRAME_INVALID) {
+      KLOG(ERROR) << "Invalid command length in PDU header. CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+      close_session(true);
+    } else {
+      start_read();
+    }
   } else {
-    log << "handle_read_body: error - closing. [" << error.message() << "]" << kisscpp::manip::flush;
+    KLOG(WARNING) << "Read error - closing. [" << error.message() << "]" << kisscpp::manip::flush;
 
-    if(!stopFlag) {
+    if(!stopFlag && error != boost::asio::error::operation_aborted) { // aborted: close_connection() closed the socket, it decides on re-connecting.
       if(error == boost::asio::error::eof) {
         setCurrentState(SessionManager::CLOSED);
         reconnectFlag = true;
-        log << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-        io_service_.post(boost::bind(&SessionManager::close_connection, this));
+        KLOG(DEBUG) << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+        strand.post(boost::bind(&SessionManager::close_connection, this));
       } else {
-        log << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+        KLOG(DEBUG) << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
         close_session(true);
       }
     }
@@ -312,84 +650,130 @@ void SessionManager::handle_read_body(SharedRawPdu rawpdu, const boost::system::
 //--------------------------------------------------------------------------------
 void SessionManager::handle_write(const boost::system::error_code& error)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   if(!error) {
-    boost::lock_guard<boost::mutex> guard(writeMutex);
-    w4rQ_put(txQ->last_pop_object()); // here, because it's the only point at wich we know that a PDU was successfully sent.
-
-    if(canSend() && !txQ->empty()) {
-      write_pdu();
+    for(std::vector<SharedSmppPdu>::iterator i = writeBatch.begin(); i != writeBatch.end(); ++i) {
+      w4rQ_put(*i); // here, because it's the only point at wich we know that a PDU was successfully sent.
     }
+
+    writeBatch  .clear();
+    writeBuffers.clear();
+    writeInProgress = false;
+    write_next();
   } else {
-    log << "Handle Write error. [" << error.message() << "]" << kisscpp::manip::flush;
-    txQ->push_back_last_pop();
+    KLOG(WARNING) << "Handle Write error. [" << error.message() << "]" << kisscpp::manip::flush;
 
-    if(!stopFlag) {
+    for(std::vector<SharedSmppPdu>::iterator i = writeBatch.begin(); i != writeBatch.end(); ++i) { // empty if close_connection() released it.
+      if(isReleasable((*i)->command_id)) {
+        txQ->push(*i, TransmitQ::MESSAGE);
+      }
+    }
+
+    writeBatch  .clear();
+    writeBuffers.clear();
+    writeInProgress = false;
+
+    if(!stopFlag && error != boost::asio::error::operation_aborted) {
       setCurrentState(SessionManager::CLOSED);
       reconnectFlag = true;
-      log << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-      io_service_.post(boost::bind(&SessionManager::close_connection, this));
+      KLOG(DEBUG) << "ASYNC CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+      strand.post(boost::bind(&SessionManager::close_connection, this));
     }
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::throttle_check()
+bool SessionManager::throttle_check()
 {
-  kisscpp::LogStream      log(__PRETTY_FUNCTION__);
-  boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
-  if(now < throttleNextSendTime) {
-    boost::posix_time::time_duration td = throttleNextSendTime - now;
-    log << "Sleeping for " << td.total_microseconds() << " microseconds" << kisscpp::manip::flush;
-    usleep(td.total_microseconds());
-  } else {
-    log << "Not sleeping." << kisscpp::manip::flush;
+  // Returns true if a message may be written now. Otherwise the write is deferred
+  // to throttle_timer, so that the io_service thread is never put to sleep.
+  int64_t now = TokenBucket::now();
+
+  if(txThrottle.consume(now)) {
+    return true;
   }
-  throttleNextSendTime = now + boost::posix_time::microseconds(timeBetweenSends);
+
+  int64_t waitUs = txThrottle.timeUntilAvailable(now);
+  KLOG(DEBUG) << "Throttled for " << waitUs << " microseconds" << kisscpp::manip::flush;
+
+  throttleWaiting   = true;
+  throttleWaitStart = now;
+  statInc(statPrefix + "throttle.waits");
+
+  throttle_timer.expires_from_now(boost::chrono::microseconds(waitUs));
+  throttle_timer.async_wait(strand.wrap(boost::bind(&SessionManager::handle_throttle_timer, this, boost::asio::placeholders::error)));
+
+  return false;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::do_write(const SharedSmppPdu pdu, unsigned priority /*= TransmitQ::MESSAGE*/)
+void SessionManager::handle_throttle_timer(const boost::system::error_code& error)
 {
-  kisscpp::LogStream             log(__PRETTY_FUNCTION__);
-  boost::lock_guard<boost::mutex> guard(writeMutex);
+  throttleWaiting   = false;
+  throttleWaitTime += TokenBucket::now() - throttleWaitStart;
+  statSet(statPrefix + "throttle.wait-us", throttleWaitTime);
 
-  bool write_in_progress = writing(); // if the queue is not empty, we are busy writing.
+  if(error != boost::asio::error::operation_aborted) {
+    write_next();
+  }
+}
 
+//--------------------------------------------------------------------------------
+void SessionManager::do_write(const SharedSmppPdu pdu, unsigned priority /*= TransmitQ::MESSAGE*/)
+{
   txQ->push(pdu, priority);
+  write_next();
+}
+
+//--------------------------------------------------------------------------------
+size_t SessionManager::add_to_write_batch(SharedSmppPdu pdu)
+{
+  // Returns the encoded size of the PDU.
+  if(pdu->sequence_number <= smpp_pdu::SequenceNumber::Min) {
+    pdu->sequence_number = seqNumGen.next();
+  }
+
+  //w4rQ_put(pdu); only once a pdu is sent does it go into the "waiting for response" queue
+  writeBuffers.push_back(std::string());
+  pdu->encode().swap(writeBuffers.back()); // the one and only time this PDU gets encoded. Swapped in, not copied.
+
+  const std::string &wire = writeBuffers.back();
+  const uint8_t     *data = reinterpret_cast<const uint8_t*>(wire.data());
 
-  if(!write_in_progress) {
-    write_pdu();
+  TRACE_RING->record(PduTraceRing::TX, sessionId, data, wire.size());
+
+  if(pduTrace) {
+    trace_pdu("Sending", data, wire.size());
   }
+
+  writeBatch.push_back(pdu);
+
+  return wire.size();
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::write_pdu()
+void SessionManager::write_batch()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-  SharedSmppPdu       pdu2send = txQ->pop();
+  std::vector<boost::asio::const_buffer> buffers;
 
-  if(pdu2send->sequence_number <= smpp_pdu::SequenceNumber::Min) {
-    pdu2send->sequence_number = seqNumGen.next();
+  for(std::vector<std::string>::iterator i = writeBuffers.begin(); i != writeBuffers.end(); ++i) {
+    buffers.push_back(boost::asio::buffer(*i)); // writeBuffers is left alone until handle_write(), so these stay valid.
   }
 
-  //w4rQ_put(pdu2send); only once a pdu is sent does it go into the "waiting for response" queue
-  print_pdu(pdu2send);
-  std::string tbuf = pdu2send->encode();
-  throttle_check();
-  writeCount++;
+  writeCount     += writeBatch.size();
+  writeInProgress = true;
+  statInc(txBatchStats[batchSizeBucket(writeBatch.size())]);
+
   boost::asio::async_write(socket_,
-                           boost::asio::buffer(tbuf.c_str(), tbuf.size()),
-                           boost::bind(&SessionManager::handle_write, this, boost::asio::placeholders::error));
-  statInc("pdu.sent");
+                           buffers,
+                           strand.wrap(boost::bind(&SessionManager::handle_write, this, boost::asio::placeholders::error)));
+
+  statSet(pduSentStat, pduSentTotal.fetch_add(writeBatch.size()) + writeBatch.size());
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::do_bind_request()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-  SharedPduBindType   bindRequestPDU;
+  SharedPduBindType bindRequestPDU;
 
   switch(smppcfg.getTypeOfBind()) {
     case TX : bindRequestPDU.reset(new smpp_pdu::PDU_bind_transmitter()); break;
@@ -414,108 +798,38 @@ void SessionManager::do_bind_request()
 //--------------------------------------------------------------------------------
 void SessionManager::do_unbind_request()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-  SharedPduUnbind     unbindRequestPDU;
+  SharedPduUnbind unbindRequestPDU;
   unbindRequestPDU.reset(new smpp_pdu::PDU_unbind());
   //unbindRequestPDU->sequence_number = seqNumGen.next();
   do_write(unbindRequestPDU, TransmitQ::SESSION);
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::send4state_bound_tx(const SharedSmppPdu pdu)
-{
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(pdu->command_id) {
-    case smpp_pdu::CommandId::BroadcastSm      :
-    case smpp_pdu::CommandId::CancelBroadcastSm:
-    case smpp_pdu::CommandId::CancelSm         :
-    case smpp_pdu::CommandId::DataSm           :
-    case smpp_pdu::CommandId::QueryBroadcastSm :
-    case smpp_pdu::CommandId::QuerySm          :
-    case smpp_pdu::CommandId::ReplaceSm        :
-    case smpp_pdu::CommandId::SubmitMulti      :
-    case smpp_pdu::CommandId::SubmitSm         :
-      log << "posting PDU to txQ." << kisscpp::manip::flush;
-      do_write(pdu, TransmitQ::MESSAGE);
-      break;
-    default:
-      log << "unsupported PDU." << kisscpp::manip::flush;
-      break;
-  }
-}
-
-//--------------------------------------------------------------------------------
-void SessionManager::send4state_bound_rx(const SharedSmppPdu pdu)
-{
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(pdu->command_id) {
-    case smpp_pdu::CommandId::DataSmResp     :
-    case smpp_pdu::CommandId::DeliverSmResp  :
-      log << "posting PDU to txQ." << kisscpp::manip::flush;
-      do_write(pdu, TransmitQ::MESSAGE);
-      break;
-  default :
-      log << "unsupported PDU" << kisscpp::manip::flush;
-      break;
-  }
-}
-
-//--------------------------------------------------------------------------------
-void SessionManager::send4state_bound_trx(const SharedSmppPdu pdu)
-{
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(pdu->command_id) {
-    case smpp_pdu::CommandId::BroadcastSm      :
-    case smpp_pdu::CommandId::CancelBroadcastSm:
-    case smpp_pdu::CommandId::CancelSm         :
-    case smpp_pdu::CommandId::DataSm           :
-    case smpp_pdu::CommandId::DataSmResp       :
-    case smpp_pdu::CommandId::DeliverSmResp    :
-    case smpp_pdu::CommandId::QueryBroadcastSm :
-    case smpp_pdu::CommandId::QuerySm          :
-    case smpp_pdu::CommandId::ReplaceSm        :
-    case smpp_pdu::CommandId::SubmitMulti      :
-    case smpp_pdu::CommandId::SubmitSm         :
-      log << "posting PDU to txQ." << kisscpp::manip::flush;
-      do_write(pdu, TransmitQ::MESSAGE);
-      break;
-    default :
-      log << "unsupported PDU"     << kisscpp::manip::flush;
-      break;
-  }
-}
+bool SessionManager::dispatchTablesBuilt = SessionManager::Dispatch::build();
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state(SharedRawPdu rawpdu)
+void SessionManager::process4state(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   reschedule_enquire_link(); // we have a full SMPP PDU. the next enquire link should be delayed.
 
   try {
-    switch(currentState) {
-      case BOUND_TX : process4state_bound_tx (rawpdu); break;
-      case BOUND_RX : process4state_bound_rx (rawpdu); break;
-      case BOUND_TRX: process4state_bound_trx(rawpdu); break;
-      case OPEN     : process4state_open     (rawpdu); break;
-      case OUTBOUND : process4state_outbound (rawpdu); break;
-      case UNBOUND  : process4state_unbound  (rawpdu); break;
-      case CLOSED   : process4state_closed   (rawpdu); break;
-      default       :
-                      // This should NEVER Happen
-                      std::stringstream ss;
-                      ss << "Session manager - Fatal Exceptoin: Unrecognised State: [" << __PRETTY_FUNCTION__ << "]";
-                      throw std::runtime_error(ss.str());
-                      break;
+    State st = currentState;
+
+    if((unsigned)st >= Dispatch::STATE_COUNT) {
+      // This should NEVER Happen
+      std::stringstream ss;
+      ss << "Session manager - Fatal Exceptoin: Unrecognised State: [" << __PRETTY_FUNCTION__ << "]";
+      throw std::runtime_error(ss.str());
     }
+
+    Dispatch::dispatch(*this, st, rawpdu);
   } catch(std::runtime_error &e) {
-    log << "Command Length: "         << rawpdu->cmd_length() << kisscpp::manip::flush;
+    kisscpp::LogStream log(__PRETTY_FUNCTION__);
+
+    log << "Command Length: "         << rawpdu.cmd_length() << kisscpp::manip::flush;
     log << "Failure to process PDU: " << e.what()             << kisscpp::manip::flush;
     std::stringstream ss;
-    smpp_pdu::hex_dump(rawpdu->data(), rawpdu->cmd_length(), ss);
+    smpp_pdu::hex_dump(rawpdu.data(), rawpdu.cmd_length(), ss);
     log << "ERROR PDU:\n" << ss.str() << kisscpp::manip::flush;
     log << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
     close_session(true);
@@ -523,141 +837,56 @@ void SessionManager::process4state(SharedRawPdu rawpdu)
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state_open(SharedRawPdu rawpdu)
+void SessionManager::procpdu_unhandled(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(rawpdu->cmd_id()) {
-    case smpp_pdu::CommandId::BindReceiverResp   : procpdu_bind_resp        (rawpdu, BOUND_RX ); break;
-    case smpp_pdu::CommandId::BindTransmitterResp: procpdu_bind_resp        (rawpdu, BOUND_TX ); break;
-    case smpp_pdu::CommandId::BindTransceiverResp: procpdu_bind_resp        (rawpdu, BOUND_TRX); break;
-    case smpp_pdu::CommandId::EnquireLink        : procpdu_enquire_link     (rawpdu);            break;
-    case smpp_pdu::CommandId::EnquireLinkResp    : procpdu_enquire_link_resp(rawpdu);            break;
-    case smpp_pdu::CommandId::GenericNack        : procpdu_generic_nack     (rawpdu);            break;
-    case smpp_pdu::CommandId::Outbind            : do_bind_request(); break;
-    default                                      : break;
-  }
+  statInc(statPrefix + "pdu.unhandled");
+  KLOG(WARNING) << "No handler for command_id 0x" << std::hex << rawpdu.cmd_id() << std::dec
+                << " in state " << (unsigned)currentState.load() << kisscpp::manip::flush;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state_bound_tx(SharedRawPdu rawpdu)
+void SessionManager::procpdu_outbind(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(rawpdu->cmd_id()) {
-    case smpp_pdu::CommandId::BroadcastSmResp      : procpdu_broadcast_sm_resp       (rawpdu); break;
-    case smpp_pdu::CommandId::CancelBroadcastSmResp: procpdu_cancel_broadcast_sm_resp(rawpdu); break;
-    case smpp_pdu::CommandId::CancelSmResp         : procpdu_cancel_sm_resp          (rawpdu); break;
-    case smpp_pdu::CommandId::DataSmResp           : procpdu_data_sm_resp            (rawpdu); break;
-    case smpp_pdu::CommandId::QueryBroadcastSmResp : procpdu_query_broadcast_sm_resp (rawpdu); break;
-    case smpp_pdu::CommandId::QuerySmResp          : procpdu_query_sm_resp           (rawpdu); break;
-    case smpp_pdu::CommandId::ReplaceSmResp        : procpdu_replace_sm_resp         (rawpdu); break;
-    case smpp_pdu::CommandId::SubmitMultiResp      : procpdu_submit_multi_resp       (rawpdu); break;
-    case smpp_pdu::CommandId::SubmitSmResp         : procpdu_submit_sm_resp          (rawpdu); break;
-    case smpp_pdu::CommandId::Unbind               : procpdu_unbind                  (rawpdu); break;
-    case smpp_pdu::CommandId::UnbindResp           : procpdu_unbind_resp             (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLink          : procpdu_enquire_link            (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLinkResp      : procpdu_enquire_link_resp       (rawpdu); break;
-    case smpp_pdu::CommandId::GenericNack          : procpdu_generic_nack            (rawpdu); break;
-    default                                        : break;
-  }
+  do_bind_request();
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state_bound_rx(SharedRawPdu rawpdu)
+void SessionManager::procpdu_bind_receiver_resp(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(rawpdu->cmd_id()) {
-    case smpp_pdu::CommandId::AlertNotification: procpdu_alert_notification(rawpdu); break;
-    case smpp_pdu::CommandId::DataSm           : procpdu_data_sm           (rawpdu); break;
-    case smpp_pdu::CommandId::DeliverSm        : procpdu_deliver_sm        (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLink      : procpdu_enquire_link      (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLinkResp  : procpdu_enquire_link_resp (rawpdu); break;
-    case smpp_pdu::CommandId::GenericNack      : procpdu_generic_nack      (rawpdu); break;
-    case smpp_pdu::CommandId::Unbind           : procpdu_unbind            (rawpdu); break;
-    case smpp_pdu::CommandId::UnbindResp       : procpdu_unbind_resp       (rawpdu); break;
-    default                                    : break;
-  }
+  procpdu_bind_resp(rawpdu, BOUND_RX);
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state_bound_trx(SharedRawPdu rawpdu)
+void SessionManager::procpdu_bind_transmitter_resp(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(rawpdu->cmd_id()) {
-    case smpp_pdu::CommandId::AlertNotification    : procpdu_alert_notification      (rawpdu); break;
-    case smpp_pdu::CommandId::BroadcastSmResp      : procpdu_broadcast_sm_resp       (rawpdu); break;
-    case smpp_pdu::CommandId::CancelBroadcastSmResp: procpdu_cancel_broadcast_sm_resp(rawpdu); break;
-    case smpp_pdu::CommandId::CancelSmResp         : procpdu_cancel_sm_resp          (rawpdu); break;
-    case smpp_pdu::CommandId::DataSm               : procpdu_data_sm                 (rawpdu); break;
-    case smpp_pdu::CommandId::DataSmResp           : procpdu_data_sm_resp            (rawpdu); break;
-    case smpp_pdu::CommandId::DeliverSm            : procpdu_deliver_sm              (rawpdu); break;
-    case smpp_pdu::CommandId::QueryBroadcastSmResp : procpdu_query_broadcast_sm_resp (rawpdu); break;
-    case smpp_pdu::CommandId::QuerySmResp          : procpdu_query_sm_resp           (rawpdu); break;
-    case smpp_pdu::CommandId::ReplaceSmResp        : procpdu_replace_sm_resp         (rawpdu); break;
-    case smpp_pdu::CommandId::SubmitMultiResp      : procpdu_submit_multi_resp       (rawpdu); break;
-    case smpp_pdu::CommandId::SubmitSmResp         : procpdu_submit_sm_resp          (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLink          : procpdu_enquire_link            (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLinkResp      : procpdu_enquire_link_resp       (rawpdu); break;
-    case smpp_pdu::CommandId::GenericNack          : procpdu_generic_nack            (rawpdu); break;
-    case smpp_pdu::CommandId::Unbind               : procpdu_unbind                  (rawpdu); break;
-    case smpp_pdu::CommandId::UnbindResp           : procpdu_unbind_resp             (rawpdu); break;
-    default                                        : break;
-  }
+  procpdu_bind_resp(rawpdu, BOUND_TX);
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state_unbound(SharedRawPdu rawpdu)
+void SessionManager::procpdu_bind_transceiver_resp(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(rawpdu->cmd_id()) {
-    case smpp_pdu::CommandId::EnquireLink    : procpdu_enquire_link     (rawpdu); break;
-    case smpp_pdu::CommandId::EnquireLinkResp: procpdu_enquire_link_resp(rawpdu); break;
-    case smpp_pdu::CommandId::GenericNack    : procpdu_generic_nack     (rawpdu); break;
-    default                                  : /*TODO: throw & log error */       break;
-  }
-}
-
-//--------------------------------------------------------------------------------
-void SessionManager::process4state_closed(SharedRawPdu rawpdu)
-{
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-  // one should not be able to recieve during a closed state!!!
+  procpdu_bind_resp(rawpdu, BOUND_TRX);
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::process4state_outbound(SharedRawPdu rawpdu)
+void SessionManager::procpdu_bind_resp(RawPdu &rawpdu, State stateAferSuccess)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  switch(rawpdu->cmd_id()) {
-    case smpp_pdu::CommandId::BindReceiverResp   : procpdu_bind_resp        (rawpdu, BOUND_RX ); break;
-    case smpp_pdu::CommandId::BindTransmitterResp: procpdu_bind_resp        (rawpdu, BOUND_TX ); break;
-    case smpp_pdu::CommandId::BindTransceiverResp: procpdu_bind_resp        (rawpdu, BOUND_TRX); break;
-    case smpp_pdu::CommandId::EnquireLink        : procpdu_enquire_link     (rawpdu);            break;
-    case smpp_pdu::CommandId::EnquireLinkResp    : procpdu_enquire_link_resp(rawpdu);            break;
-    case smpp_pdu::CommandId::GenericNack        : procpdu_generic_nack     (rawpdu);            break;
-    default                                      : /*TODO: throw & log error */                  break;
-  }
-}
+  if(rawpdu.cmd_status() == smpp_pdu::CommandStatus::ESME_ROK) {
+    setCurrentState(stateAferSuccess);
 
-//--------------------------------------------------------------------------------
-void SessionManager::procpdu_bind_resp(SharedRawPdu rawpdu, State stateAferSuccess)
-{
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+    reconnectBackoff.reset();
+    statSet(statPrefix + "time-to-bind-ms", (boost::posix_time::microsec_clock::local_time() - connectStartTime).total_milliseconds());
 
-  if(rawpdu->cmd_status() == smpp_pdu::CommandStatus::ESME_ROK) {
-    setCurrentState(stateAferSuccess);
+    write_next(); // messages may have been queued while we were waiting for the bind.
   } else {
-    //TODO: some form of error processing needed here.
+    smpp_pdu::CommandStatus cmd_err(rawpdu.cmd_status());
+    KLOG(ERROR) << "Bind failed: " << cmd_err.long_description(cmd_err) << kisscpp::manip::flush;
+    close_session(true); // try again, after the backoff delay.
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_alert_notification(SharedRawPdu rawpdu)
+void SessionManager::procpdu_alert_notification(RawPdu &rawpdu)
 {
   // not supported yet;
 
@@ -665,68 +894,98 @@ void SessionManager::procpdu_alert_notification(SharedRawPdu rawpdu)
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_broadcast_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_broadcast_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_cancel_broadcast_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_cancel_broadcast_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_cancel_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_cancel_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_data_sm(SharedRawPdu rawpdu)
+void SessionManager::procpdu_data_sm(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_data_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_data_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_deliver_sm(SharedRawPdu rawpdu)
+void SessionManager::procpdu_deliver_sm(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-  std::stringstream   ss;
-  SharedSmppPdu       recievedPDU;
-  SharedPduDeliverSm  tpdu;
+  DeliverSmView view(rawpdu); // nothing is decoded here, the consumer of rxQ decodes what it needs.
 
-  smpp_pdu::hex_dump(rawpdu->data(), rawpdu->cmd_length(), ss);
-  log << "Recieved DeliverSM:\n" << ss.str() << kisscpp::manip::flush;
+  SharedPduDeliverSmResp responsePDU = boost::make_shared<smpp_pdu::PDU_deliver_sm_resp>();
 
-  recievedPDU.reset(new smpp_pdu::PDU_deliver_sm(rawpdu->c_str()));
+  responsePDU->sequence_number = rawpdu.seq_num();
 
-  tpdu = boost::dynamic_pointer_cast<smpp_pdu::PDU_deliver_sm>(recievedPDU);
+  if(view.valid()) {
+    responsePDU->command_status = smpp_pdu::CommandStatus::ESME_ROK;
 
-  rxQ->push(recievedPDU);
+    rxDelivered     .push_back(boost::make_shared<std::string>(rawpdu.c_str(), rawpdu.cmd_length()));
+    rxDeliveredResps.push_back(responsePDU); // written by push_deliveries(), once the message is queued.
 
-  if((tpdu->esm_class).bits_set(smpp_pdu::spEsmClass::MSG_TYPE_DLR)) {
-    log << "DLR >";
-  } else if((tpdu->esm_class).bits_set(smpp_pdu::spEsmClass::MSG_TYPE_DEFAULT)) {
-    log << "MSG >";
+    if(KLOG_ENABLED(DEBUG)) {
+      kisscpp::LogStream log(__PRETTY_FUNCTION__);
+      log << (view.isDeliveryReceipt() ? "DLR >" : "MSG >") << view.message() << "<" << kisscpp::manip::flush;
+    }
+  } else {
+    statInc(statPrefix + "pdu.malformed");
+    KLOG(WARNING) << "Malformed deliver_sm, sequence number " << rawpdu.seq_num() << kisscpp::manip::flush;
+    responsePDU->command_status = smpp_pdu::CommandStatus::ESME_RINVMSGLEN;
+    do_write(responsePDU, TransmitQ::RESPONSE);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Queues the deliver_sms read so far in one push_batch(), so that on a durable
+// rxQ they share one commit, rather than each waiting out a commit window of
+// its own on the strand. Only then are they answered. If some could not be
+// queued, the session is closed, and the message centre resends those.
+void SessionManager::push_deliveries()
+{
+  if(rxDelivered.empty()) {
+    return;
   }
 
-  log << (std::string)tpdu->short_message << "<" << kisscpp::manip::flush;
+  size_t queued = rxDelivered.size();
 
-  SharedPduDeliverSmResp responsePDU;
+  try {
+    rxQ->push_batch(rxDelivered);
+  } catch(PartialPushError &e) {
+    KLOG(ERROR) << "Queued " << e.pushed << " of " << rxDelivered.size() << " deliver_sm(s): " << e.what() << kisscpp::manip::flush;
+    queued = e.pushed;
+  } catch(std::exception &e) {
+    KLOG(ERROR) << "Could not queue " << rxDelivered.size() << " deliver_sm(s): " << e.what() << kisscpp::manip::flush;
+    queued = 0;
+  }
 
-  responsePDU.reset(new smpp_pdu::PDU_deliver_sm_resp());
+  for(size_t i = 0; i < queued; ++i) {
+    do_write(rxDeliveredResps[i], TransmitQ::RESPONSE);
+  }
 
-  responsePDU->command_status  = smpp_pdu::CommandStatus::ESME_ROK;
-  responsePDU->sequence_number = tpdu->sequence_number;
+  bool failed = (queued < rxDelivered.size());
 
-  do_write(responsePDU, TransmitQ::RESPONSE);
+  rxDelivered     .clear();
+  rxDeliveredResps.clear();
+
+  if(failed) {
+    KLOG(ERROR) << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+    close_session(true);
+  }
 }
 
 // What if we recieve an enquire link, but there are items in txQ?
@@ -734,86 +993,70 @@ void SessionManager::procpdu_deliver_sm(SharedRawPdu rawpdu)
 // -- Could be indicative of a problem we aren't aware of.
 // TODO: work on loging/logic to indicate/prevent this.
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_enquire_link(SharedRawPdu rawpdu)
+void SessionManager::procpdu_enquire_link(RawPdu &rawpdu)
 {
-  kisscpp::LogStream         log(__PRETTY_FUNCTION__);
-  smpp_pdu::PDU_enquire_link recieved_pdu(rawpdu->c_str());
-  SharedPduEnquireLinkResp   responsePDU;
-
-  responsePDU.reset(new smpp_pdu::PDU_enquire_link_resp());
+  SharedPduEnquireLinkResp responsePDU = boost::make_shared<smpp_pdu::PDU_enquire_link_resp>();
 
   responsePDU->command_status  = smpp_pdu::CommandStatus::ESME_ROK;
-  responsePDU->sequence_number = recieved_pdu.sequence_number;
+  responsePDU->sequence_number = rawpdu.seq_num(); // no need to decode the whole PDU, for the one field we need.
 
   do_write(responsePDU, TransmitQ::RESPONSE);
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_enquire_link_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_enquire_link_resp(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   // we have recieved a response to an enquire_link.
   enquire_link_response_timer.cancel();
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_generic_nack(SharedRawPdu rawpdu)
+void SessionManager::procpdu_generic_nack(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_query_broadcast_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_query_broadcast_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_query_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_query_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_replace_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_replace_sm_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_submit_multi_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_submit_multi_resp(RawPdu &rawpdu)
 {
   // not supported yet;
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_submit_sm_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_submit_sm_resp(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-  log << "Command Length: " << rawpdu->cmd_length() << kisscpp::manip::flush;
-  std::stringstream ss;
-  smpp_pdu::hex_dump(rawpdu->data(), rawpdu->cmd_length(), ss);
-  log << "PDU:\n" << ss.str() << kisscpp::manip::flush;
-
-  if(rawpdu->cmd_status() == smpp_pdu::CommandStatus::ESME_ROK) {
-    smpp_pdu::PDU_submit_sm_resp recieved_pdu(rawpdu->c_str());
-
-    log << "seqnum = " << recieved_pdu.sequence_number << kisscpp::manip::flush;
+  if(rawpdu.cmd_status() == smpp_pdu::CommandStatus::ESME_ROK) {
+    KLOG(DEBUG) << "submit_sm_resp seqnum = " << rawpdu.seq_num() << kisscpp::manip::flush;
 
     // TODO: message was delivered. Send notification to internal application.
   } else {
-    smpp_pdu::CommandStatus cmd_err(rawpdu->cmd_status());
-    log << "ERROR: " << cmd_err.long_description(cmd_err) << kisscpp::manip::flush;
+    smpp_pdu::CommandStatus cmd_err(rawpdu.cmd_status());
+    KLOG(WARNING) << "submit_sm_resp ERROR: " << cmd_err.long_description(cmd_err) << kisscpp::manip::flush;
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_unbind(SharedRawPdu rawpdu)
+void SessionManager::procpdu_unbind(RawPdu &rawpdu)
 {
-  kisscpp::LogStream  log(__PRETTY_FUNCTION__);
-  smpp_pdu::PDU_unbind recieved_pdu(rawpdu->c_str());
+  smpp_pdu::PDU_unbind recieved_pdu(rawpdu.c_str());
   SharedSmppPdu        responsePDU;
 
   responsePDU.reset(new smpp_pdu::PDU_unbind_resp());
@@ -827,36 +1070,30 @@ void SessionManager::procpdu_unbind(SharedRawPdu rawpdu)
 
   stopFlag      = false;
   reconnectFlag = true;
-  log << "UNBIND CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-  io_service_.post(boost::bind(&SessionManager::close_connection, this));
+  KLOG(INFO) << "UNBIND CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+  strand.post(boost::bind(&SessionManager::close_connection, this));
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::procpdu_unbind_resp(SharedRawPdu rawpdu)
+void SessionManager::procpdu_unbind_resp(RawPdu &rawpdu)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   setCurrentState(SessionManager::OPEN);
-  log << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+  KLOG(DEBUG) << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
   close_session(false);
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::reschedule_enquire_link()
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   enquire_link_timer.cancel();
   enquire_link_response_timer.cancel();
   enquire_link_timer.expires_from_now(smppcfg.getEnquireLinkTimeout());
-  enquire_link_timer.async_wait(boost::bind(&SessionManager::do_enquire_link, this, boost::asio::placeholders::error));
+  enquire_link_timer.async_wait(strand.wrap(boost::bind(&SessionManager::do_enquire_link, this, boost::asio::placeholders::error)));
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::do_enquire_link(const boost::system::error_code& e)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   if(e != boost::asio::error::operation_aborted) {  // the enquire link timer expired, send an enquire_link pdu to the message centre.
 
     SharedSmppPdu requestPDU;
@@ -866,7 +1103,7 @@ void SessionManager::do_enquire_link(const boost::system::error_code& e)
     do_write(requestPDU, TransmitQ::SESSION);
 
     enquire_link_response_timer.expires_from_now(smppcfg.getEnquireLinkRespTimeout());
-    enquire_link_response_timer.async_wait(boost::bind(&SessionManager::do_enquire_link_failure, this, boost::asio::placeholders::error));
+    enquire_link_response_timer.async_wait(strand.wrap(boost::bind(&SessionManager::do_enquire_link_failure, this, boost::asio::placeholders::error)));
 
   } else {                                         // the enquire link timer was aborted, we don't have to do anything.
   }
@@ -875,69 +1112,69 @@ void SessionManager::do_enquire_link(const boost::system::error_code& e)
 //--------------------------------------------------------------------------------
 void SessionManager::do_enquire_link_failure(const boost::system::error_code& e)
 {
-  kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
   if(e != boost::asio::error::operation_aborted) { // the enquire link response wasn't recieved,
                                                    // the bind is broken and most probably the connection as well.
     if(!stopFlag) {                                // Restart everything.
-      reconnectFlag = true;
-      log << "CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
-      close_session(false);
+      KLOG(WARNING) << "No enquire_link_resp. CLOSE: " << __PRETTY_FUNCTION__ << kisscpp::manip::flush;
+      close_session(true);
     }
   } else {                                         // the enquire link response was recieved, we don't have to do anything.
-    log << "abort detected." << kisscpp::manip::flush;
+    KLOG(DEBUG) << "abort detected." << kisscpp::manip::flush;
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::print_pdu(SharedSmppPdu pdu)
+void SessionManager::trace_pdu(const char *direction, const uint8_t *data, size_t length)
 {
-  kisscpp::LogStream  log(__PRETTY_FUNCTION__);
-  std::string          encodedPdu = pdu->encode();
+  // Only called while pduTrace is set. See TraceHandler.
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  std::stringstream  ss;
 
-  std::stringstream ss;
-  smpp_pdu::hex_dump(reinterpret_cast<const uint8_t*>(encodedPdu.c_str()), encodedPdu.size(), ss);
-  log << "Print PDU:\n" << ss.str() << kisscpp::manip::flush;
+  smpp_pdu::hex_dump(data, length, ss);
+  log << "session " << sessionId << " " << direction << ":\n" << ss.str() << kisscpp::manip::flush;
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::w4rQ_put(SharedSmppPdu pdu)
 {
   if(pdu->command_id < smpp_pdu::CommandId::BindReceiverResp) { // i.e. This IS NOT a response PDU
-    kisscpp::LogStream             log(__PRETTY_FUNCTION__);
-    boost::lock_guard<boost::mutex> guard(w4rQMutex);
-    SharedTimeStampedPdu            stsp;
-    stsp.reset(new timeStampedPdu(pdu));
-    w4rQ[pdu->sequence_number] = stsp;
+    w4rQ.put(pdu);
+    update_in_flight();
   }
 }
 
 //--------------------------------------------------------------------------------
-void SessionManager::w4rQ_pop(SharedRawPdu rawpdu)
+void SessionManager::w4rQ_pop(RawPdu &rawpdu)
 {
-  if(rawpdu->cmd_id() > smpp_pdu::CommandId::GenericNack) { // i.e. this IS a response pdu
-    kisscpp::LogStream             log(__PRETTY_FUNCTION__);
-    boost::lock_guard<boost::mutex> guard(w4rQMutex);
-    AwaitingResponseMapTypeItr      itr = w4rQ.find(rawpdu->seq_num());
-    if(itr != w4rQ.end()) {
-      w4rQ.erase(itr);
-    }
+  if(rawpdu.cmd_id() > smpp_pdu::CommandId::GenericNack) { // i.e. this IS a response pdu
+    w4rQ.pop(rawpdu.seq_num());
+    update_in_flight();
+
+    write_next(); // a slot in the window has opened up, use it immediately.
   }
 }
 
 //--------------------------------------------------------------------------------
 void SessionManager::w4rQ_age_cleanup(const boost::system::error_code& e)
 {
-  if(e != boost::asio::error::operation_aborted && w4rQ.size() > 0) {
-    kisscpp::LogStream             log(__PRETTY_FUNCTION__);
-    boost::lock_guard<boost::mutex> guard(w4rQMutex);
-    for(AwaitingResponseMapTypeItr i = w4rQ.begin(); i != w4rQ.end(); ++i) {
-      if((i->second)->expired(30)) {                         // TODO: Make this time configurable.
-        do_write((i->second)->getObj(), TransmitQ::MESSAGE); // perhaps we'll need to be more specific about the priority here,
-                                                             // the message could be a session level messsage;
-        w4rQ.erase(w4rQ.find((i->second)->pduSeqNum()));
+  if(e != boost::asio::error::operation_aborted) {
+    std::vector<SharedSmppPdu> expired;
+
+    w4rQ.expire(expired);
+    update_in_flight();
+    statSet(inFlightStat, inFlightCount);
+
+    if(!expired.empty()) {
+      KLOG(WARNING) << expired.size() << " PDU(s) got no response within " << smppcfg.getResponseTimeout() << " seconds." << kisscpp::manip::flush;
+
+      for(std::vector<SharedSmppPdu>::iterator i = expired.begin(); i != expired.end(); ++i) {
+        statInc(statPrefix + "response-timeouts");
+        if(!isSessionManagementPdu((*i)->command_id)) { // enquire_link has its own timer, and a bind or unbind is not worth repeating.
+          do_write(*i, TransmitQ::MESSAGE);
+        }
       }
     }
+
     set_w4rQ_ageing_timer();
   }
 }
@@ -945,10 +1182,13 @@ void SessionManager::w4rQ_age_cleanup(const boost::system::error_code& e)
 //--------------------------------------------------------------------------------
 void SessionManager::set_w4rQ_ageing_timer()
 {
-  // TODO: the timer should expire at half the max age of a sent PDU
-  // TODO: this is so that the true max age will never be more than maxage+maxage/2
-  // TODO: Note in the documentation that this should never be set to more than 60 seconds, use 30 seconds as good default.
-  w4rQ_ageing_timer.expires_from_now(smppcfg.getEnquireLinkTimeout()); // TODO: Make this time properly configurable.
-  w4rQ_ageing_timer.async_wait(boost::bind(&SessionManager::w4rQ_age_cleanup, this, boost::asio::placeholders::error));
+  // Advances the w4rQ timing wheel by one tick. See AwaitingResponseTable.
+  w4rQ_ageing_timer.expires_from_now(boost::posix_time::seconds(1));
+  w4rQ_ageing_timer.async_wait(strand.wrap(boost::bind(&SessionManager::w4rQ_age_cleanup, this, boost::asio::placeholders::error)));
 }
 
+//--------------------------------------------------------------------------------
+void SessionManager::update_in_flight()
+{
+  inFlightCount = w4rQ.size(); // the stat is only published once a second, by w4rQ_age_cleanup().
+}
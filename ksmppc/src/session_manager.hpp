@@ -26,99 +26,78 @@
 #include <cstdio>
 #include <stdint.h>
 #include <string>
+#include <stdexcept>
 #include <deque>
-#include <map>
+#include <vector>
 #include <ctime>
 #include <unistd.h>
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/atomic.hpp>
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/locks.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/function.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <smpppdu_all.hpp>
 
 #include <kisscpp/logstream.hpp>
 
+#include "log.hpp"
 #include "cfg.hpp"
 #include "stat.hpp"
-#include "smpppdu_queue.hpp"
+#include "pdu_queue.hpp"
 #include "transmit_queue.hpp"
 #include "smpp_session_config.hpp"
 #include "bind_type.hpp"
 #include "sharedsmpppdu.hpp"
 #include "rawpdu.hpp"
+#include "rx_buffer.hpp"
+#include "token_bucket.hpp"
+#include "reconnect_backoff.hpp"
+#include "awaiting_response_table.hpp"
+#include "sequence_number_generator.hpp"
+#include "deliver_sm_view.hpp"
+#include "pdu_trace.hpp"
+#include "mpsc_ring.hpp"
+#include "session_dispatch.hpp"
 
 using boost::asio::ip::tcp;
 
 
 //--------------------------------------------------------------------------------
-class SequinceNumberGenerator
-{
-  public:
-    SequinceNumberGenerator() : mVal(smpp_pdu::SequenceNumber::Min) {}
-
-    uint32_t next() // Returns the next number in the uniformly incrementing sequence of numbers.
-    {
-      boost::lock_guard<boost::mutex> l(mMtx);
-      if(mVal < smpp_pdu::SequenceNumber::Max) {
-        return mVal++;
-      } else {
-        mVal = smpp_pdu::SequenceNumber::Min;
-        return smpp_pdu::SequenceNumber::Max;
-      }
-    }
-
-  private:
-    uint32_t     mVal;
-    boost::mutex mMtx;
-};
-
-//--------------------------------------------------------------------------------
-class timeStampedPdu
-{
-  public:
-    timeStampedPdu(SharedSmppPdu o)
-    {
-      obj       = o;
-      timestamp = time(NULL);
-    }
-
-    ~timeStampedPdu() {};
-
-    SharedSmppPdu getObj()       { return obj; };
-    time_t        getTimestamp() { return timestamp; };
-    uint32_t      pduSeqNum()    { return (uint32_t)obj->sequence_number; }
-
-    bool expired(time_t seconds)
-    {
-      return ((time(NULL) - timestamp) >= seconds);
-    }
-
-  private:
-    time_t        timestamp;
-    SharedSmppPdu obj;
-};
-
-//--------------------------------------------------------------------------------
-typedef boost::shared_ptr<timeStampedPdu>        SharedTimeStampedPdu;
-typedef std::map<uint32_t, SharedTimeStampedPdu> AwaitingResponseMapType;
-typedef AwaitingResponseMapType::iterator        AwaitingResponseMapTypeItr;
+typedef boost::function<void (const std::vector<SharedSmppPdu>&)> OrphanedPduHandler; // receives, in one call, the messages a session can no longer deliver.
+typedef boost::function<void ()>                 StateChangeHandler; // called, on the session's strand, after every state change.
 
 //--------------------------------------------------------------------------------
+// All of a session's handlers run on its strand, so the io_service may be run
+// by any number of threads. Only send_pdu(), send_fast(), send_group(), stop(), isBound(),
+// load() and getCurrentState() may be called from outside the strand.
 class SessionManager
 {
   public:
-    SessionManager(boost::asio::io_service &io_service, SharedSafeSmppPduQ recieveQueue);
+    SessionManager(boost::asio::io_service &io_service,
+                   SharedPduBytesQueue      recieveQueue,
+                   unsigned                 id           = 0,
+                   OrphanedPduHandler       orphanHandler = OrphanedPduHandler(),
+                   StateChangeHandler       stateHandler  = StateChangeHandler());
     ~SessionManager() {};
 
     enum State { OPEN, BOUND_TX, BOUND_RX, BOUND_TRX, UNBOUND, CLOSED, OUTBOUND }; // Session States
 
-    void   send_pdu           (const SharedSmppPdu pdu);
-    void   stop               ()                        { stopFlag = true; close_session(false); };
-    State &getCurrentState    ()                        { return currentState    ; }
+    bool   send_pdu           (const SharedSmppPdu pdu);
+    bool   send_fast          (const SharedSmppPdu pdu); // in memory only. False if not bound, or the fast lane is full.
+    bool   send_group         (const std::vector<SharedSmppPdu> &pdus); // like send_pdu(), for messages that must stay together, and in order.
+    void   stop               ();
+    State  getCurrentState    ()                        { return currentState    ; }
+    bool   isBound            ();
+    size_t load               ();
+    unsigned getSessionId     ()                        { return sessionId       ; }
+    void   setPduTrace        (bool on)                 { pduTrace = on          ; }
+    bool   getPduTrace        ()                        { return pduTrace        ; }
 
     smpp_pdu::SystemId         &getSystemId        () { return smppcfg.getSystemId        ();}
     smpp_pdu::Password         &getPassword        () { return smppcfg.getPassword        ();}
@@ -130,104 +109,137 @@ class SessionManager
 
   private:
     void close_session                   (bool re_connect = false);
+    void do_stop                         ();
+    void do_send_pdu                     (const SharedSmppPdu pdu);
+    void do_send_group                   (const std::vector<SharedSmppPdu> pdus);
+    void drain_fast_lane                 ();
     void start_session                   ();
+    void resolve_endpoints               ();
     void initiate                        ();
     void setTxq                          ();
     void connect                         ();
     void setCurrentState                 (State p);
-    bool canSend                         ();
-    bool writing                         ();
+    bool canSend                         (size_t inFlight);
+    void write_next                      ();
 
     void handle_connect                  (const boost::system::error_code& error);
-    void handle_read_header              (SharedRawPdu rawpdu, const boost::system::error_code& error);
-    void handle_read_body                (SharedRawPdu rawpdu, const boost::system::error_code& error);
+    void schedule_reconnect              (const boost::posix_time::time_duration &delay);
+    void handle_reconnect_timer          (const boost::system::error_code& error);
+    void start_read                      ();
+    void handle_read                     (const boost::system::error_code& error, size_t bytesRead);
     void handle_write                    (const boost::system::error_code& error);
-    void throttle_check                  ();
+    bool throttle_check                  ();
+    void handle_throttle_timer           (const boost::system::error_code& error);
     void do_write                        (const SharedSmppPdu pdu, unsigned priority = TransmitQ::MESSAGE);
-    void write_pdu                       ();
+    size_t add_to_write_batch            (SharedSmppPdu pdu);
+    void write_batch                     ();
     void close_connection                ();
+    void release_messages                ();
 
     void do_bind_request                 ();
     void do_unbind_request               ();
 
-    void send4state_bound_tx             (const SharedSmppPdu pdu);
-    void send4state_bound_rx             (const SharedSmppPdu pdu);
-    void send4state_bound_trx            (const SharedSmppPdu pdu);
-
-    void process4state                   (SharedRawPdu rawpdu);
-    void process4state_open              (SharedRawPdu rawpdu);
-    void process4state_bound_tx          (SharedRawPdu rawpdu);
-    void process4state_bound_rx          (SharedRawPdu rawpdu);
-    void process4state_bound_trx         (SharedRawPdu rawpdu);
-    void process4state_unbound           (SharedRawPdu rawpdu);
-    void process4state_closed            (SharedRawPdu rawpdu);
-    void process4state_outbound          (SharedRawPdu rawpdu);
-
-    void procpdu_bind_resp               (SharedRawPdu rawpdu, State stateAferSuccess);
-    void procpdu_alert_notification      (SharedRawPdu rawpdu);
-    void procpdu_broadcast_sm_resp       (SharedRawPdu rawpdu);
-    void procpdu_cancel_broadcast_sm_resp(SharedRawPdu rawpdu);
-    void procpdu_cancel_sm_resp          (SharedRawPdu rawpdu);
-    void procpdu_data_sm                 (SharedRawPdu rawpdu);
-    void procpdu_data_sm_resp            (SharedRawPdu rawpdu);
-    void procpdu_deliver_sm              (SharedRawPdu rawpdu);
-    void procpdu_enquire_link            (SharedRawPdu rawpdu);
-    void procpdu_enquire_link_resp       (SharedRawPdu rawpdu);
-    void procpdu_generic_nack            (SharedRawPdu rawpdu);
-    void procpdu_query_broadcast_sm_resp (SharedRawPdu rawpdu);
-    void procpdu_query_sm_resp           (SharedRawPdu rawpdu);
-    void procpdu_replace_sm_resp         (SharedRawPdu rawpdu);
-    void procpdu_submit_multi_resp       (SharedRawPdu rawpdu);
-    void procpdu_submit_sm_resp          (SharedRawPdu rawpdu);
-    void procpdu_unbind                  (SharedRawPdu rawpdu);
-    void procpdu_unbind_resp             (SharedRawPdu rawpdu);
+    // [state][command slot] tables, see session_dispatch.hpp.
+    typedef SessionDispatch<SessionManager> Dispatch;
+    friend class SessionDispatch<SessionManager>;
+    static bool                          dispatchTablesBuilt;
+
+    void process4state                   (RawPdu &rawpdu);
+
+    void procpdu_unhandled               (RawPdu &rawpdu);
+    void procpdu_outbind                 (RawPdu &rawpdu);
+    void procpdu_bind_receiver_resp      (RawPdu &rawpdu);
+    void procpdu_bind_transmitter_resp   (RawPdu &rawpdu);
+    void procpdu_bind_transceiver_resp   (RawPdu &rawpdu);
+    void procpdu_bind_resp               (RawPdu &rawpdu, State stateAferSuccess);
+    void procpdu_alert_notification      (RawPdu &rawpdu);
+    void procpdu_broadcast_sm_resp       (RawPdu &rawpdu);
+    void procpdu_cancel_broadcast_sm_resp(RawPdu &rawpdu);
+    void procpdu_cancel_sm_resp          (RawPdu &rawpdu);
+    void procpdu_data_sm                 (RawPdu &rawpdu);
+    void procpdu_data_sm_resp            (RawPdu &rawpdu);
+    void procpdu_deliver_sm              (RawPdu &rawpdu);
+    void push_deliveries                 ();
+    void procpdu_enquire_link            (RawPdu &rawpdu);
+    void procpdu_enquire_link_resp       (RawPdu &rawpdu);
+    void procpdu_generic_nack            (RawPdu &rawpdu);
+    void procpdu_query_broadcast_sm_resp (RawPdu &rawpdu);
+    void procpdu_query_sm_resp           (RawPdu &rawpdu);
+    void procpdu_replace_sm_resp         (RawPdu &rawpdu);
+    void procpdu_submit_multi_resp       (RawPdu &rawpdu);
+    void procpdu_submit_sm_resp          (RawPdu &rawpdu);
+    void procpdu_unbind                  (RawPdu &rawpdu);
+    void procpdu_unbind_resp             (RawPdu &rawpdu);
 
     void reschedule_enquire_link         ();
     void do_enquire_link                 (const boost::system::error_code& e);
     void do_enquire_link_failure         (const boost::system::error_code& e);
 
-    void print_pdu                       (SharedSmppPdu                    pdu); // this method exists for debug purposes only, don't use it if you don't need to.
+    void trace_pdu                       (const char *direction, const uint8_t *data, size_t length); // hex dump, for PDU trace mode only.
 
     void w4rQ_put                        (SharedSmppPdu                    pdu);
-    void w4rQ_pop                        (SharedRawPdu                     rawpdu);
+    void w4rQ_pop                        (RawPdu                          &rawpdu);
     void w4rQ_age_cleanup                (const boost::system::error_code &e);
     void set_w4rQ_ageing_timer           ();
+    void update_in_flight                ();
 
     // vars
+    unsigned                             sessionId;
+    std::string                          statPrefix;       // "session.<id>." - prepended to the names of per session stats.
+    std::string                          inFlightStat;     // statPrefix + "window.in-flight", built once.
+    std::string                          txBatchStats[5];  // statPrefix + "tx-batch.<bucket>", built once. See batchSizeBucket().
+    OrphanedPduHandler                   orphanHandler;
+    StateChangeHandler                   stateHandler;
     boost::asio::io_service             &io_service_;
+    boost::asio::io_service::strand      strand;           // serializes every handler of this session.
     tcp::socket                          socket_;
-    tcp::resolver::iterator              endpoint_iterator;
+    std::vector<tcp::endpoint>           endpoints;        // every address the message centre host resolved to.
+    size_t                               endpointIndex;    // the address we are connected, or connecting, to.
     boost::asio::deadline_timer          enquire_link_timer;
     boost::asio::deadline_timer          enquire_link_response_timer;
     boost::asio::deadline_timer          w4rQ_ageing_timer;
-
-    std::string                          data_buffer;
-    char                                 header_buffer[16];
-    char                                *body_buffer;
-    uint32_t                             body_length;
+    boost::asio::steady_timer            throttle_timer;   // monotonic, like TokenBucket. See throttle_check().
+    boost::asio::deadline_timer          reconnect_timer;
 
     SmppSessionConfiguration             smppcfg;
+    RxBuffer                             rxBuffer;
 
-    bool                                 logPduFlag;
+    boost::atomic<bool>                  pduTrace;         // hex dump every PDU sent and recieved.
     bool                                 stopFlag;
     bool                                 reconnectFlag;
-    SharedSafeSmppPduQ                   rxQ;
+    bool                                 writeInProgress;  // an async_write is outstanding on the socket.
+    bool                                 windowStalled;    // messages are queued, but the w4rQ window is full.
+    std::vector<std::string>             writeBuffers;     // encoded writeBatch, must stay alive until handle_write.
+    std::vector<SharedSmppPdu>           writeBatch;       // PDUs being written by the outstanding async_write.
+    SharedPduBytesQueue                  rxQ;              // inbound deliver_sm, still encoded. See DeliverSmView.
+    std::vector<SharedPduBytes>          rxDelivered;      // this read's deliver_sms, for one rxQ push_batch(). See push_deliveries().
+    std::vector<SharedSmppPdu>           rxDeliveredResps; // their deliver_sm_resps, held back until they are queued.
     ScopedTransmitQ                      txQ;
-    State                                currentState;
+    boost::atomic<State>                 currentState;
     SequinceNumberGenerator              seqNumGen;
 
-    boost::posix_time::ptime             throttleNextSendTime;
-    unsigned                             timeBetweenSends; // microseconds between sends
+    TokenBucket                          txThrottle;
+    bool                                 throttleWaiting;  // throttle_timer is running, messages are held back until it expires.
+    int64_t                              throttleWaitStart; // TokenBucket::now(), when throttle_timer was set.
+    uint64_t                             throttleWaitTime; // total microseconds spent waiting on the throttle
+
+    ReconnectBackoff                     reconnectBackoff;
+    boost::posix_time::ptime             connectStartTime; // when we started trying to (re)establish the bind.
 
-    AwaitingResponseMapType              w4rQ;             // a map of sent PDUs that are (W)aiting 4 (R)esponses.
+    AwaitingResponseTable                w4rQ;             // sent PDUs that are (W)aiting 4 (R)esponses.
 
-    boost::mutex                         writeMutex;
-    boost::mutex                         w4rQMutex;
+    boost::atomic<size_t>                inFlightCount;    // w4rQ.size(), for readers outside of the strand.
+    boost::atomic<size_t>                pendingPosts;     // send_pdu() calls that have not reached the strand yet.
+
+    MpscRing<SharedSmppPdu>              fastLane;         // non-durable messages, straight from the handler threads. Never touches disk.
+    boost::atomic<bool>                  fastLanePosted;   // a drain_fast_lane() is on its way to the strand.
 
     unsigned                             readCount;        // microseconds between sends
     unsigned                             writeCount;       // microseconds between sends
     boost::posix_time::ptime             startTime;
 };
 
+typedef boost::shared_ptr<SessionManager> SharedSession;
+
 #endif
 
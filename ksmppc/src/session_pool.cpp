@@ -0,0 +1,170 @@
+// File  : session_pool.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include "session_pool.hpp"
+
+//--------------------------------------------------------------------------------
+SessionPool::SessionPool(boost::asio::io_service &io_service,
+                         SharedPduBytesQueue      recieveQueue,
+                         SharedSmppPduQueue       fallbackQueue) :
+  fallbackQ(fallbackQueue),
+  stopping (false)
+{
+  kisscpp::LogStream log(__PRETTY_FUNCTION__);
+  unsigned           bindCount = CFG->get<unsigned int>("smpp-session.bind-count", 1);
+
+  if(bindCount < 1) {
+    bindCount = 1;
+  }
+
+  log << "Starting " << bindCount << " session(s)." << kisscpp::manip::flush;
+
+  for(unsigned i = 0; i < bindCount; ++i) {
+    SharedSession session;
+    session.reset(new SessionManager(io_service,
+                                     recieveQueue,
+                                     i,
+                                     boost::bind(&SessionPool::redispatch, this, i, _1),
+                                     boost::bind(&SessionPool::stateChange, this)));
+    sessions.push_back(session);
+  }
+}
+
+//--------------------------------------------------------------------------------
+bool SessionPool::send_pdu(const SharedSmppPdu pdu)
+{
+  SharedSession session = leastLoaded(sessions.size());
+
+  return (session && session->send_pdu(pdu));
+}
+
+//--------------------------------------------------------------------------------
+bool SessionPool::send_fast(const SharedSmppPdu pdu)
+{
+  SharedSession session = leastLoaded(sessions.size());
+
+  return (session && session->send_fast(pdu));
+}
+
+//--------------------------------------------------------------------------------
+bool SessionPool::send_group(const std::vector<SharedSmppPdu> &pdus)
+{
+  SharedSession session = leastLoaded(sessions.size());
+
+  return (session && session->send_group(pdus));
+}
+
+//--------------------------------------------------------------------------------
+bool SessionPool::available()
+{
+  for(std::vector<SharedSession>::iterator i = sessions.begin(); i != sessions.end(); ++i) {
+    if((*i)->isBound()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------------------
+bool SessionPool::wait_available(unsigned timeoutMs)
+{
+  boost::system_time        deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMs);
+  boost::mutex::scoped_lock lock(stateMutex);
+
+  while(!stopping && !available()) {
+    if(!stateChanged.timed_wait(lock, deadline)) {
+      break;
+    }
+  }
+
+  return available();
+}
+
+//--------------------------------------------------------------------------------
+void SessionPool::stateChange()
+{
+  boost::mutex::scoped_lock lock(stateMutex);
+  stateChanged.notify_all();
+}
+
+//--------------------------------------------------------------------------------
+void SessionPool::stop()
+{
+  {
+    boost::mutex::scoped_lock lock(stateMutex);
+    stopping = true;
+    stateChanged.notify_all();
+  }
+
+  for(std::vector<SharedSession>::iterator i = sessions.begin(); i != sessions.end(); ++i) {
+    (*i)->stop();
+  }
+}
+
+//--------------------------------------------------------------------------------
+bool SessionPool::setPduTrace(bool on, int sessionId /* = -1 */)
+{
+  bool found = false;
+
+  for(std::vector<SharedSession>::iterator i = sessions.begin(); i != sessions.end(); ++i) {
+    if(sessionId < 0 || (unsigned)sessionId == (*i)->getSessionId()) {
+      (*i)->setPduTrace(on);
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+//--------------------------------------------------------------------------------
+SharedSession SessionPool::leastLoaded(unsigned excludedSession)
+{
+  SharedSession retval;
+  size_t        retvalLoad = 0;
+
+  for(std::vector<SharedSession>::iterator i = sessions.begin(); i != sessions.end(); ++i) {
+    if((*i)->getSessionId() != excludedSession && (*i)->isBound()) {
+      size_t l = (*i)->load();
+      if(!retval || l < retvalLoad) {
+        retval     = *i;
+        retvalLoad = l;
+      }
+    }
+  }
+
+  return retval;
+}
+
+//--------------------------------------------------------------------------------
+void SessionPool::redispatch(unsigned fromSession, const std::vector<SharedSmppPdu> &pdus)
+{
+  // Called by a session that dropped, with every message it could not deliver. They all go to one
+  // session, or to the fallback queue in one push_batch(): one sync on a durable queue, not one per message.
+  SharedSession session = leastLoaded(fromSession);
+
+  for(std::vector<SharedSmppPdu>::const_iterator i = pdus.begin(); i != pdus.end(); ++i) {
+    (*i)->sequence_number = 0; // sequence numbers belong to the session that allocated them.
+  }
+
+  if(!session || !session->send_group(pdus)) {
+    fallbackQ->push_batch(pdus);
+  }
+}
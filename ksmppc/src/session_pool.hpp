@@ -0,0 +1,71 @@
+// File  : session_pool.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _SESSION_POOL_HPP_
+#define _SESSION_POOL_HPP_
+
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <kisscpp/logstream.hpp>
+
+#include "cfg.hpp"
+#include "sharedsmpppdu.hpp"
+#include "pdu_queue.hpp"
+#include "session_manager.hpp"
+
+//--------------------------------------------------------------------------------
+// Owns every bind to the message centre. The number of binds comes from
+// smpp-session.bind-count. Messages go to the least loaded bound session.
+class SessionPool
+{
+  public:
+    SessionPool(boost::asio::io_service &io_service,
+                SharedPduBytesQueue      recieveQueue,
+                SharedSmppPduQueue       fallbackQueue);
+    ~SessionPool() {};
+
+    bool send_pdu      (const SharedSmppPdu pdu);     // false if there is no bound session to take the PDU.
+    bool send_fast     (const SharedSmppPdu pdu);     // non-durable. false if the least loaded session's fast lane is full, or nobody is bound.
+    bool send_group    (const std::vector<SharedSmppPdu> &pdus); // all on one session, back to back. false if nobody is bound.
+    bool available     ();                            // true if at least one session is bound.
+    bool wait_available(unsigned timeoutMs);          // blocks until available(), or timeoutMs passed, or stop() was called.
+    void stop          ();
+    bool setPduTrace   (bool on, int sessionId = -1); // -1: every session. false if there is no such session.
+
+  private:
+    SharedSession leastLoaded(unsigned excludedSession);
+    void          redispatch (unsigned fromSession, const std::vector<SharedSmppPdu> &pdus);
+    void          stateChange();
+
+    std::vector<SharedSession> sessions;
+    SharedSmppPduQueue         fallbackQ; // where messages go if no session can take them.
+    boost::mutex               stateMutex;
+    boost::condition_variable  stateChanged;
+    bool                       stopping;
+};
+
+typedef boost::shared_ptr<SessionPool> SharedSessionPool;
+
+#endif // _SESSION_POOL_HPP_
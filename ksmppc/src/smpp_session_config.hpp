@@ -44,7 +44,34 @@ class SmppSessionConfiguration
       addrNpi                   =  CFG->get<uint8_t>     ("smpp-session.default-number-plan-indicator");
       addressRange              = (CFG->get<std::string> ("smpp-session.address-range")).c_str();
       tx_throttle_limit         =  CFG->get<unsigned int>("smpp-session.tx-throttle-limit");
+      tx_throttle_burst         =  CFG->get<unsigned int>("smpp-session.tx-throttle-burst", 1);
       typeOfBind                = makeBindType(CFG->get<std::string>("smpp-session.bind-type"));
+      window_size               =  CFG->get<unsigned int>("smpp-session.window-size", 10);
+      response_timeout          =  CFG->get<unsigned int>("smpp-session.response-timeout", 30);
+      fast_lane_size            =  CFG->get<unsigned int>("smpp-session.fast-lane-size"  , 1024);
+      tx_batch_max_pdus         =  CFG->get<unsigned int>("smpp-session.tx-batch-max-pdus" , 32);
+      tx_batch_max_bytes        =  CFG->get<unsigned int>("smpp-session.tx-batch-max-bytes", 65536);
+      rx_buffer_size            =  CFG->get<unsigned int>("smpp-session.rx-buffer-size", 65536);
+      max_pdu_size              =  CFG->get<unsigned int>("smpp-session.max-pdu-size"  , 65536);
+      sequence_number_file      =  CFG->get<std::string> ("smpp-session.sequence-number-file"   , "");
+      sequence_number_reserve   =  CFG->get<unsigned int>("smpp-session.sequence-number-reserve", 10000);
+      pdu_trace                 =  CFG->get<bool>        ("smpp-session.pdu-trace", false);
+      reconnect_initial_delay   =  CFG->get<unsigned int>("smpp-session.reconnect-initial-delay", 1000);
+      reconnect_max_delay       =  CFG->get<unsigned int>("smpp-session.reconnect-max-delay"    , 60000);
+      reconnect_multiplier      =  CFG->get<double>      ("smpp-session.reconnect-multiplier"   , 2.0);
+      reconnect_jitter          =  CFG->get<double>      ("smpp-session.reconnect-jitter"       , 0.2);
+
+      if(window_size < 1) {      // a window of 0 would never allow a single message out.
+        window_size = 1;
+      }
+
+      if(tx_batch_max_pdus < 1) {  // an empty batch would never write anything, not even a bind or an enquire_link.
+        tx_batch_max_pdus = 1;
+      }
+
+      if(tx_batch_max_bytes < 1) {
+        tx_batch_max_bytes = 1;
+      }
     }
 
     ~SmppSessionConfiguration() {}
@@ -59,7 +86,22 @@ class SmppSessionConfiguration
     boost::posix_time::seconds &getEnquireLinkTimeout    () {return enquire_link_timeout;     }
     boost::posix_time::seconds &getEnquireLinkRespTimeout() {return enquire_link_resp_timeout;}
     unsigned                   &getTxThrottleLimit       () {return tx_throttle_limit;        }
+    unsigned                   &getTxThrottleBurst       () {return tx_throttle_burst;        }
     BindType                   &getTypeOfBind            () {return typeOfBind;               }
+    unsigned                   &getWindowSize            () {return window_size;              }
+    unsigned                   &getResponseTimeout       () {return response_timeout;         }
+    unsigned                   &getFastLaneSize          () {return fast_lane_size;           }
+    unsigned                   &getTxBatchMaxPdus        () {return tx_batch_max_pdus;        }
+    unsigned                   &getTxBatchMaxBytes       () {return tx_batch_max_bytes;       }
+    unsigned                   &getRxBufferSize          () {return rx_buffer_size;           }
+    unsigned                   &getMaxPduSize            () {return max_pdu_size;             }
+    std::string                &getSequenceNumberFile    () {return sequence_number_file;     }
+    unsigned                   &getSequenceNumberReserve () {return sequence_number_reserve;  }
+    bool                       &getPduTrace              () {return pdu_trace;                }
+    unsigned                   &getReconnectInitialDelay () {return reconnect_initial_delay;  }
+    unsigned                   &getReconnectMaxDelay     () {return reconnect_max_delay;      }
+    double                     &getReconnectMultiplier   () {return reconnect_multiplier;     }
+    double                     &getReconnectJitter       () {return reconnect_jitter;         }
 
   protected:
   private:
@@ -73,7 +115,22 @@ class SmppSessionConfiguration
     boost::posix_time::seconds  enquire_link_timeout;
     boost::posix_time::seconds  enquire_link_resp_timeout;
     unsigned                    tx_throttle_limit;
+    unsigned                    tx_throttle_burst; // number of messages that may go out back to back, before tx_throttle_limit kicks in.
     BindType                    typeOfBind;
+    unsigned                    window_size;      // max number of PDUs that may be awaiting a response at any one time.
+    unsigned                    response_timeout;        // seconds, a sent PDU that is not responded to by then, is sent again.
+    unsigned                    fast_lane_size;          // non-durable messages a session holds in memory, before senders fall back to the persisted path.
+    unsigned                    tx_batch_max_pdus;       // max PDUs gathered into a single socket write.
+    unsigned                    tx_batch_max_bytes;      // a batch is closed once it reaches this many bytes.
+    unsigned                    rx_buffer_size;          // bytes, a single read can frame up to this many bytes worth of PDUs.
+    unsigned                    max_pdu_size;            // bytes, a larger command_length is treated as a protocol error.
+    std::string                 sequence_number_file;    // if set, "<file>.<session id>" holds each session's sequence number high-water mark.
+    unsigned                    sequence_number_reserve; // sequence numbers reserved per write of the high-water mark.
+    bool                        pdu_trace;               // start sessions with PDU trace mode on. See TraceHandler.
+    unsigned                    reconnect_initial_delay; // milliseconds
+    unsigned                    reconnect_max_delay;     // milliseconds
+    double                      reconnect_multiplier;
+    double                      reconnect_jitter;        // fraction of the delay, e.g. 0.2 == +/- 20%
 };
 
 #endif // _SMPP_SESSION_CONFIG_HPP_
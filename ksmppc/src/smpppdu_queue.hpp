@@ -31,6 +31,60 @@
 #include <kisscpp/threadsafe_persisted_priority_queue.hpp>
 #include <kisscpp/logstream.hpp>
 
+#include "log.hpp"
+
+//--------------------------------------------------------------------------------
+// Decodes one wire format PDU, into the PDU class its command_id calls for.
+inline boost::shared_ptr<smpp_pdu::SMPP_PDU> smppPduFromWire(const char *wire)
+{
+  boost::shared_ptr<smpp_pdu::SMPP_PDU> tSmppPduPtr;
+  const smpp_pdu::CommandId             cmdId(smpp_pdu::get_command_id(reinterpret_cast<const uint8_t*>(wire)));
+
+  try {
+    switch(cmdId) {
+      case smpp_pdu::CommandId::AlertNotification    : tSmppPduPtr.reset(new smpp_pdu::PDU_alert_notification      (wire)); break;
+      case smpp_pdu::CommandId::BindReceiver         : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_reciever           (wire)); break;
+      case smpp_pdu::CommandId::BindReceiverResp     : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_reciever_resp      (wire)); break;
+      case smpp_pdu::CommandId::BindTransceiver      : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transceiver        (wire)); break;
+      case smpp_pdu::CommandId::BindTransceiverResp  : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transceiver_resp   (wire)); break;
+      case smpp_pdu::CommandId::BindTransmitter      : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transmitter        (wire)); break;
+      case smpp_pdu::CommandId::BindTransmitterResp  : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transmitter_resp   (wire)); break;
+      case smpp_pdu::CommandId::BroadcastSm          : tSmppPduPtr.reset(new smpp_pdu::PDU_broadcast_sm            (wire)); break;
+      case smpp_pdu::CommandId::BroadcastSmResp      : tSmppPduPtr.reset(new smpp_pdu::PDU_broadcast_sm_resp       (wire)); break;
+      case smpp_pdu::CommandId::CancelBroadcastSm    : tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_broadcast_sm     (wire)); break;
+      case smpp_pdu::CommandId::CancelBroadcastSmResp: tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_broadcast_sm_resp(wire)); break;
+      case smpp_pdu::CommandId::CancelSm             : tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_sm               (wire)); break;
+      case smpp_pdu::CommandId::CancelSmResp         : tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_sm_resp          (wire)); break;
+      case smpp_pdu::CommandId::DataSm               : tSmppPduPtr.reset(new smpp_pdu::PDU_data_sm                 (wire)); break;
+      case smpp_pdu::CommandId::DataSmResp           : tSmppPduPtr.reset(new smpp_pdu::PDU_data_sm_resp            (wire)); break;
+      case smpp_pdu::CommandId::DeliverSm            : tSmppPduPtr.reset(new smpp_pdu::PDU_deliver_sm              (wire)); break;
+      case smpp_pdu::CommandId::DeliverSmResp        : tSmppPduPtr.reset(new smpp_pdu::PDU_deliver_sm_resp         (wire)); break;
+      case smpp_pdu::CommandId::EnquireLink          : tSmppPduPtr.reset(new smpp_pdu::PDU_enquire_link            (wire)); break;
+      case smpp_pdu::CommandId::EnquireLinkResp      : tSmppPduPtr.reset(new smpp_pdu::PDU_enquire_link_resp       (wire)); break;
+      case smpp_pdu::CommandId::GenericNack          : tSmppPduPtr.reset(new smpp_pdu::PDU_generic_nack            (wire)); break;
+      case smpp_pdu::CommandId::Outbind              : tSmppPduPtr.reset(new smpp_pdu::PDU_outbind                 (wire)); break;
+      case smpp_pdu::CommandId::QueryBroadcastSm     : tSmppPduPtr.reset(new smpp_pdu::PDU_query_broadcast_sm      (wire)); break;
+      case smpp_pdu::CommandId::QueryBroadcastSmResp : tSmppPduPtr.reset(new smpp_pdu::PDU_querybroadcast_sm_resp  (wire)); break;
+      case smpp_pdu::CommandId::QuerySm              : tSmppPduPtr.reset(new smpp_pdu::PDU_query_sm                (wire)); break;
+      case smpp_pdu::CommandId::QuerySmResp          : tSmppPduPtr.reset(new smpp_pdu::PDU_query_sm_resp           (wire)); break;
+      case smpp_pdu::CommandId::ReplaceSm            : tSmppPduPtr.reset(new smpp_pdu::PDU_replace_sm              (wire)); break;
+      case smpp_pdu::CommandId::ReplaceSmResp        : tSmppPduPtr.reset(new smpp_pdu::PDU_replace_sm_resp         (wire)); break;
+      case smpp_pdu::CommandId::SubmitMulti          : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_multi            (wire)); break;
+      case smpp_pdu::CommandId::SubmitMultiResp      : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_multi_resp       (wire)); break;
+      case smpp_pdu::CommandId::SubmitSm             : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_sm               (wire)); break;
+      case smpp_pdu::CommandId::SubmitSmResp         : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_sm_resp          (wire)); break;
+      case smpp_pdu::CommandId::Unbind               : tSmppPduPtr.reset(new smpp_pdu::PDU_unbind                  (wire)); break;
+      case smpp_pdu::CommandId::UnbindResp           : tSmppPduPtr.reset(new smpp_pdu::PDU_unbind_resp             (wire)); break;
+      default: /*TODO: Scream Loudly!!!! This should never happen!!!*/ break;
+    }
+  } catch (smpp_pdu::Error &e) {
+    KLOG(ERROR) << "Error while decoding PDU :" << e.what() << kisscpp::manip::endl;
+    throw e;
+  }
+
+  return tSmppPduPtr;
+}
+
 //--------------------------------------------------------------------------------
 class SmppPduBase64Bicoder : public kisscpp::Base64BiCoder<smpp_pdu::SMPP_PDU>
 {
@@ -41,12 +95,13 @@ class SmppPduBase64Bicoder : public kisscpp::Base64BiCoder<smpp_pdu::SMPP_PDU>
     //--------------------------------------------------------------------------------
     virtual boost::shared_ptr<std::string> encode(const boost::shared_ptr<smpp_pdu::SMPP_PDU> obj2encode)
     {
-      kisscpp::LogStream log(__PRETTY_FUNCTION__);
-      std::string        tstr = obj2encode->encode();
-      std::stringstream  ss;
+      std::string tstr = obj2encode->encode();
 
-      smpp_pdu::hex_dump(reinterpret_cast<const uint8_t*>(tstr.c_str()), tstr.size(), ss);
-      log << "Encoding:\n" << ss.str() << kisscpp::manip::endl;
+      if(KLOG_ENABLED(TRACE)) {
+        std::stringstream ss;
+        smpp_pdu::hex_dump(reinterpret_cast<const uint8_t*>(tstr.c_str()), tstr.size(), ss);
+        KLOG(TRACE) << "Encoding:\n" << ss.str() << kisscpp::manip::endl;
+      }
 
       return encodeToBase64String(tstr);
     }
@@ -54,63 +109,18 @@ class SmppPduBase64Bicoder : public kisscpp::Base64BiCoder<smpp_pdu::SMPP_PDU>
     //--------------------------------------------------------------------------------
     virtual boost::shared_ptr<smpp_pdu::SMPP_PDU> decode(const std::string& str2decode)
     {
-      kisscpp::LogStream log(__PRETTY_FUNCTION__);
-
-      log << "String 2 decode: " << str2decode << kisscpp::manip::endl;
-
-      boost::shared_ptr<smpp_pdu::SMPP_PDU> tSmppPduPtr;
-      boost::shared_ptr<std::string>        pduString = decodeFromBase64(str2decode);
-
-      const smpp_pdu::CommandId cmdId(smpp_pdu::get_command_id(reinterpret_cast<const uint8_t*>(pduString->c_str())));
-      uint32_t                  cmdlen = smpp_pdu::get_command_length(reinterpret_cast<const uint8_t*>(pduString->c_str()));
-
-      std::stringstream ss;
-      smpp_pdu::hex_dump(reinterpret_cast<const uint8_t*>(pduString->c_str()), cmdlen, ss);
-      log << "Decoding:\n" << ss.str() << kisscpp::manip::endl;
-
-      try {
-        switch(cmdId) {
-          case smpp_pdu::CommandId::AlertNotification    : tSmppPduPtr.reset(new smpp_pdu::PDU_alert_notification      (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BindReceiver         : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_reciever           (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BindReceiverResp     : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_reciever_resp      (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BindTransceiver      : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transceiver        (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BindTransceiverResp  : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transceiver_resp   (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BindTransmitter      : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transmitter        (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BindTransmitterResp  : tSmppPduPtr.reset(new smpp_pdu::PDU_bind_transmitter_resp   (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BroadcastSm          : tSmppPduPtr.reset(new smpp_pdu::PDU_broadcast_sm            (pduString->c_str())); break;
-          case smpp_pdu::CommandId::BroadcastSmResp      : tSmppPduPtr.reset(new smpp_pdu::PDU_broadcast_sm_resp       (pduString->c_str())); break;
-          case smpp_pdu::CommandId::CancelBroadcastSm    : tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_broadcast_sm     (pduString->c_str())); break;
-          case smpp_pdu::CommandId::CancelBroadcastSmResp: tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_broadcast_sm_resp(pduString->c_str())); break;
-          case smpp_pdu::CommandId::CancelSm             : tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_sm               (pduString->c_str())); break;
-          case smpp_pdu::CommandId::CancelSmResp         : tSmppPduPtr.reset(new smpp_pdu::PDU_cancel_sm_resp          (pduString->c_str())); break;
-          case smpp_pdu::CommandId::DataSm               : tSmppPduPtr.reset(new smpp_pdu::PDU_data_sm                 (pduString->c_str())); break;
-          case smpp_pdu::CommandId::DataSmResp           : tSmppPduPtr.reset(new smpp_pdu::PDU_data_sm_resp            (pduString->c_str())); break;
-          case smpp_pdu::CommandId::DeliverSm            : tSmppPduPtr.reset(new smpp_pdu::PDU_deliver_sm              (pduString->c_str())); break;
-          case smpp_pdu::CommandId::DeliverSmResp        : tSmppPduPtr.reset(new smpp_pdu::PDU_deliver_sm_resp         (pduString->c_str())); break;
-          case smpp_pdu::CommandId::EnquireLink          : tSmppPduPtr.reset(new smpp_pdu::PDU_enquire_link            (pduString->c_str())); break;
-          case smpp_pdu::CommandId::EnquireLinkResp      : tSmppPduPtr.reset(new smpp_pdu::PDU_enquire_link_resp       (pduString->c_str())); break;
-          case smpp_pdu::CommandId::GenericNack          : tSmppPduPtr.reset(new smpp_pdu::PDU_generic_nack            (pduString->c_str())); break;
-          case smpp_pdu::CommandId::Outbind              : tSmppPduPtr.reset(new smpp_pdu::PDU_outbind                 (pduString->c_str())); break;
-          case smpp_pdu::CommandId::QueryBroadcastSm     : tSmppPduPtr.reset(new smpp_pdu::PDU_query_broadcast_sm      (pduString->c_str())); break;
-          case smpp_pdu::CommandId::QueryBroadcastSmResp : tSmppPduPtr.reset(new smpp_pdu::PDU_querybroadcast_sm_resp  (pduString->c_str())); break;
-          case smpp_pdu::CommandId::QuerySm              : tSmppPduPtr.reset(new smpp_pdu::PDU_query_sm                (pduString->c_str())); break;
-          case smpp_pdu::CommandId::QuerySmResp          : tSmppPduPtr.reset(new smpp_pdu::PDU_query_sm_resp           (pduString->c_str())); break;
-          case smpp_pdu::CommandId::ReplaceSm            : tSmppPduPtr.reset(new smpp_pdu::PDU_replace_sm              (pduString->c_str())); break;
-          case smpp_pdu::CommandId::ReplaceSmResp        : tSmppPduPtr.reset(new smpp_pdu::PDU_replace_sm_resp         (pduString->c_str())); break;
-          case smpp_pdu::CommandId::SubmitMulti          : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_multi            (pduString->c_str())); break;
-          case smpp_pdu::CommandId::SubmitMultiResp      : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_multi_resp       (pduString->c_str())); break;
-          case smpp_pdu::CommandId::SubmitSm             : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_sm               (pduString->c_str())); break;
-          case smpp_pdu::CommandId::SubmitSmResp         : tSmppPduPtr.reset(new smpp_pdu::PDU_submit_sm_resp          (pduString->c_str())); break;
-          case smpp_pdu::CommandId::Unbind               : tSmppPduPtr.reset(new smpp_pdu::PDU_unbind                  (pduString->c_str())); break;
-          case smpp_pdu::CommandId::UnbindResp           : tSmppPduPtr.reset(new smpp_pdu::PDU_unbind_resp             (pduString->c_str())); break;
-          default: /*TODO: Scream Loudly!!!! This should never happen!!!*/ break;
-        }
-      } catch (smpp_pdu::Error &e) {
-        log << "Error while decoding PDU :" << e.what() << kisscpp::manip::endl;
-        throw e;
+      KLOG(TRACE) << "String 2 decode: " << str2decode << kisscpp::manip::endl;
+
+      boost::shared_ptr<std::string> pduString = decodeFromBase64(str2decode);
+
+      if(KLOG_ENABLED(TRACE)) {
+        uint32_t          cmdlen = smpp_pdu::get_command_length(reinterpret_cast<const uint8_t*>(pduString->c_str()));
+        std::stringstream ss;
+        smpp_pdu::hex_dump(reinterpret_cast<const uint8_t*>(pduString->c_str()), cmdlen, ss);
+        KLOG(TRACE) << "Decoding:\n" << ss.str() << kisscpp::manip::endl;
       }
 
-      return tSmppPduPtr;
+      return smppPduFromWire(pduString->c_str());
     }
 
   protected:
@@ -146,6 +156,28 @@ class SmppPduBase64Bicoder : public kisscpp::Base64BiCoder<smpp_pdu::SMPP_PDU>
     }
 };
 
+//--------------------------------------------------------------------------------
+// For queues of encoded PDUs, that are only decoded by whoever pops them. The
+// persisted form is the same base64 string SmppPduBase64Bicoder writes.
+class PduBytesBase64Bicoder : public kisscpp::Base64BiCoder<std::string>
+{
+  public:
+    PduBytesBase64Bicoder() {};
+    ~PduBytesBase64Bicoder() {};
+
+    //--------------------------------------------------------------------------------
+    virtual boost::shared_ptr<std::string> encode(const boost::shared_ptr<std::string> obj2encode)
+    {
+      return encodeToBase64String(*obj2encode);
+    }
+
+    //--------------------------------------------------------------------------------
+    virtual boost::shared_ptr<std::string> decode(const std::string& str2decode)
+    {
+      return decodeFromBase64(str2decode);
+    }
+};
+
 typedef kisscpp::PersistedQueue<smpp_pdu::SMPP_PDU, SmppPduBase64Bicoder> SmppPduQ;
 typedef boost::shared_ptr<SmppPduQ>                                       SharedSmppPduQ;
 typedef boost::scoped_ptr<SmppPduQ>                                       ScopedSmppPduQ;
@@ -158,6 +190,8 @@ typedef kisscpp::ThreadsafePersistedPriorityQueue<smpp_pdu::SMPP_PDU, SmppPduBas
 typedef boost::shared_ptr<PrioritisedSmppPduQ>                                              SharedPrioritisedSmppPduQ;
 typedef boost::scoped_ptr<PrioritisedSmppPduQ>                                              ScopedPrioritisedSmppPduQ;
 
+typedef boost::shared_ptr<std::string>                                          SharedPduBytes;
+
 typedef boost::shared_ptr<smpp_pdu::PDU_alert_notification>       SharedPduAlertNotification;
 typedef boost::shared_ptr<smpp_pdu::PDU_bind_type>                SharedPduBindType;
 typedef boost::shared_ptr<smpp_pdu::PDU_bind_type_resp>           SharedPduBindTypeResp;
@@ -0,0 +1,286 @@
+// File  : submit_sm_builder.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include "json_cursor.hpp"
+#include "submit_sm_builder.hpp"
+
+namespace {
+  //--------------------------------------------------------------------------------
+  uint8_t toOctet(const std::string &value, const char *name)
+  {
+    unsigned result = 0;
+
+    if(value.empty() || value.size() > 3) {
+      throw std::invalid_argument(std::string("Invalid value for parameter: ") + name);
+    }
+
+    for(std::string::const_iterator i = value.begin(); i != value.end(); ++i) {
+      if(*i < '0' || *i > '9') {
+        throw std::invalid_argument(std::string("Invalid value for parameter: ") + name);
+      }
+      result = result * 10 + (*i - '0');
+    }
+
+    if(result > 255) {
+      throw std::invalid_argument(std::string("Invalid value for parameter: ") + name);
+    }
+
+    return (uint8_t)result;
+  }
+
+  //--------------------------------------------------------------------------------
+  bool toBool(const std::string &value, const char *name)
+  {
+    if(value == "true"  || value == "1") { return true;  }
+    if(value == "false" || value == "0") { return false; }
+
+    throw std::invalid_argument(std::string("Invalid value for parameter: ") + name);
+  }
+
+  //--------------------------------------------------------------------------------
+  struct FieldName
+  {
+    const char *name;
+    size_t      length;
+  };
+
+  // In the order of SubmitSmBuilder::Field, from ID on.
+  #define FIELD_NAME(X) { X, sizeof(X) - 1 }
+  const FieldName fieldNames[] = {
+    FIELD_NAME("id"),
+    FIELD_NAME("durable"),
+    FIELD_NAME("service-type"),
+    FIELD_NAME("source-addr-ton"),
+    FIELD_NAME("source-addr-npi"),
+    FIELD_NAME("source-addr"),
+    FIELD_NAME("destination-addr-ton"),
+    FIELD_NAME("destination-addr-npi"),
+    FIELD_NAME("destination-addr"),
+    FIELD_NAME("esm-class"),
+    FIELD_NAME("protocol-id"),
+    FIELD_NAME("priority-flag"),
+    FIELD_NAME("schedule-delivery-time"),
+    FIELD_NAME("validity-period"),
+    FIELD_NAME("registered-delivery"),
+    FIELD_NAME("replace-if-presentFlag"),
+    FIELD_NAME("data-coding"),
+    FIELD_NAME("sm-default-msg-id"),
+    FIELD_NAME("short-message")
+  };
+  #undef FIELD_NAME
+
+  const unsigned SEEN_SOURCE_ADDR      = 1;
+  const unsigned SEEN_DESTINATION_ADDR = 2;
+  const unsigned SEEN_SHORT_MESSAGE    = 4;
+}
+
+//--------------------------------------------------------------------------------
+SubmitSmDefaults::SubmitSmDefaults()
+{
+  configure(CFG->get<uint8_t>("smpp-session.default-type-of-number"),
+            CFG->get<uint8_t>("smpp-session.default-number-plan-indicator"));
+}
+
+//--------------------------------------------------------------------------------
+SubmitSmDefaults::SubmitSmDefaults(uint8_t ton, uint8_t npi)
+{
+  configure(ton, npi);
+}
+
+//--------------------------------------------------------------------------------
+void SubmitSmDefaults::configure(uint8_t ton, uint8_t npi)
+{
+  addrTon              = ton;
+  addrNpi              = npi;
+  esmClass             = 0;
+  protocolId           = 0;
+  priorityFlag         = 0;
+  registeredDelivery   = 3;
+  replaceIfPresentFlag = 0;
+  dataCoding           = 3;
+  smDefaultMsgId       = 0;
+  durable              = true;
+}
+
+//--------------------------------------------------------------------------------
+SubmitSmBuilder::Field SubmitSmBuilder::lookup(const char *name, size_t length)
+{
+  for(size_t i = 0; i < sizeof(fieldNames) / sizeof(fieldNames[0]); ++i) {
+    if(fieldNames[i].length == length && std::memcmp(fieldNames[i].name, name, length) == 0) {
+      return (Field)(ID + i);
+    }
+  }
+
+  return NONE; // kcm-cmd and friends, or something we don't know.
+}
+
+//--------------------------------------------------------------------------------
+void SubmitSmBuilder::start(smpp_pdu::PDU_submit_sm &pdu, Values &values) const
+{
+  pdu.source_addr     .ton     = defaults.addrTon;
+  pdu.source_addr     .npi     = defaults.addrNpi;
+  pdu.destination_addr.ton     = defaults.addrTon;
+  pdu.destination_addr.npi     = defaults.addrNpi;
+  pdu.esm_class                = defaults.esmClass;
+  pdu.protocol_id              = defaults.protocolId;
+  pdu.priority_flag            = defaults.priorityFlag;
+  pdu.registered_delivery      = defaults.registeredDelivery;
+  pdu.replace_if_present_flag  = defaults.replaceIfPresentFlag;
+  pdu.data_coding              = defaults.dataCoding;
+  pdu.sm_default_msg_id        = defaults.smDefaultMsgId;
+
+  values.durable    = defaults.durable;
+  values.seen       = 0;
+  values.esmClass   = defaults.esmClass;
+  values.dataCoding = defaults.dataCoding;
+  values.destination .clear();
+  values.shortMessage.clear();
+}
+
+//--------------------------------------------------------------------------------
+void SubmitSmBuilder::set(smpp_pdu::PDU_submit_sm &pdu, Field field, const std::string &value, Values &values) const
+{
+  const char *name = fieldNames[field - ID].name;
+
+  switch(field) {
+    case DURABLE                : values.durable               = toBool (value, name); break;
+    case SERVICE_TYPE           : pdu.service_type             = value;                break;
+    case SOURCE_ADDR_TON        : pdu.source_addr     .ton     = toOctet(value, name); break;
+    case SOURCE_ADDR_NPI        : pdu.source_addr     .npi     = toOctet(value, name); break;
+    case SOURCE_ADDR            : pdu.source_addr     .address = value;                break;
+    case DESTINATION_ADDR_TON   : pdu.destination_addr.ton     = toOctet(value, name); break;
+    case DESTINATION_ADDR_NPI   : pdu.destination_addr.npi     = toOctet(value, name); break;
+    case DESTINATION_ADDR       : pdu.destination_addr.address = value;
+                                  values.destination           = value;                break;
+    case ESM_CLASS              : values.esmClass              = toOctet(value, name);
+                                  pdu.esm_class                = values.esmClass;      break;
+    case PROTOCOL_ID            : pdu.protocol_id              = toOctet(value, name); break;
+    case PRIORITY_FLAG          : pdu.priority_flag            = toOctet(value, name); break;
+    case SCHEDULE_DELIVERY_TIME : pdu.schedule_delivery_time   = value;                break; // TODO: Deal with propper encoding of time here.
+    case VALIDITY_PERIOD        : pdu.validity_period          = value;                break;
+    case REGISTERED_DELIVERY    : pdu.registered_delivery      = toOctet(value, name); break;
+    case REPLACE_IF_PRESENT_FLAG: pdu.replace_if_present_flag  = toOctet(value, name); break;
+    case DATA_CODING            : values.dataCoding            = toOctet(value, name);
+                                  pdu.data_coding              = values.dataCoding;    break;
+    case SM_DEFAULT_MSG_ID      : pdu.sm_default_msg_id        = toOctet(value, name); break;
+    case SHORT_MESSAGE          : values.shortMessage          = value;                break; // set on the parts, by finish().
+    default                     : break;
+  }
+
+  if(!value.empty()) {
+    switch(field) {
+      case SOURCE_ADDR     : values.seen |= SEEN_SOURCE_ADDR;      break;
+      case DESTINATION_ADDR: values.seen |= SEEN_DESTINATION_ADDR; break;
+      case SHORT_MESSAGE   : values.seen |= SEEN_SHORT_MESSAGE;    break;
+      default              : break;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SubmitSmBuilder::finish(const smpp_pdu::PDU_submit_sm &pdu, const Values &values, SubmitSmParts &parts) const
+{
+  if(!(values.seen & SEEN_SHORT_MESSAGE   )) { throw std::invalid_argument("Missing parameter: short-message");    }
+  if(!(values.seen & SEEN_SOURCE_ADDR     )) { throw std::invalid_argument("Missing parameter: source-addr");      }
+  if(!(values.seen & SEEN_DESTINATION_ADDR)) { throw std::invalid_argument("Missing parameter: destination-addr"); }
+
+  // TODO: deal with support for TLV that overrides short-message parameter:
+  // message-payload TLV. in spec: 4.8.4.36
+
+  try {
+    segmenter.segment(pdu, values.esmClass, values.dataCoding, values.destination, values.shortMessage, parts);
+  } catch(smpp_pdu::Error &e) {
+    throw std::invalid_argument(e.what());
+  }
+}
+
+//--------------------------------------------------------------------------------
+void SubmitSmBuilder::build(const BoostPtree &message, SubmitSmParts &parts, bool &durable) const
+{
+  smpp_pdu::PDU_submit_sm pdu;
+  Values                  values;
+
+  start(pdu, values);
+  parts.clear();
+
+  try {
+    for(BoostPtree::const_iterator i = message.begin(); i != message.end(); ++i) {
+      Field field = lookup(i->first.data(), i->first.size());
+
+      if(field > ID) {
+        set(pdu, field, i->second.data(), values);
+      }
+    }
+  } catch(smpp_pdu::Error &e) { // a value the field can not hold.
+    throw std::invalid_argument(e.what());
+  }
+
+  durable = values.durable;
+
+  finish(pdu, values, parts);
+}
+
+//--------------------------------------------------------------------------------
+void SubmitSmBuilder::build(const char *json, size_t length, SubmitSmParts &parts, bool &durable, std::string &id) const
+{
+  smpp_pdu::PDU_submit_sm pdu;
+  Values                  values;
+  JsonCursor              cursor(json, length);
+  std::string             key;
+  std::string             value;
+
+  start(pdu, values);
+  parts.clear();
+  id.clear();
+
+  try {
+    cursor.expect('{');
+
+    if(!cursor.next('}')) {
+      do {
+        cursor.string(key);
+        cursor.expect(':');
+        cursor.value (value);
+
+        Field field = lookup(key.data(), key.size());
+
+        if(field == ID) {
+          id = value;
+        } else if(field != NONE) {
+          set(pdu, field, value, values);
+        }
+      } while(cursor.next(','));
+
+      cursor.expect('}');
+    }
+
+    if(!cursor.atEnd()) {
+      throw std::invalid_argument("Invalid JSON: trailing characters after the request");
+    }
+  } catch(smpp_pdu::Error &e) {
+    throw std::invalid_argument(e.what());
+  }
+
+  durable = values.durable;
+
+  finish(pdu, values, parts);
+}
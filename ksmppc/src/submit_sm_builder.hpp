@@ -0,0 +1,131 @@
+// File  : submit_sm_builder.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _SUBMIT_SM_BUILDER_HPP_
+#define _SUBMIT_SM_BUILDER_HPP_
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <kisscpp/boost_ptree.hpp>
+
+#include "cfg.hpp"
+#include "message_segmenter.hpp"
+#include "smpppdu_queue.hpp"
+
+//--------------------------------------------------------------------------------
+// What a send request gets, for the parameters it leaves out. Resolved from
+// the config once, when the builder is constructed, not per request.
+struct SubmitSmDefaults
+{
+  SubmitSmDefaults();                                  // TON and NPI from the smpp-session config section.
+  SubmitSmDefaults(uint8_t ton, uint8_t npi);
+
+  uint8_t addrTon;
+  uint8_t addrNpi;
+  uint8_t esmClass;
+  uint8_t protocolId;
+  uint8_t priorityFlag;
+  uint8_t registeredDelivery;
+  uint8_t replaceIfPresentFlag;
+  uint8_t dataCoding;
+  uint8_t smDefaultMsgId;
+  bool    durable;
+
+  private:
+    void configure(uint8_t ton, uint8_t npi);
+};
+
+//--------------------------------------------------------------------------------
+// The submit_sm's one send request turned into. More than one, if its
+// short-message had to be segmented.
+typedef std::vector<SharedPduSubmitSm> SubmitSmParts;
+
+//--------------------------------------------------------------------------------
+// Turns one "send" message, as found in a send or send-batch request, or on an
+// ingest connection, into submit_sm's. Each parameter is looked at once, and
+// goes straight into its PDU field. A short-message too long for one submit_sm
+// is split by the MessageSegmenter.
+//
+// Both build()s throw std::invalid_argument if a mandatory parameter is
+// missing, or a value can not be encoded. Construct builders at startup; a
+// builder is not changed by building, so threads may share one.
+class SubmitSmBuilder
+{
+  public:
+    SubmitSmBuilder() {};                                // defaults and segmentation from the config.
+    SubmitSmBuilder(const SubmitSmDefaults &d, const MessageSegmenter &s) : defaults(d), segmenter(s) {};
+
+    // A request that was already parsed, e.g. by the kisscpp server.
+    void build(const BoostPtree &message, SubmitSmParts &parts, bool &durable) const;
+
+    // The JSON text of one request object. Skips the ptree altogether. id gets
+    // the "id" parameter, if there is one, even when the request is rejected.
+    void build(const char *json, size_t length, SubmitSmParts &parts, bool &durable, std::string &id) const;
+
+  private:
+    enum Field {
+      NONE,
+      ID,
+      DURABLE,
+      SERVICE_TYPE,
+      SOURCE_ADDR_TON,
+      SOURCE_ADDR_NPI,
+      SOURCE_ADDR,
+      DESTINATION_ADDR_TON,
+      DESTINATION_ADDR_NPI,
+      DESTINATION_ADDR,
+      ESM_CLASS,
+      PROTOCOL_ID,
+      PRIORITY_FLAG,
+      SCHEDULE_DELIVERY_TIME,
+      VALIDITY_PERIOD,
+      REGISTERED_DELIVERY,
+      REPLACE_IF_PRESENT_FLAG,
+      DATA_CODING,
+      SM_DEFAULT_MSG_ID,
+      SHORT_MESSAGE
+    };
+
+    //--------------------------------------------------------------------------------
+    // What set() keeps aside for finish(), besides the PDU fields.
+    struct Values
+    {
+      bool        durable;
+      unsigned    seen;         // SEEN_* bits.
+      uint8_t     esmClass;
+      uint8_t     dataCoding;
+      std::string destination;
+      std::string shortMessage;
+    };
+
+    static Field lookup(const char *name, size_t length);
+
+    void start (smpp_pdu::PDU_submit_sm &pdu, Values &values) const;
+    void set   (smpp_pdu::PDU_submit_sm &pdu, Field field, const std::string &value, Values &values) const;
+    void finish(const smpp_pdu::PDU_submit_sm &pdu, const Values &values, SubmitSmParts &parts) const;
+
+    SubmitSmDefaults defaults;
+    MessageSegmenter segmenter;
+};
+
+#endif // _SUBMIT_SM_BUILDER_HPP_
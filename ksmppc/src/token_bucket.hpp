@@ -0,0 +1,104 @@
+// File  : token_bucket.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _TOKEN_BUCKET_HPP_
+#define _TOKEN_BUCKET_HPP_
+
+#include <ctime>
+#include <stdint.h>
+
+//--------------------------------------------------------------------------------
+// Rate limiter: holds at most 'burst' tokens, refilled continuously at
+// 'ratePerSecond'. Refilling is done on demand, with microsecond resolution,
+// so there is no need for a timer to top the bucket up. Time is taken from
+// CLOCK_MONOTONIC (see now()), so a DST change or an NTP step neither stalls
+// nor bursts the bucket.
+class TokenBucket
+{
+  public:
+    TokenBucket(unsigned ratePerSecond, unsigned burst) :
+      rate      ((ratePerSecond > 0) ? ratePerSecond : 1),
+      capacity  ((burst         > 0) ? burst         : 1),
+      tokens    (capacity),
+      lastRefill(now())
+    {
+    }
+
+    ~TokenBucket() {}
+
+    // Microseconds, from CLOCK_MONOTONIC.
+    static int64_t now()
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ((int64_t)ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+    }
+
+    // Takes a token if one is available.
+    bool consume(int64_t nowUs)
+    {
+      refill(nowUs);
+
+      if(tokens >= 1.0) {
+        tokens -= 1.0;
+        return true;
+      }
+
+      return false;
+    }
+
+    // Returns a token that was taken by consume(), but not used after all.
+    void refund()
+    {
+      tokens = (tokens + 1.0 > capacity) ? capacity : tokens + 1.0;
+    }
+
+    // Microseconds to wait before the next token becomes available.
+    int64_t timeUntilAvailable(int64_t nowUs)
+    {
+      refill(nowUs);
+
+      if(tokens >= 1.0) {
+        return 0;
+      }
+
+      return static_cast<int64_t>(((1.0 - tokens) * 1000000.0) / rate) + 1;
+    }
+
+  private:
+    void refill(int64_t nowUs)
+    {
+      if(nowUs > lastRefill) {
+        tokens    += ((nowUs - lastRefill) * rate) / 1000000.0;
+        lastRefill = nowUs;
+
+        if(tokens > capacity) {
+          tokens = capacity;
+        }
+      }
+    }
+
+    double                   rate;       // tokens per second
+    double                   capacity;   // burst size
+    double                   tokens;
+    int64_t                  lastRefill; // microseconds, see now().
+};
+
+#endif // _TOKEN_BUCKET_HPP_
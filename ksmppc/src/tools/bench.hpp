@@ -0,0 +1,88 @@
+// File  : bench.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _BENCH_HPP_
+#define _BENCH_HPP_
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <time.h>
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+//--------------------------------------------------------------------------------
+// The bits the ksmppc-bench-* programs share: a monotonic clock, and running
+// the same body on a number of threads that all start at once.
+namespace bench
+{
+  //------------------------------------------------------------------------------
+  inline int64_t nowNs()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
+
+  //------------------------------------------------------------------------------
+  typedef boost::function<void (unsigned threadIndex)> Body;
+
+  inline void runBody(boost::barrier *start, Body body, unsigned threadIndex)
+  {
+    start->wait();
+    body(threadIndex);
+  }
+
+  //------------------------------------------------------------------------------
+  // Runs body on threads threads, returns the nanoseconds from the moment they
+  // are released until the last one is done.
+  inline int64_t runThreads(unsigned threads, Body body)
+  {
+    boost::barrier      start(threads + 1);
+    boost::thread_group group;
+
+    for(unsigned i = 0; i < threads; ++i) {
+      group.create_thread(boost::bind(&runBody, &start, body, i));
+    }
+
+    int64_t began = nowNs();
+    start.wait();
+    group.join_all();
+
+    return nowNs() - began;
+  }
+
+  //------------------------------------------------------------------------------
+  inline void report(const std::string &name, unsigned threads, uint64_t operations, int64_t elapsedNs)
+  {
+    std::cout << std::left  << std::setw(32) << name
+              << std::right << std::setw(4)  << threads << " thread(s) "
+              << std::setw(12) << operations << " ops "
+              << std::fixed << std::setprecision(1)
+              << std::setw(10) << (double)elapsedNs / (operations ? operations : 1) << " ns/op "
+              << std::setw(14) << (elapsedNs ? operations * 1e9 / elapsedNs : 0.0) << " ops/s" << std::endl;
+  }
+}
+
+#endif // _BENCH_HPP_
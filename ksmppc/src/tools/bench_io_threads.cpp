@@ -0,0 +1,157 @@
+// File  : bench_io_threads.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// ksmppc-bench-io-threads: how the session io_service scales from 1 to N
+// io threads (smpp-session.io-threads).
+//
+// Each simulated session does what a SessionManager does on its strand for a
+// message: take a sequence number, encode the submit_sm, put it in the w4rQ,
+// and pop it again when its "response" comes back through the io_service.
+// There is no socket, so this measures the strand and the per PDU work, not
+// the network.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "bench.hpp"
+#include "awaiting_response_table.hpp"
+#include "sequence_number_generator.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+class BenchSession
+{
+  public:
+    BenchSession(boost::asio::io_service &io, unsigned window, uint64_t messages) :
+      io_service_(io),
+      strand     (io),
+      w4rQ       (window, 60),
+      window     (window),
+      remaining  (messages),
+      bytes      (0)
+    {
+    }
+
+    void start()
+    {
+      for(unsigned i = 0; i < window; ++i) {
+        strand.post(boost::bind(&BenchSession::send, this));
+      }
+    }
+
+  private:
+    void send()
+    {
+      if(remaining == 0) {
+        return;
+      }
+      --remaining;
+
+      boost::shared_ptr<smpp_pdu::PDU_submit_sm> pdu = boost::make_shared<smpp_pdu::PDU_submit_sm>();
+
+      pdu->command_id               = smpp_pdu::CommandId::SubmitSm;
+      pdu->source_addr.address      = "27820000000";
+      pdu->destination_addr.address = "27831234567";
+      pdu->short_message            = "The quick brown fox jumps over the lazy dog.";
+      pdu->sequence_number          = seqNumGen.next();
+
+      bytes += pdu->encode().size();
+      w4rQ.put(pdu);
+
+      // The response completes on whichever io thread is free, like an async_read would.
+      io_service_.post(strand.wrap(boost::bind(&BenchSession::respond, this, (uint32_t)pdu->sequence_number)));
+    }
+
+    void respond(uint32_t seqNum)
+    {
+      w4rQ.pop(seqNum);
+      send();
+    }
+
+    boost::asio::io_service         &io_service_;
+    boost::asio::io_service::strand  strand;
+    AwaitingResponseTable            w4rQ;
+    SequinceNumberGenerator          seqNumGen;
+    unsigned                         window;
+    uint64_t                         remaining;
+    uint64_t                         bytes;     // keeps the encoding from being optimised away.
+};
+
+//--------------------------------------------------------------------------------
+static void runIoService(boost::asio::io_service *io, unsigned)
+{
+  io->run();
+}
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"    , "Print help messages")
+    ("threads,t" , bpo::value<unsigned>()->default_value(boost::thread::hardware_concurrency()), "Run with 1 up to this many io threads")
+    ("sessions,s", bpo::value<unsigned>()->default_value(16), "Number of sessions")
+    ("window,w"  , bpo::value<unsigned>()->default_value(64), "Messages in flight per session")
+    ("count,n"   , bpo::value<uint64_t>()->default_value(200000), "Messages sent by each session");
+
+  try {
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-bench-io-threads [options]\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  unsigned maxThreads = std::max(vm["threads"].as<unsigned>(), 1u);
+  unsigned sessions   = std::max(vm["sessions"].as<unsigned>(), 1u);
+  unsigned window     = std::max(vm["window"].as<unsigned>(), 1u);
+  uint64_t count      = vm["count"].as<uint64_t>();
+
+  for(unsigned threads = 1; threads <= maxThreads; ++threads) {
+    boost::asio::io_service                        io;
+    std::vector< boost::shared_ptr<BenchSession> > all;
+
+    for(unsigned i = 0; i < sessions; ++i) {
+      all.push_back(boost::make_shared<BenchSession>(boost::ref(io), window, count));
+      all.back()->start();
+    }
+
+    int64_t elapsed = bench::runThreads(threads, boost::bind(&runIoService, &io, _1));
+
+    bench::report("io-threads", threads, (uint64_t)sessions * count, elapsed);
+  }
+
+  return 0;
+}
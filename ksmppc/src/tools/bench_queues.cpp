@@ -0,0 +1,187 @@
+// File  : bench_queues.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// ksmppc-bench-queues: the "segment" queue backend against the "paged" one
+// ("queues.<name>.backend"). Each queue is filled, then drained, with
+// submit_sm PDUs (as the txQ holds them) and with encoded deliver_sm
+// bytes (as the rxQ holds them).
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+
+#include "bench.hpp"
+#include "pdu_queue.hpp"
+#include "sharedsmpppdu.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+static unsigned batchSize = 1;
+
+template <class T>
+static void fillAndDrain(const std::string &name, PduQueue<T> &queue, const std::vector< boost::shared_ptr<T> > &items)
+{
+  int64_t began = bench::nowNs();
+
+  if(batchSize > 1) {
+    for(size_t i = 0; i < items.size(); i += batchSize) {
+      queue.push_batch(std::vector< boost::shared_ptr<T> >(items.begin() + i, items.begin() + std::min(items.size(), i + batchSize)));
+    }
+  } else {
+    for(size_t i = 0; i < items.size(); ++i) {
+      queue.push(items[i]);
+    }
+  }
+
+  bench::report(name + " push", 1, items.size(), bench::nowNs() - began);
+
+  size_t popped = 0;
+  began = bench::nowNs();
+
+  while(queue.pop()) {
+    ++popped;
+  }
+
+  bench::report(name + " pop", 1, popped, bench::nowNs() - began);
+
+  if(popped != items.size()) {
+    std::cerr << "ERROR: " << name << " gave back " << popped << " of " << items.size() << " items." << std::endl;
+    exit(1);
+  }
+}
+
+//--------------------------------------------------------------------------------
+static void removeFiles(const std::string &dir)
+{
+  DIR *d = opendir(dir.c_str());
+
+  for(struct dirent *e = d ? readdir(d) : NULL; e; e = readdir(d)) {
+    if(e->d_name[0] != '.') {
+      unlink((dir + "/" + e->d_name).c_str());
+    }
+  }
+
+  if(d) {
+    closedir(d);
+  }
+}
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"     , "Print help messages")
+    ("count,n"    , bpo::value<unsigned>()->default_value(100000), "Items pushed into, and popped from, each queue")
+    ("directory,d", bpo::value<std::string>()->default_value("/tmp"), "Where the queue files go, in a directory of their own")
+    ("page-size,p", bpo::value<unsigned>()->default_value(10), "Items per page, for the paged backend")
+    ("batch,b"    , bpo::value<unsigned>()->default_value(1), "Push this many items at a time, with push_batch()")
+    ("durable"    , "Also run a durable segment queue. Without --batch, every push waits for its own sync");
+
+  try {
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-bench-queues [options]\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  unsigned          count    = std::max(vm["count"].as<unsigned>(), 1u);
+  unsigned          pageSize = vm["page-size"].as<unsigned>();
+  batchSize                  = std::max(vm["batch"].as<unsigned>(), 1u);
+  std::string       tmpl     = vm["directory"].as<std::string>() + "/ksmppc-bench-queues.XXXXXX";
+  std::vector<char> path(tmpl.begin(), tmpl.end());
+
+  path.push_back('\0');
+
+  if(!mkdtemp(&path[0])) {
+    std::cerr << "ERROR: could not create " << tmpl << std::endl;
+    return 1;
+  }
+
+  std::string dir(&path[0]);
+
+  // What a send request turns into.
+  std::vector<SharedSmppPdu> pdus;
+
+  for(unsigned i = 0; i < count; ++i) {
+    boost::shared_ptr<smpp_pdu::PDU_submit_sm> pdu = boost::make_shared<smpp_pdu::PDU_submit_sm>();
+
+    pdu->command_id               = smpp_pdu::CommandId::SubmitSm;
+    pdu->sequence_number          = i + 1;
+    pdu->source_addr.address      = "27820000000";
+    pdu->destination_addr.address = "27831234567";
+    pdu->short_message            = "The quick brown fox jumps over the lazy dog, message number " + boost::lexical_cast<std::string>(i);
+    pdus.push_back(pdu);
+  }
+
+  // What a session reads off the socket: an encoded deliver_sm, 16 byte header and all.
+  std::vector<SharedPduBytes> frames;
+  std::string                 frame(120, 'x');
+
+  for(unsigned i = 0; i < count; ++i) {
+    frame[3]  = 120;
+    frame[7]  = 0x05;
+    frames.push_back(boost::make_shared<std::string>(frame));
+  }
+
+  {
+    PagedPduQueue<smpp_pdu::SMPP_PDU, SmppPduBase64Bicoder> queue("paged-pdu", dir, pageSize);
+    fillAndDrain("paged, submit_sm", queue, pdus);
+  }
+  {
+    SegmentPduQueue<smpp_pdu::SMPP_PDU, SmppPduWireCodec> queue("segment-pdu", dir, 16 * 1024 * 1024);
+    fillAndDrain("segment, submit_sm", queue, pdus);
+  }
+  {
+    PagedPduQueue<std::string, PduBytesBase64Bicoder> queue("paged-bytes", dir, pageSize);
+    fillAndDrain("paged, bytes", queue, frames);
+  }
+  {
+    SegmentPduQueue<std::string, PduBytesWireCodec> queue("segment-bytes", dir, 16 * 1024 * 1024);
+    fillAndDrain("segment, bytes", queue, frames);
+  }
+
+  if(vm.count("durable")) {
+    SegmentPduQueue<std::string, PduBytesWireCodec> queue("durable-bytes", dir, 16 * 1024 * 1024, true);
+    fillAndDrain("segment durable, bytes", queue, frames);
+  }
+
+  removeFiles(dir);
+  rmdir(dir.c_str());
+
+  return 0;
+}
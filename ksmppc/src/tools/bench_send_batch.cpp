@@ -0,0 +1,217 @@
+// File  : bench_send_batch.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+
+// ksmppc-bench-send-batch: messages sent one "send" request each, through
+// SendHandler, against the same messages in "send-batch" requests, through
+// SendBatchHandler. Each request is read with read_json(), as the kisscpp
+// server reads it, and the messages are queued on a sendingBuffer of each
+// backend. The TCP connection a single send costs as well, is left out.
+// The handlers get a builder with fixed defaults, so no config is needed.
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "bench.hpp"
+#include "handler_send.hpp"
+#include "handler_send_batch.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+// Durable, so that nothing goes down the fast lane: there are no sessions here.
+static std::string message(unsigned i)
+{
+  return "\"source-addr\":\"27820000000\",\"destination-addr\":\"2783" + boost::lexical_cast<std::string>(1000000 + i % 9000000) + "\","
+         "\"durable\":\"true\",\"short-message\":\"The quick brown fox jumps over the lazy dog, message number " +
+         boost::lexical_cast<std::string>(i) + "\"";
+}
+
+static void parse(const std::string &json, BoostPtree &request)
+{
+  std::istringstream in(json);
+  boost::property_tree::read_json(in, request);
+}
+
+static void drain(SharedSmppPduQueue queue, size_t expected, const std::string &name)
+{
+  size_t queued = queue->size();
+
+  while(!queue->empty()) {
+    queue->pop();
+  }
+
+  if(queued != expected) {
+    std::cerr << "ERROR: " << name << " queued " << queued << " of " << expected << " messages." << std::endl;
+    exit(1);
+  }
+}
+
+//--------------------------------------------------------------------------------
+static void compare(const std::string              &name,
+                    SharedSmppPduQueue              queue,
+                    const std::vector<std::string> &singles,
+                    const std::vector<std::string> &batches,
+                    unsigned                        batchSize)
+{
+  SubmitSmBuilder  builder     (SubmitSmDefaults(1, 1), MessageSegmenter(8, 16));
+  SendHandler      sendHandler (queue, SharedSessionPool(), builder);
+  SendBatchHandler batchHandler(queue, SharedSessionPool(), builder, batchSize);
+  int64_t          began;
+  size_t           accepted = 0;
+
+  began = bench::nowNs();
+  for(size_t i = 0; i < singles.size(); ++i) {
+    BoostPtree request;
+    BoostPtree response;
+
+    parse(singles[i], request);
+    sendHandler.run(request, response);
+    accepted += (response.get<int>("kcm-sts") == kisscpp::RQST_SUCCESS);
+  }
+  bench::report(name + ", send", 1, singles.size(), bench::nowNs() - began);
+
+  drain(queue, accepted, name + ", send");
+
+  if(accepted != singles.size()) {
+    std::cerr << "ERROR: " << name << ", send accepted " << accepted << " of " << singles.size() << " messages." << std::endl;
+    exit(1);
+  }
+
+  accepted = 0;
+  began    = bench::nowNs();
+  for(size_t i = 0; i < batches.size(); ++i) {
+    BoostPtree request;
+    BoostPtree response;
+
+    parse(batches[i], request);
+    batchHandler.run(request, response);
+    accepted += response.get<size_t>("accepted", 0);
+  }
+  bench::report(name + ", send-batch", 1, singles.size(), bench::nowNs() - began);
+
+  drain(queue, accepted, name + ", send-batch");
+
+  if(accepted != singles.size()) {
+    std::cerr << "ERROR: " << name << ", send-batch accepted " << accepted << " of " << singles.size() << " messages." << std::endl;
+    exit(1);
+  }
+}
+
+//--------------------------------------------------------------------------------
+static void removeFiles(const std::string &dir)
+{
+  DIR *d = opendir(dir.c_str());
+
+  for(struct dirent *e = d ? readdir(d) : NULL; e; e = readdir(d)) {
+    if(e->d_name[0] != '.') {
+      unlink((dir + "/" + e->d_name).c_str());
+    }
+  }
+
+  if(d) {
+    closedir(d);
+  }
+}
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"     , "Print help messages")
+    ("count,n"    , bpo::value<unsigned>()->default_value(10000), "Messages sent, each way")
+    ("batch,b"    , bpo::value<unsigned>()->default_value(1000), "Messages per send-batch request")
+    ("directory,d", bpo::value<std::string>()->default_value("/tmp"), "Where the queue files go, in a directory of their own")
+    ("durable"    , "Also run a durable segment queue, on which every single send waits for its own sync");
+
+  try {
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-bench-send-batch [options]\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  unsigned          count     = std::max(vm["count"].as<unsigned>(), 1u);
+  unsigned          batchSize = std::max(vm["batch"].as<unsigned>(), 1u);
+  std::string       tmpl      = vm["directory"].as<std::string>() + "/ksmppc-bench-send-batch.XXXXXX";
+  std::vector<char> path(tmpl.begin(), tmpl.end());
+
+  path.push_back('\0');
+
+  if(!mkdtemp(&path[0])) {
+    std::cerr << "ERROR: could not create " << tmpl << std::endl;
+    return 1;
+  }
+
+  std::string dir(&path[0]);
+
+  std::vector<std::string> singles;
+  std::vector<std::string> batches;
+
+  for(unsigned i = 0; i < count; ++i) {
+    singles.push_back("{\"kcm-cmd\":\"send\"," + message(i) + "}");
+  }
+
+  for(unsigned i = 0; i < count; i += batchSize) {
+    std::string request = "{\"kcm-cmd\":\"send-batch\",\"messages\":[";
+
+    for(unsigned j = i; j < std::min(count, i + batchSize); ++j) {
+      request += (j > i ? ",{" : "{") + message(j) + "}";
+    }
+
+    batches.push_back(request + "]}");
+  }
+
+  try {
+    compare("paged"  , SharedSmppPduQueue(new PagedPduQueue<smpp_pdu::SMPP_PDU, SmppPduBase64Bicoder>("paged", dir, 10)), singles, batches, batchSize);
+    compare("segment", SharedSmppPduQueue(new SegmentPduQueue<smpp_pdu::SMPP_PDU, SmppPduWireCodec>("segment", dir, 16 * 1024 * 1024)), singles, batches, batchSize);
+
+    if(vm.count("durable")) {
+      compare("segment durable", SharedSmppPduQueue(new SegmentPduQueue<smpp_pdu::SMPP_PDU, SmppPduWireCodec>("durable", dir, 16 * 1024 * 1024, true)), singles, batches, batchSize);
+    }
+  } catch(std::exception &e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+
+  removeFiles(dir);
+  rmdir(dir.c_str());
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+// File  : bench_send_parser.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// ksmppc-bench-send-parser: a send request, from its JSON text to a submit_sm,
+// three ways:
+//   old send          : read_json(), then the field extraction SendHandler did
+//                       before SubmitSmBuilder: 17 request.get<>()s, and 4
+//                       config lookups for the default TON and NPI.
+//   read_json, build  : read_json(), then SubmitSmBuilder::build(ptree), as the
+//                       send and send-batch handlers do now.
+//   build(json)       : SubmitSmBuilder::build(json, ...), as the ingest does.
+// The config lookups of the old path go to a ptree with the same keys, so
+// whatever kisscpp's Config adds on top of that is left out of its cost.
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "bench.hpp"
+#include "submit_sm_builder.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+static const char *plainRequest =
+  "{\"kcm-cmd\":\"send\",\"id\":\"a3f1c2d4-0001\",\"source-addr\":\"27820000000\","
+  "\"destination-addr\":\"27831234567\",\"registered-delivery\":\"1\",\"data-coding\":\"0\","
+  "\"durable\":\"true\",\"short-message\":\"The quick brown fox jumps over the lazy dog, message number 1234\"}";
+
+// The same, with a short-message that is mostly \u escapes, a surrogate pair among them.
+static const char *escapedRequest =
+  "{\"kcm-cmd\":\"send\",\"id\":\"a3f1c2d4-0002\",\"source-addr\":\"27820000000\","
+  "\"destination-addr\":\"27831234567\",\"registered-delivery\":\"1\",\"data-coding\":\"4\","
+  "\"durable\":\"true\",\"short-message\":\"\\u041f\\u0440\\u0438\\u0432\\u0435\\u0442 \\ud83d\\ude00 "
+  "\\u00e9\\u00e8\\u00ea\\n\\\"quoted\\\"\\t\\u4f60\\u597d\\u4e16\\u754c\"}";
+
+//--------------------------------------------------------------------------------
+// Stands in for CFG, in oldSend().
+static BoostPtree config;
+
+static void parse(const std::string &json, BoostPtree &request)
+{
+  std::istringstream in(json);
+  boost::property_tree::read_json(in, request);
+}
+
+//--------------------------------------------------------------------------------
+// SendHandler::run(), up to the push, before SubmitSmBuilder replaced it.
+static SharedPduSubmitSm oldSend(const std::string &json, bool &durable)
+{
+  BoostPtree request;
+
+  parse(json, request);
+
+  std::string shortMessage = request.get<std::string>("short-message");
+
+  if(shortMessage.size() > 254) {
+    throw std::invalid_argument("short-message is longer than 254 octets");
+  }
+
+  SharedPduSubmitSm submitPDU(new smpp_pdu::PDU_submit_sm());
+
+  submitPDU->service_type             = request.get<std::string>("service-type"          ,"");
+  submitPDU->source_addr     .ton     = request.get<uint8_t>    ("source-addr-ton"       ,config.get<uint8_t>("smpp-session.default-type-of-number"));
+  submitPDU->source_addr     .npi     = request.get<uint8_t>    ("source-addr-npi"       ,config.get<uint8_t>("smpp-session.default-number-plan-indicator"));
+  submitPDU->source_addr     .address = request.get<std::string>("source-addr");
+  submitPDU->destination_addr.ton     = request.get<uint8_t>    ("destination-addr-ton"  ,config.get<uint8_t>("smpp-session.default-type-of-number"));
+  submitPDU->destination_addr.npi     = request.get<uint8_t>    ("destination-addr-npi"  ,config.get<uint8_t>("smpp-session.default-number-plan-indicator"));
+  submitPDU->destination_addr.address = request.get<std::string>("destination-addr");
+  submitPDU->esm_class                = request.get<uint8_t>    ("esm-class"             ,0);
+  submitPDU->protocol_id              = request.get<uint8_t>    ("protocol-id"           ,0);
+  submitPDU->priority_flag            = request.get<uint8_t>    ("priority-flag"         ,0);
+  submitPDU->schedule_delivery_time   = request.get<std::string>("schedule-delivery-time","");
+  submitPDU->validity_period          = request.get<std::string>("validity-period"       ,"");
+  submitPDU->registered_delivery      = request.get<uint8_t>    ("registered-delivery"   ,3);
+  submitPDU->replace_if_present_flag  = request.get<uint8_t>    ("replace-if-presentFlag",0);
+  submitPDU->data_coding              = request.get<uint8_t>    ("data-coding"           ,3);
+  submitPDU->sm_default_msg_id        = request.get<uint8_t>    ("sm-default-msg-id"     ,0);
+  submitPDU->short_message            = shortMessage;
+
+  durable = request.get<bool>("durable", true);
+
+  return submitPDU;
+}
+
+//--------------------------------------------------------------------------------
+// Each way has to end with the request's short-message, as read_json() reads it.
+static void check(const std::string &name, const SharedPduSubmitSm &pdu, const std::string &shortMessage)
+{
+  if(!pdu || (std::string)pdu->short_message != shortMessage) {
+    std::cerr << "ERROR: " << name << " built the wrong submit_sm." << std::endl;
+    exit(1);
+  }
+}
+
+static void compare(const std::string &name, const std::string &json, const SubmitSmBuilder &builder, unsigned count)
+{
+  BoostPtree        request;
+  SharedPduSubmitSm last;
+  SubmitSmParts     parts;
+  std::string       id;
+  bool              durable;
+  int64_t           began;
+
+  parse(json, request);
+  std::string shortMessage = request.get<std::string>("short-message", "");
+
+  began = bench::nowNs();
+  for(unsigned i = 0; i < count; ++i) {
+    last = oldSend(json, durable);
+  }
+  bench::report(name + ", old send", 1, count, bench::nowNs() - began);
+  check(name + ", old send", last, shortMessage);
+
+  began = bench::nowNs();
+  for(unsigned i = 0; i < count; ++i) {
+    BoostPtree parsed;
+
+    parse(json, parsed);
+    builder.build(parsed, parts, durable);
+  }
+  bench::report(name + ", read_json, build", 1, count, bench::nowNs() - began);
+  check(name + ", read_json, build", parts.empty() ? SharedPduSubmitSm() : parts[0], shortMessage);
+
+  parts.clear();
+
+  began = bench::nowNs();
+  for(unsigned i = 0; i < count; ++i) {
+    builder.build(json.data(), json.size(), parts, durable, id);
+  }
+  bench::report(name + ", build(json)", 1, count, bench::nowNs() - began);
+  check(name + ", build(json)", parts.empty() ? SharedPduSubmitSm() : parts[0], shortMessage);
+}
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"   , "Print help messages")
+    ("count,n"  , bpo::value<unsigned>()->default_value(200000), "Requests built, each way")
+    ("request,r", bpo::value<std::string>(), "A request of your own, instead of the built in ones");
+
+  try {
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-bench-send-parser [options]\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  unsigned count = std::max(vm["count"].as<unsigned>(), 1u);
+
+  config.put("smpp-session.default-type-of-number"       , 1);
+  config.put("smpp-session.default-number-plan-indicator", 1);
+
+  try {
+    SubmitSmBuilder builder(SubmitSmDefaults(1, 1), MessageSegmenter(8, 16));
+
+    if(vm.count("request")) {
+      compare("request", vm["request"].as<std::string>(), builder, count);
+    } else {
+      compare("plain"  , plainRequest  , builder, count);
+      compare("escaped", escapedRequest, builder, count);
+    }
+  } catch(std::exception &e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
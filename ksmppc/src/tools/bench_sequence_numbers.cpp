@@ -0,0 +1,131 @@
+// File  : bench_sequence_numbers.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// ksmppc-bench-seqnum: contention microbenchmark of SequinceNumberGenerator.
+// 1..N threads all call next() on one generator. The mutex generator it
+// replaced is run the same way, for comparison.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include <boost/program_options.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "bench.hpp"
+#include "sequence_number_generator.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+// The generator as it was, one lock per number.
+class MutexSequenceNumberGenerator
+{
+  public:
+    MutexSequenceNumberGenerator() : mVal(smpp_pdu::SequenceNumber::Min) {}
+
+    uint32_t next()
+    {
+      boost::lock_guard<boost::mutex> l(mMtx);
+      if(mVal < smpp_pdu::SequenceNumber::Max) {
+        return mVal++;
+      } else {
+        mVal = smpp_pdu::SequenceNumber::Min;
+        return smpp_pdu::SequenceNumber::Max;
+      }
+    }
+
+  private:
+    uint32_t     mVal;
+    boost::mutex mMtx;
+};
+
+//--------------------------------------------------------------------------------
+static volatile uint32_t sink; // keeps the calls from being optimised away.
+
+template <class Generator>
+static void drawNumbers(Generator *generator, uint64_t count, unsigned)
+{
+  uint32_t last = 0;
+
+  for(uint64_t i = 0; i < count; ++i) {
+    last = generator->next();
+  }
+
+  sink = last;
+}
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"   , "Print help messages")
+    ("threads,t", bpo::value<unsigned>()->default_value(boost::thread::hardware_concurrency()), "Run with 1 up to this many threads")
+    ("count,n"  , bpo::value<uint64_t>()->default_value(2000000), "Numbers drawn by each thread")
+    ("file,f"   , bpo::value<std::string>()->default_value("ksmppc-bench-seqnum.mark"), "Where the persisted generator keeps its mark")
+    ("reserve,r", bpo::value<unsigned>()->default_value(10000), "Numbers reserved per mark write");
+
+  try {
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-bench-seqnum [options]\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  unsigned    maxThreads = std::max(vm["threads"].as<unsigned>(), 1u);
+  uint64_t    count      = vm["count"].as<uint64_t>();
+  std::string markFile   = vm["file"].as<std::string>();
+  unsigned    reserve    = vm["reserve"].as<unsigned>();
+
+  for(unsigned threads = 1; threads <= maxThreads; ++threads) {
+    {
+      MutexSequenceNumberGenerator generator;
+      int64_t elapsed = bench::runThreads(threads, boost::bind(&drawNumbers<MutexSequenceNumberGenerator>, &generator, count, _1));
+      bench::report("mutex", threads, threads * count, elapsed);
+    }
+    {
+      SequinceNumberGenerator generator;
+      int64_t elapsed = bench::runThreads(threads, boost::bind(&drawNumbers<SequinceNumberGenerator>, &generator, count, _1));
+      bench::report("fetch-add", threads, threads * count, elapsed);
+    }
+    {
+      remove(markFile.c_str());
+      SequinceNumberGenerator generator(markFile, reserve);
+      int64_t elapsed = bench::runThreads(threads, boost::bind(&drawNumbers<SequinceNumberGenerator>, &generator, count, _1));
+      bench::report("fetch-add, persisted mark", threads, threads * count, elapsed);
+    }
+  }
+
+  remove(markFile.c_str());
+  remove((markFile + ".tmp").c_str());
+
+  return 0;
+}
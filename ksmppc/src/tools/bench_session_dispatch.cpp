@@ -0,0 +1,164 @@
+// File  : bench_session_dispatch.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// ksmppc-bench-dispatch: the SessionDispatch tables against the nested
+// switches they replaced, inbound and outbound, over a stream of PDUs in
+// random states and with a mix of command ids. Inbound, also dispatch(), the
+// table behind a switch for bound sessions, which is what SessionManager uses.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "bench.hpp"
+#include "recording_session.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+// Mostly message traffic, some link management, and the odd unknown command.
+static const uint32_t inboundMix[] = {
+  smpp_pdu::CommandId::SubmitSmResp, smpp_pdu::CommandId::SubmitSmResp, smpp_pdu::CommandId::SubmitSmResp,
+  smpp_pdu::CommandId::DeliverSm,    smpp_pdu::CommandId::DeliverSm,    smpp_pdu::CommandId::DataSm,
+  smpp_pdu::CommandId::EnquireLink,  smpp_pdu::CommandId::EnquireLinkResp, smpp_pdu::CommandId::GenericNack,
+  smpp_pdu::CommandId::QuerySmResp,  smpp_pdu::CommandId::BindTransceiverResp, smpp_pdu::CommandId::Unbind,
+  0x00000104
+};
+
+static const uint32_t outboundMix[] = {
+  smpp_pdu::CommandId::SubmitSm,     smpp_pdu::CommandId::SubmitSm,      smpp_pdu::CommandId::SubmitSm,
+  smpp_pdu::CommandId::DeliverSmResp, smpp_pdu::CommandId::DeliverSmResp, smpp_pdu::CommandId::DataSmResp,
+  smpp_pdu::CommandId::QuerySm,      smpp_pdu::CommandId::CancelSm,      smpp_pdu::CommandId::EnquireLink
+};
+
+struct Input
+{
+  RecordingSession::State state;
+  uint32_t                commandId;
+  uint8_t                 frame[16];
+};
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"  , "Print help messages")
+    ("count,n" , bpo::value<unsigned>()->default_value(4096), "Number of distinct PDUs in the stream")
+    ("rounds,r", bpo::value<unsigned>()->default_value(5000), "Times the stream is dispatched")
+    ("bound,b" , "Only the BOUND_TRX state, instead of a random state per PDU");
+
+  try {
+    bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-bench-dispatch [options]\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  unsigned count  = std::max(vm["count"].as<unsigned>(), 1u);
+  unsigned rounds = vm["rounds"].as<unsigned>();
+
+  RecordingSession::Dispatch::build();
+
+  std::vector<Input> inbound(count);
+  std::vector<Input> outbound(count);
+
+  srand(1);
+
+  for(unsigned i = 0; i < count; ++i) {
+    RecordingSession::State state = vm.count("bound") ? RecordingSession::BOUND_TRX
+                                                      : (RecordingSession::State)(rand() % RecordingSession::Dispatch::STATE_COUNT);
+    uint32_t                in    = inboundMix [rand() % (sizeof(inboundMix)  / sizeof(inboundMix [0]))];
+
+    inbound[i].state     = state;
+    inbound[i].commandId = in;
+    memset(inbound[i].frame, 0, sizeof(inbound[i].frame));
+    inbound[i].frame[3]  = 16;
+    inbound[i].frame[4]  = in >> 24;
+    inbound[i].frame[5]  = in >> 16;
+    inbound[i].frame[6]  = in >> 8;
+    inbound[i].frame[7]  = in;
+
+    outbound[i]           = inbound[i];
+    outbound[i].commandId = outboundMix[rand() % (sizeof(outboundMix) / sizeof(outboundMix[0]))];
+  }
+
+  uint64_t          operations = (uint64_t)count * rounds;
+  RecordingSession  session;
+  int64_t           began;
+  volatile unsigned permitted  = 0;
+
+  began = bench::nowNs();
+  for(unsigned r = 0; r < rounds; ++r) {
+    for(unsigned i = 0; i < count; ++i) {
+      RawPdu rawpdu(inbound[i].frame);
+      session.process4state_switch(inbound[i].state, rawpdu);
+    }
+  }
+  bench::report("inbound, switch", 1, operations, bench::nowNs() - began);
+
+  began = bench::nowNs();
+  for(unsigned r = 0; r < rounds; ++r) {
+    for(unsigned i = 0; i < count; ++i) {
+      RawPdu rawpdu(inbound[i].frame);
+      session.process4state_table(inbound[i].state, rawpdu);
+    }
+  }
+  bench::report("inbound, table", 1, operations, bench::nowNs() - began);
+
+  began = bench::nowNs();
+  for(unsigned r = 0; r < rounds; ++r) {
+    for(unsigned i = 0; i < count; ++i) {
+      RawPdu rawpdu(inbound[i].frame);
+      session.process4state(inbound[i].state, rawpdu);
+    }
+  }
+  bench::report("inbound, dispatch()", 1, operations, bench::nowNs() - began);
+
+  began = bench::nowNs();
+  for(unsigned r = 0; r < rounds; ++r) {
+    for(unsigned i = 0; i < count; ++i) {
+      permitted += session.send4state_switch(outbound[i].state, outbound[i].commandId);
+    }
+  }
+  bench::report("outbound, switch", 1, operations, bench::nowNs() - began);
+
+  began = bench::nowNs();
+  for(unsigned r = 0; r < rounds; ++r) {
+    for(unsigned i = 0; i < count; ++i) {
+      permitted += session.send4state_table(outbound[i].state, outbound[i].commandId);
+    }
+  }
+  bench::report("outbound, table", 1, operations, bench::nowNs() - began);
+
+  return (session.calls == 3 * operations) ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+// File  : ksmppc_trace.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// ksmppc-trace: decodes a PDU trace ring file into readable SMPP.
+// The file is either the mapped ring itself ("pdu-trace-ring.file"), a dump
+// made through the "dump-trace" handler, or the one written on a crash.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstring>
+#include <stdint.h>
+
+#include <boost/program_options.hpp>
+
+#include "pdu_trace.hpp"
+
+namespace bpo = boost::program_options;
+
+//--------------------------------------------------------------------------------
+static const char *commandName(uint32_t id)
+{
+  switch(id) {
+    case 0x80000000: return "generic_nack";
+    case 0x00000001: return "bind_receiver";
+    case 0x80000001: return "bind_receiver_resp";
+    case 0x00000002: return "bind_transmitter";
+    case 0x80000002: return "bind_transmitter_resp";
+    case 0x00000003: return "query_sm";
+    case 0x80000003: return "query_sm_resp";
+    case 0x00000004: return "submit_sm";
+    case 0x80000004: return "submit_sm_resp";
+    case 0x00000005: return "deliver_sm";
+    case 0x80000005: return "deliver_sm_resp";
+    case 0x00000006: return "unbind";
+    case 0x80000006: return "unbind_resp";
+    case 0x00000007: return "replace_sm";
+    case 0x80000007: return "replace_sm_resp";
+    case 0x00000008: return "cancel_sm";
+    case 0x80000008: return "cancel_sm_resp";
+    case 0x00000009: return "bind_transceiver";
+    case 0x80000009: return "bind_transceiver_resp";
+    case 0x0000000B: return "outbind";
+    case 0x00000015: return "enquire_link";
+    case 0x80000015: return "enquire_link_resp";
+    case 0x00000021: return "submit_multi";
+    case 0x80000021: return "submit_multi_resp";
+    case 0x00000102: return "alert_notification";
+    case 0x00000103: return "data_sm";
+    case 0x80000103: return "data_sm_resp";
+    case 0x00000111: return "broadcast_sm";
+    case 0x80000111: return "broadcast_sm_resp";
+    case 0x00000112: return "query_broadcast_sm";
+    case 0x80000112: return "query_broadcast_sm_resp";
+    case 0x00000113: return "cancel_broadcast_sm";
+    case 0x80000113: return "cancel_broadcast_sm_resp";
+    default        : return "unknown";
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Walks the body of a PDU. Running past the captured bytes is not an error, the
+// remaining fields are simply reported as missing.
+class BodyReader
+{
+  public:
+    BodyReader(const uint8_t *data, size_t length) : p(data), end(data + length), overrun(false) {}
+
+    bool        more   () { return (p < end); }
+    bool        overran() { return overrun; }
+
+    uint8_t     u8     () { if(p + 1 > end) { overrun = true; return 0; } return *p++; }
+    uint16_t    u16    () { uint16_t v = u8(); return (v << 8) | u8(); }
+    uint32_t    u32    () { uint32_t v = u16(); return (v << 16) | u16(); }
+
+    std::string cstr   ()
+    {
+      std::string s;
+      while(p < end && *p) {
+        s += (char)*p++;
+      }
+      if(p < end) {
+        ++p;
+      } else {
+        overrun = true;
+      }
+      return s;
+    }
+
+    std::string octets (size_t n)
+    {
+      if(p + n > end) {
+        overrun = true;
+        n       = end - p;
+      }
+      std::string s(reinterpret_cast<const char*>(p), n);
+      p += n;
+      return s;
+    }
+
+  private:
+    const uint8_t *p;
+    const uint8_t *end;
+    bool           overrun;
+};
+
+//--------------------------------------------------------------------------------
+static std::string printable(const std::string &s)
+{
+  std::ostringstream os;
+
+  for(size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if(c >= 0x20 && c < 0x7F) {
+      os << c;
+    } else {
+      os << "\\x" << std::hex << std::setw(2) << std::setfill('0') << (unsigned)c << std::dec;
+    }
+  }
+
+  return os.str();
+}
+
+//--------------------------------------------------------------------------------
+static void decodeMessage(BodyReader &r, std::ostream &os)
+{
+  // submit_sm and deliver_sm share a body.
+  std::string serviceType = r.cstr();
+  unsigned    srcTon      = r.u8();
+  unsigned    srcNpi      = r.u8();
+  std::string src         = r.cstr();
+  unsigned    dstTon      = r.u8();
+  unsigned    dstNpi      = r.u8();
+  std::string dst         = r.cstr();
+  unsigned    esmClass    = r.u8();
+  unsigned    protocolId  = r.u8();
+  unsigned    priority    = r.u8();
+  std::string schedule    = r.cstr();
+  std::string validity    = r.cstr();
+  unsigned    regDelivery = r.u8();
+  unsigned    replace     = r.u8();
+  unsigned    dataCoding  = r.u8();
+  unsigned    defaultMsg  = r.u8();
+  unsigned    smLength    = r.u8();
+  std::string sm          = r.octets(smLength);
+
+  os << "    service_type=\"" << printable(serviceType) << "\""
+     << " source_addr="      << srcTon << "/" << srcNpi << "/" << printable(src)
+     << " destination_addr=" << dstTon << "/" << dstNpi << "/" << printable(dst) << "\n"
+     << "    esm_class=0x"   << std::hex << esmClass << std::dec
+     << " protocol_id="      << protocolId
+     << " priority_flag="    << priority
+     << " schedule_delivery_time=\"" << printable(schedule) << "\""
+     << " validity_period=\""        << printable(validity) << "\"\n"
+     << "    registered_delivery="   << regDelivery
+     << " replace_if_present_flag="  << replace
+     << " data_coding="              << dataCoding
+     << " sm_default_msg_id="        << defaultMsg
+     << " sm_length="                << smLength << "\n"
+     << "    short_message=\""       << printable(sm) << "\"\n";
+
+  while(r.more()) {
+    unsigned tag    = r.u16();
+    unsigned length = r.u16();
+    os << "    tlv 0x" << std::hex << std::setw(4) << std::setfill('0') << tag << std::dec << std::setfill(' ')
+       << " (" << length << " bytes) \"" << printable(r.octets(length)) << "\"\n";
+  }
+}
+
+//--------------------------------------------------------------------------------
+static void decodeBody(uint32_t commandId, BodyReader &r, std::ostream &os)
+{
+  switch(commandId) {
+    case 0x00000004:
+    case 0x00000005:
+      decodeMessage(r, os);
+      break;
+    case 0x80000004:
+    case 0x80000005:
+    case 0x80000103:
+      if(r.more()) {
+        os << "    message_id=\"" << printable(r.cstr()) << "\"\n";
+      }
+      break;
+    case 0x00000001:
+    case 0x00000002:
+    case 0x00000009:
+      {
+        std::string systemId = r.cstr();
+        r.cstr(); // the password stays out of the output.
+        std::string systemType = r.cstr();
+        unsigned    version    = r.u8();
+        os << "    system_id=\"" << printable(systemId) << "\" system_type=\"" << printable(systemType)
+           << "\" interface_version=0x" << std::hex << version << std::dec << "\n";
+      }
+      break;
+    case 0x80000001:
+    case 0x80000002:
+    case 0x80000009:
+      if(r.more()) {
+        os << "    system_id=\"" << printable(r.cstr()) << "\"\n";
+      }
+      break;
+    default:
+      break;
+  }
+
+  if(r.overran()) {
+    os << "    (body incomplete)\n";
+  }
+}
+
+//--------------------------------------------------------------------------------
+static void hexDump(const uint8_t *data, size_t length, std::ostream &os)
+{
+  for(size_t i = 0; i < length; i += 16) {
+    os << "    " << std::hex << std::setw(4) << std::setfill('0') << i << " ";
+    for(size_t j = i; j < i + 16 && j < length; ++j) {
+      os << " " << std::setw(2) << (unsigned)data[j];
+    }
+    os << std::dec << std::setfill(' ') << "\n";
+  }
+}
+
+//--------------------------------------------------------------------------------
+static std::string formatTime(int64_t epochNs)
+{
+  time_t    seconds = epochNs / 1000000000LL;
+  struct tm t;
+  char      buf[32];
+
+  gmtime_r(&seconds, &t);
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t);
+
+  std::ostringstream os;
+  os << buf << "." << std::setw(6) << std::setfill('0') << ((epochNs % 1000000000LL) / 1000) << "Z";
+  return os.str();
+}
+
+//--------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bpo::options_description desc("Options");
+  bpo::variables_map       vm;
+
+  desc.add_options()
+    ("help,h"   , "Print help messages")
+    ("hex,x"    , "Hex dump every PDU, as well as decoding it")
+    ("session,s", bpo::value<unsigned>(), "Only show PDUs of this session")
+    ("file,f"   , bpo::value<std::string>()->required(), "The trace file to decode");
+
+  bpo::positional_options_description positional;
+  positional.add("file", 1);
+
+  try {
+    bpo::store(bpo::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+    if(vm.count("help")) {
+      std::cout << "Usage: ksmppc-trace [options] <trace file>\n" << desc << std::endl;
+      return 0;
+    }
+
+    bpo::notify(vm);
+  } catch(bpo::error& e) {
+    std::cerr << "ERROR: " << e.what() << "\n" << desc << std::endl;
+    return 1;
+  }
+
+  std::string          fileName = vm["file"].as<std::string>();
+  std::ifstream        in(fileName.c_str(), std::ios::binary);
+  std::vector<uint8_t> ring((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if(ring.size() < sizeof(PduTraceRing::Header)) {
+    std::cerr << "ERROR: " << fileName << " is not a PDU trace file." << std::endl;
+    return 1;
+  }
+
+  // Aligned storage for the header and records, the vector's own buffer is only guaranteed to be byte aligned.
+  std::vector<uint64_t> aligned((ring.size() + 7) / 8);
+  memcpy(&aligned[0], &ring[0], ring.size());
+
+  uint8_t                    *base   = reinterpret_cast<uint8_t*>(&aligned[0]);
+  const PduTraceRing::Header *header = reinterpret_cast<const PduTraceRing::Header*>(base);
+
+  if(!PduTraceRing::validHeader(header) || ring.size() < PduTraceRing::ringSize(header)) {
+    std::cerr << "ERROR: " << fileName << " is not a PDU trace file, or it is truncated." << std::endl;
+    return 1;
+  }
+
+  uint64_t next  = header->next.load();
+  uint64_t first = (next > header->slotCount) ? next - header->slotCount : 0;
+
+  std::cout << (next - first) << " of " << next << " recorded PDUs are in the ring." << std::endl;
+
+  for(uint64_t n = first; n < next; ++n) {
+    PduTraceRing::SlotHeader *slot = PduTraceRing::slotAt(base, n);
+    const uint8_t            *pdu  = reinterpret_cast<const uint8_t*>(slot + 1);
+
+    if(slot->stamp.load() != n + 1) { // being written when the ring was copied, or overwritten since.
+      continue;
+    }
+
+    if(vm.count("session") && slot->sessionId != vm["session"].as<unsigned>()) {
+      continue;
+    }
+
+    BodyReader r(pdu, slot->captured);
+    uint32_t   length    = r.u32();
+    uint32_t   commandId = r.u32();
+    uint32_t   status    = r.u32();
+    uint32_t   sequence  = r.u32();
+
+    std::cout << formatTime(header->realtimeOffsetNs + (int64_t)slot->monotonicNs)
+              << " session " << slot->sessionId
+              << ((slot->direction == PduTraceRing::RX) ? " << " : " >> ")
+              << commandName(commandId)
+              << " seq="    << sequence
+              << " status=0x" << std::hex << status << std::dec
+              << " len="    << length;
+
+    if(slot->captured < slot->length) {
+      std::cout << " (" << slot->captured << " of " << slot->length << " bytes kept)";
+    }
+
+    std::cout << "\n";
+
+    decodeBody(commandId, r, std::cout);
+
+    if(vm.count("hex")) {
+      hexDump(pdu, slot->captured, std::cout);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,196 @@
+// File  : recording_session.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _RECORDING_SESSION_HPP_
+#define _RECORDING_SESSION_HPP_
+
+#include "session_dispatch.hpp"
+
+//--------------------------------------------------------------------------------
+// Stands in for SessionManager in SessionDispatch: it has the same states and
+// handlers, but every handler only records that it ran.
+//
+// process4state_switch() and send4state_switch() are the nested switches
+// SessionManager used before the dispatch tables, kept as the reference the
+// tables are checked, and benchmarked, against. Their "default: break" is
+// procpdu_unhandled here, as it is in the tables.
+class RecordingSession
+{
+  public:
+    enum State { OPEN, BOUND_TX, BOUND_RX, BOUND_TRX, UNBOUND, CLOSED, OUTBOUND }; // as SessionManager::State
+
+    typedef SessionDispatch<RecordingSession> Dispatch;
+
+    RecordingSession() : last(0), calls(0) {}
+
+    void process4state_table (State st, RawPdu &rawpdu) { (this->*Dispatch::inbound(st, rawpdu.cmd_id()))(rawpdu); }
+    void process4state       (State st, RawPdu &rawpdu) { Dispatch::dispatch(*this, st, rawpdu); } // as SessionManager does it.
+    bool send4state_table    (State st, uint32_t cmd)   { return Dispatch::outboundPermitted(st, cmd); }
+
+    void process4state_switch(State st, RawPdu &rawpdu);
+    bool send4state_switch   (State st, uint32_t cmd);
+
+    const char *last;  // the name of the handler that ran last, 0 if none did.
+    uint64_t    calls;
+
+#define RECORDING_HANDLER(NAME) void NAME(RawPdu &) { last = #NAME; ++calls; }
+    RECORDING_HANDLER(procpdu_unhandled)
+    RECORDING_HANDLER(procpdu_outbind)
+    RECORDING_HANDLER(procpdu_bind_receiver_resp)
+    RECORDING_HANDLER(procpdu_bind_transmitter_resp)
+    RECORDING_HANDLER(procpdu_bind_transceiver_resp)
+    RECORDING_HANDLER(procpdu_alert_notification)
+    RECORDING_HANDLER(procpdu_broadcast_sm_resp)
+    RECORDING_HANDLER(procpdu_cancel_broadcast_sm_resp)
+    RECORDING_HANDLER(procpdu_cancel_sm_resp)
+    RECORDING_HANDLER(procpdu_data_sm)
+    RECORDING_HANDLER(procpdu_data_sm_resp)
+    RECORDING_HANDLER(procpdu_deliver_sm)
+    RECORDING_HANDLER(procpdu_enquire_link)
+    RECORDING_HANDLER(procpdu_enquire_link_resp)
+    RECORDING_HANDLER(procpdu_generic_nack)
+    RECORDING_HANDLER(procpdu_query_broadcast_sm_resp)
+    RECORDING_HANDLER(procpdu_query_sm_resp)
+    RECORDING_HANDLER(procpdu_replace_sm_resp)
+    RECORDING_HANDLER(procpdu_submit_multi_resp)
+    RECORDING_HANDLER(procpdu_submit_sm_resp)
+    RECORDING_HANDLER(procpdu_unbind)
+    RECORDING_HANDLER(procpdu_unbind_resp)
+#undef RECORDING_HANDLER
+};
+
+//--------------------------------------------------------------------------------
+inline void RecordingSession::process4state_switch(State st, RawPdu &rawpdu)
+{
+  switch(st) {
+    case OPEN:
+      switch(rawpdu.cmd_id()) {
+        case smpp_pdu::CommandId::BindReceiverResp   : procpdu_bind_receiver_resp   (rawpdu); break;
+        case smpp_pdu::CommandId::BindTransmitterResp: procpdu_bind_transmitter_resp(rawpdu); break;
+        case smpp_pdu::CommandId::BindTransceiverResp: procpdu_bind_transceiver_resp(rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLink        : procpdu_enquire_link         (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLinkResp    : procpdu_enquire_link_resp    (rawpdu); break;
+        case smpp_pdu::CommandId::GenericNack        : procpdu_generic_nack         (rawpdu); break;
+        case smpp_pdu::CommandId::Outbind            : procpdu_outbind              (rawpdu); break;
+        default                                      : procpdu_unhandled            (rawpdu); break;
+      }
+      break;
+    case BOUND_TX:
+      switch(rawpdu.cmd_id()) {
+        case smpp_pdu::CommandId::BroadcastSmResp      : procpdu_broadcast_sm_resp       (rawpdu); break;
+        case smpp_pdu::CommandId::CancelBroadcastSmResp: procpdu_cancel_broadcast_sm_resp(rawpdu); break;
+        case smpp_pdu::CommandId::CancelSmResp         : procpdu_cancel_sm_resp          (rawpdu); break;
+        case smpp_pdu::CommandId::DataSmResp           : procpdu_data_sm_resp            (rawpdu); break;
+        case smpp_pdu::CommandId::QueryBroadcastSmResp : procpdu_query_broadcast_sm_resp (rawpdu); break;
+        case smpp_pdu::CommandId::QuerySmResp          : procpdu_query_sm_resp           (rawpdu); break;
+        case smpp_pdu::CommandId::ReplaceSmResp        : procpdu_replace_sm_resp         (rawpdu); break;
+        case smpp_pdu::CommandId::SubmitMultiResp      : procpdu_submit_multi_resp       (rawpdu); break;
+        case smpp_pdu::CommandId::SubmitSmResp         : procpdu_submit_sm_resp          (rawpdu); break;
+        case smpp_pdu::CommandId::Unbind               : procpdu_unbind                  (rawpdu); break;
+        case smpp_pdu::CommandId::UnbindResp           : procpdu_unbind_resp             (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLink          : procpdu_enquire_link            (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLinkResp      : procpdu_enquire_link_resp       (rawpdu); break;
+        case smpp_pdu::CommandId::GenericNack          : procpdu_generic_nack            (rawpdu); break;
+        default                                        : procpdu_unhandled               (rawpdu); break;
+      }
+      break;
+    case BOUND_RX:
+      switch(rawpdu.cmd_id()) {
+        case smpp_pdu::CommandId::AlertNotification: procpdu_alert_notification(rawpdu); break;
+        case smpp_pdu::CommandId::DataSm           : procpdu_data_sm           (rawpdu); break;
+        case smpp_pdu::CommandId::DeliverSm        : procpdu_deliver_sm        (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLink      : procpdu_enquire_link      (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLinkResp  : procpdu_enquire_link_resp (rawpdu); break;
+        case smpp_pdu::CommandId::GenericNack      : procpdu_generic_nack      (rawpdu); break;
+        case smpp_pdu::CommandId::Unbind           : procpdu_unbind            (rawpdu); break;
+        case smpp_pdu::CommandId::UnbindResp       : procpdu_unbind_resp       (rawpdu); break;
+        default                                    : procpdu_unhandled         (rawpdu); break;
+      }
+      break;
+    case BOUND_TRX:
+      switch(rawpdu.cmd_id()) {
+        case smpp_pdu::CommandId::AlertNotification    : procpdu_alert_notification      (rawpdu); break;
+        case smpp_pdu::CommandId::BroadcastSmResp      : procpdu_broadcast_sm_resp       (rawpdu); break;
+        case smpp_pdu::CommandId::CancelBroadcastSmResp: procpdu_cancel_broadcast_sm_resp(rawpdu); break;
+        case smpp_pdu::CommandId::CancelSmResp         : procpdu_cancel_sm_resp          (rawpdu); break;
+        case smpp_pdu::CommandId::DataSm               : procpdu_data_sm                 (rawpdu); break;
+        case smpp_pdu::CommandId::DataSmResp           : procpdu_data_sm_resp            (rawpdu); break;
+        case smpp_pdu::CommandId::DeliverSm            : procpdu_deliver_sm              (rawpdu); break;
+        case smpp_pdu::CommandId::QueryBroadcastSmResp : procpdu_query_broadcast_sm_resp (rawpdu); break;
+        case smpp_pdu::CommandId::QuerySmResp          : procpdu_query_sm_resp           (rawpdu); break;
+        case smpp_pdu::CommandId::ReplaceSmResp        : procpdu_replace_sm_resp         (rawpdu); break;
+        case smpp_pdu::CommandId::SubmitMultiResp      : procpdu_submit_multi_resp       (rawpdu); break;
+        case smpp_pdu::CommandId::SubmitSmResp         : procpdu_submit_sm_resp          (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLink          : procpdu_enquire_link            (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLinkResp      : procpdu_enquire_link_resp       (rawpdu); break;
+        case smpp_pdu::CommandId::GenericNack          : procpdu_generic_nack            (rawpdu); break;
+        case smpp_pdu::CommandId::Unbind               : procpdu_unbind                  (rawpdu); break;
+        case smpp_pdu::CommandId::UnbindResp           : procpdu_unbind_resp             (rawpdu); break;
+        default                                        : procpdu_unhandled               (rawpdu); break;
+      }
+      break;
+    case UNBOUND:
+      switch(rawpdu.cmd_id()) {
+        case smpp_pdu::CommandId::EnquireLink    : procpdu_enquire_link     (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLinkResp: procpdu_enquire_link_resp(rawpdu); break;
+        case smpp_pdu::CommandId::GenericNack    : procpdu_generic_nack     (rawpdu); break;
+        default                                  : procpdu_unhandled        (rawpdu); break;
+      }
+      break;
+    case CLOSED:
+      procpdu_unhandled(rawpdu);
+      break;
+    case OUTBOUND:
+      switch(rawpdu.cmd_id()) {
+        case smpp_pdu::CommandId::BindReceiverResp   : procpdu_bind_receiver_resp   (rawpdu); break;
+        case smpp_pdu::CommandId::BindTransmitterResp: procpdu_bind_transmitter_resp(rawpdu); break;
+        case smpp_pdu::CommandId::BindTransceiverResp: procpdu_bind_transceiver_resp(rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLink        : procpdu_enquire_link         (rawpdu); break;
+        case smpp_pdu::CommandId::EnquireLinkResp    : procpdu_enquire_link_resp    (rawpdu); break;
+        case smpp_pdu::CommandId::GenericNack        : procpdu_generic_nack         (rawpdu); break;
+        default                                      : procpdu_unhandled            (rawpdu); break;
+      }
+      break;
+  }
+}
+
+//--------------------------------------------------------------------------------
+inline bool RecordingSession::send4state_switch(State st, uint32_t cmd)
+{
+  bool tx = (st == BOUND_TX || st == BOUND_TRX);
+  bool rx = (st == BOUND_RX || st == BOUND_TRX);
+
+  switch(cmd) {
+    case smpp_pdu::CommandId::BroadcastSm      :
+    case smpp_pdu::CommandId::CancelBroadcastSm:
+    case smpp_pdu::CommandId::CancelSm         :
+    case smpp_pdu::CommandId::DataSm           :
+    case smpp_pdu::CommandId::QueryBroadcastSm :
+    case smpp_pdu::CommandId::QuerySm          :
+    case smpp_pdu::CommandId::ReplaceSm        :
+    case smpp_pdu::CommandId::SubmitMulti      :
+    case smpp_pdu::CommandId::SubmitSm         : return tx;
+    case smpp_pdu::CommandId::DataSmResp       :
+    case smpp_pdu::CommandId::DeliverSmResp    : return rx;
+    default                                    : return false;
+  }
+}
+
+#endif // _RECORDING_SESSION_HPP_
@@ -39,18 +39,44 @@ class TransmitQ : public PrioritisedSmppPduQ
       PrioritisedSmppPduQ(queueName,
                           queueWorkingDir,
                           PRIORITY_LEVELS,
-                          maxItemsPerPage)
+                          maxItemsPerPage),
+      sessionTraffic     (0)
     {
       // session management and response PDU's are not transferable between sessions
       clearSessionQueues();
     }
 
+    void push(const boost::shared_ptr<smpp_pdu::SMPP_PDU> pdu, const unsigned priority)
+    {
+      if(priority < TransmitQ::MESSAGE) {
+        ++sessionTraffic;
+      }
+      PrioritisedSmppPduQ::push(pdu, priority);
+    }
+
+    boost::shared_ptr<smpp_pdu::SMPP_PDU> pop()
+    {
+      // Higher priorities are always popped first, so while there is session or
+      // response traffic queued, the item being popped is one of those.
+      if(sessionTraffic > 0) {
+        --sessionTraffic;
+      }
+      return PrioritisedSmppPduQ::pop();
+    }
+
+    // Session and response PDU's are not subject to the transmit window.
+    bool sessionTrafficPending() { return (sessionTraffic > 0); }
+
     void clearSessionQueues()
     {
       clear(TransmitQ::SESSION);
       clear(TransmitQ::RESPONSE);
+      sessionTraffic = 0;
     }
 
+  private:
+    unsigned sessionTraffic; // number of SESSION and RESPONSE items currently queued.
+
 };
 
 typedef boost::scoped_ptr<TransmitQ> ScopedTransmitQ;
@@ -0,0 +1,52 @@
+// File  : check.hpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _CHECK_HPP_
+#define _CHECK_HPP_
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------
+// What the programs under test/ share. Each is one translation unit: it CHECKs
+// as it goes, and main() ends with "return check::result("what was tested");",
+// which gives make check its exit status.
+namespace check {
+  inline int &failures()
+  {
+    static int count = 0;
+    return count;
+  }
+
+  inline int result(const char *what)
+  {
+    if(failures()) {
+      std::cerr << failures() << " check(s) failed." << std::endl;
+      return 1;
+    }
+
+    std::cout << what << ": ok" << std::endl;
+    return 0;
+  }
+}
+
+// Counts, and reports, a failed check, then carries on with the next one.
+#define CHECK(COND, WHAT) do { if(!(COND)) { ++check::failures(); std::cerr << "FAIL: " << WHAT << std::endl; } } while(0)
+
+#endif // _CHECK_HPP_
@@ -0,0 +1,251 @@
+// File  : json_cursor_test.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// Checks JsonCursor, the reader SubmitSmBuilder::build() uses for send
+// requests: escapes, surrogate pairs, skipped objects and arrays, trailing
+// characters, and input it has to reject. Where the input is valid, strings
+// must come out as read_json() gives them.
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "json_cursor.hpp"
+#include "check.hpp"
+
+typedef std::map<std::string, std::string> Fields;
+
+//--------------------------------------------------------------------------------
+// One request object, read the way SubmitSmBuilder::build() reads it.
+static Fields parse(const std::string &json)
+{
+  JsonCursor  cursor(json.data(), json.size());
+  Fields      fields;
+  std::string key;
+  std::string value;
+
+  cursor.expect('{');
+
+  if(!cursor.next('}')) {
+    do {
+      cursor.string(key);
+      cursor.expect(':');
+      cursor.value (value);
+      fields[key] = value;
+    } while(cursor.next(','));
+
+    cursor.expect('}');
+  }
+
+  if(!cursor.atEnd()) {
+    throw std::invalid_argument("Invalid JSON: trailing characters after the request");
+  }
+
+  return fields;
+}
+
+static std::string printable(const std::string &s)
+{
+  std::ostringstream out;
+
+  for(std::string::const_iterator i = s.begin(); i != s.end(); ++i) {
+    if(*i >= 0x20 && *i < 0x7F) {
+      out << *i;
+    } else {
+      out << "\\x" << std::hex << (unsigned)(unsigned char)*i << std::dec;
+    }
+  }
+
+  return out.str();
+}
+
+//--------------------------------------------------------------------------------
+static void accepts(const std::string &json, const Fields &expected)
+{
+  try {
+    Fields got = parse(json);
+    CHECK(got == expected, "wrong fields from " << printable(json));
+  } catch(std::invalid_argument &e) {
+    CHECK(false, "rejected " << printable(json) << ": " << e.what());
+  }
+}
+
+static void rejects(const std::string &json)
+{
+  try {
+    parse(json);
+    CHECK(false, "accepted " << printable(json));
+  } catch(std::invalid_argument &) {
+  }
+}
+
+// A single string value, checked against what it should be and against read_json().
+static void string(const std::string &literal, const std::string &expected)
+{
+  std::string json = "{\"m\":" + literal + "}";
+  Fields      fields;
+
+  fields["m"] = expected;
+  accepts(json, fields);
+
+  boost::property_tree::ptree pt;
+  std::istringstream          in(json);
+
+  boost::property_tree::read_json(in, pt);
+  CHECK(pt.get<std::string>("m") == expected, "read_json() gives " << printable(pt.get<std::string>("m")) << " for " << literal);
+}
+
+static Fields one(const std::string &key, const std::string &value)
+{
+  Fields fields;
+  fields[key] = value;
+  return fields;
+}
+
+//--------------------------------------------------------------------------------
+static void escapes()
+{
+  string("\"plain\""                     , "plain");
+  string("\"\""                          , "");
+  string("\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"", "\"\\/\b\f\n\r\t");
+  string("\"a\\nb\\tc\""                 , "a\nb\tc");
+  string("\"\\u0041\\u0062\""            , "Ab");
+  string("\"\\u00e9\\u00E9\""            , "\xC3\xA9\xC3\xA9");
+  string("\"\\u20ac\""                   , "\xE2\x82\xAC");
+  string("\"\\u0000x\""                  , std::string("\0x", 2));
+  string("\"caf\xC3\xA9\""               , "caf\xC3\xA9"); // UTF-8 in, as is.
+
+  rejects("{\"m\":\"\\x41\"}");
+  rejects("{\"m\":\"\\u12G4\"}");
+  rejects("{\"m\":\"\\u12\"}");
+  rejects("{\"m\":\"\\u12");
+  rejects("{\"m\":\"ab\\");
+}
+
+//--------------------------------------------------------------------------------
+static void surrogatePairs()
+{
+  string("\"\\ud83d\\ude00\""       , "\xF0\x9F\x98\x80");
+  string("\"\\uD800\\uDC00\""       , "\xF0\x90\x80\x80");
+  string("\"\\uDBFF\\uDFFF\""       , "\xF4\x8F\xBF\xBF");
+  string("\"x\\ud83d\\ude00y\""     , "x\xF0\x9F\x98\x80y");
+
+  rejects("{\"m\":\"\\ud83d\"}");        // high surrogate on its own,
+  rejects("{\"m\":\"\\ud83dx\"}");       // followed by something else,
+  rejects("{\"m\":\"\\ud83d\\n\"}");     // by another escape,
+  rejects("{\"m\":\"\\ud83d\\u0041\"}"); // by a code point that is no low surrogate,
+  rejects("{\"m\":\"\\ud83d\\ud83d\"}"); // or by another high surrogate.
+  rejects("{\"m\":\"\\ude00\"}");        // A low surrogate on its own.
+  rejects("{\"m\":\"\\ud83d\\ude0");
+}
+
+//--------------------------------------------------------------------------------
+static void nestedValues()
+{
+  Fields fields;
+
+  fields["a"] = "";
+  fields["d"] = "x";
+
+  accepts("{\"a\":{\"b\":[1,{\"c\":\"]}\"}]},\"d\":\"x\"}", fields);
+  accepts("{\"a\":[],\"d\":\"x\"}"                       , fields);
+  accepts("{\"a\":{},\"d\":\"x\"}"                       , fields);
+  accepts("{\"a\":[[[[\"\\\"]\"]]]],\"d\":\"x\"}"        , fields); // an escaped quote, then a bracket, in a string.
+  accepts("{ \"a\" : [ 1 , 2 ] , \"d\" : \"x\" }"        , fields);
+
+  rejects("{\"a\":[1,2}");
+  rejects("{\"a\":{\"b\":1]}");
+  rejects("{\"a\":[{]}");
+  rejects("{\"a\":[1,2");
+  rejects("{\"a\":{\"b\":\"}");
+}
+
+//--------------------------------------------------------------------------------
+static void literals()
+{
+  accepts("{\"a\":true}"    , one("a", "true"));
+  accepts("{\"a\":false}"   , one("a", "false"));
+  accepts("{\"a\":null}"    , one("a", ""));
+  accepts("{\"a\":0}"       , one("a", "0"));
+  accepts("{\"a\":-12}"     , one("a", "-12"));
+  accepts("{\"a\":1.5e+3}"  , one("a", "1.5e+3"));
+  accepts("{\"a\":2E-2 }"   , one("a", "2E-2"));
+  accepts("{}"              , Fields());
+  accepts(" \r\n\t{ } \n"   , Fields());
+
+  rejects("{\"a\":tru}");
+  rejects("{\"a\":nulls}");
+  rejects("{\"a\":abc}");
+  rejects("{\"a\":01}");
+  rejects("{\"a\":1.}");
+  rejects("{\"a\":.5}");
+  rejects("{\"a\":-}");
+  rejects("{\"a\":1e}");
+  rejects("{\"a\":+1}");
+}
+
+//--------------------------------------------------------------------------------
+static void trailingCharacters()
+{
+  accepts("{\"a\":\"b\"}   \n", one("a", "b"));
+
+  rejects("{\"a\":\"b\"}x");
+  rejects("{\"a\":\"b\"} {}");
+  rejects("{\"a\":\"b\"}}");
+  rejects("{\"a\":\"b\"},");
+}
+
+//--------------------------------------------------------------------------------
+static void malformed()
+{
+  rejects("");
+  rejects("   ");
+  rejects("{");
+  rejects("[]");
+  rejects("\"a\"");
+  rejects("{\"a\"}");
+  rejects("{\"a\":}");
+  rejects("{\"a\"  \"b\"}");
+  rejects("{\"a\":\"b\",}");
+  rejects("{\"a\":\"b\" \"c\":\"d\"}");
+  rejects("{,\"a\":\"b\"}");
+  rejects("{a:\"b\"}");
+  rejects("{'a':'b'}");
+  rejects("{\"a\":\"b");
+  rejects("{\"a\":\"b\"");
+  rejects("{\"a\":\"b\",\"c\"");
+}
+
+//--------------------------------------------------------------------------------
+int main()
+{
+  escapes();
+  surrogatePairs();
+  nestedValues();
+  literals();
+  trailingCharacters();
+  malformed();
+
+  return check::result("json cursor");
+}
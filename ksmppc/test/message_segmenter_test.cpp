@@ -0,0 +1,324 @@
+// File  : message_segmenter_test.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+
+// Checks MessageSegmenter at each of its limits: GSM 7 bit septet costs, with
+// extension characters, pre-encoded escapes and the euro sign; the part sizes
+// for 8 and 16 bit references; surrogate pairs; the 254 octet cap; max-parts;
+// and the UDH layout. Every UDH is read back with concatInfo(), which is
+// checked on UDHs of its own too.
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "message_segmenter.hpp"
+#include "check.hpp"
+
+typedef std::vector<SharedPduSubmitSm> Parts;
+typedef std::vector<size_t>            Sizes;
+
+static const std::string destination("27831234567");
+
+//--------------------------------------------------------------------------------
+static std::string repeat(const std::string &unit, size_t count)
+{
+  std::string s;
+
+  for(size_t i = 0; i < count; ++i) {
+    s += unit;
+  }
+
+  return s;
+}
+
+static std::string gsm  (size_t septets) { return std::string(septets, 'a');                }
+static std::string euros(size_t count  ) { return repeat("\xE2\x82\xAC", count);             }
+static std::string ucs2 (size_t count  ) { return repeat(std::string("\x00\x41", 2), count); }
+
+static Sizes sizes(size_t a, size_t b = 0, size_t c = 0)
+{
+  Sizes s;
+
+  if(a) { s.push_back(a); }
+  if(b) { s.push_back(b); }
+  if(c) { s.push_back(c); }
+
+  return s;
+}
+
+//--------------------------------------------------------------------------------
+static Parts split(const MessageSegmenter &segmenter, uint8_t dataCoding, const std::string &text, uint8_t esmClass = 0)
+{
+  smpp_pdu::PDU_submit_sm base;
+  Parts                   parts;
+
+  segmenter.segment(base, esmClass, dataCoding, destination, text, parts);
+
+  return parts;
+}
+
+// The text of each part, without its UDH. Every part of a split message must
+// have a concatenation UDH, with the same reference, the right total and its
+// own sequence number. A message that was not split, must have none.
+static std::vector<std::string> pieces(const Parts &parts, const std::string &what)
+{
+  std::vector<std::string> out;
+  ConcatInfo               first;
+
+  for(size_t i = 0; i < parts.size(); ++i) {
+    std::string sm = (std::string)parts[i]->short_message;
+    ConcatInfo  info;
+    bool        concatenated = concatInfo(parts[i], info);
+
+    if(parts.size() == 1) {
+      CHECK(!concatenated, what << ": a single part has a concatenation UDH");
+      out.push_back(sm);
+      continue;
+    }
+
+    CHECK(concatenated, what << ": part " << i + 1 << " has no concatenation UDH");
+    if(!concatenated) {
+      continue;
+    }
+
+    if(i == 0) {
+      first = info;
+    }
+
+    CHECK(info.total == parts.size(), what << ": part " << i + 1 << " says " << (unsigned)info.total << " parts, of " << parts.size());
+    CHECK(info.sequence == i + 1, what << ": part " << i + 1 << " has sequence number " << (unsigned)info.sequence);
+    CHECK(info.reference == first.reference, what << ": part " << i + 1 << " has another reference than part 1");
+
+    out.push_back(sm.substr(1 + (uint8_t)sm[0]));
+  }
+
+  return out;
+}
+
+// Splits text, and checks the octets in each part, and that the parts make up text again.
+static std::vector<std::string> expect(const MessageSegmenter &segmenter, uint8_t dataCoding, const std::string &text, const Sizes &expected, const std::string &what)
+{
+  std::vector<std::string> got;
+
+  try {
+    got = pieces(split(segmenter, dataCoding, text), what);
+  } catch(std::invalid_argument &e) {
+    CHECK(false, what << ": rejected: " << e.what());
+    return got;
+  }
+
+  Sizes       lengths;
+  std::string joined;
+
+  for(size_t i = 0; i < got.size(); ++i) {
+    lengths.push_back(got[i].size());
+    joined += got[i];
+  }
+
+  std::ostringstream gotSizes;
+
+  for(size_t i = 0; i < lengths.size(); ++i) {
+    gotSizes << (i ? "+" : "") << lengths[i];
+  }
+
+  CHECK(lengths == expected, what << ": parts of " << gotSizes.str() << " octets");
+  CHECK(joined == text, what << ": the parts do not make up the text");
+
+  return got;
+}
+
+static void rejects(const MessageSegmenter &segmenter, uint8_t dataCoding, const std::string &text, const std::string &what, uint8_t esmClass = 0)
+{
+  try {
+    split(segmenter, dataCoding, text, esmClass);
+    CHECK(false, what << ": accepted");
+  } catch(std::invalid_argument &) {
+  }
+}
+
+//--------------------------------------------------------------------------------
+static void gsm7()
+{
+  MessageSegmenter s8(8, 16);
+  MessageSegmenter s16(16, 16);
+
+  expect(s8 , 0   , gsm(160), sizes(160)        , "gsm 160");
+  expect(s8 , 0   , gsm(161), sizes(153, 8)     , "gsm 161");
+  expect(s16, 0   , gsm(161), sizes(152, 9)     , "gsm 161, 16 bit");
+  expect(s8 , 0   , gsm(306), sizes(153, 153)   , "gsm 306");
+  expect(s8 , 0   , gsm(307), sizes(153, 153, 1), "gsm 307");
+  expect(s8 , 1   , gsm(161), sizes(153, 8)     , "ia5 161");
+  expect(s8 , 0xF0, gsm(161), sizes(153, 8)     , "gsm 161, message class");
+
+  // Extension table characters take two septets, and never straddle two parts.
+  expect(s8, 0, repeat("{", 80), sizes(80)    , "80 braces");
+  expect(s8, 0, repeat("{", 81), sizes(76, 5) , "81 braces");
+
+  std::vector<std::string> got = expect(s8, 0, gsm(152) + "{" + gsm(10), sizes(152, 11), "a brace at septet 153");
+  CHECK(got.size() == 2 && got[1][0] == '{', "a brace at septet 153 is not moved to part 2");
+
+  expect(s8, 0, gsm(151) + "{" + gsm(10), sizes(152, 10), "a brace at septets 152 and 153");
+
+  // So does an escape the caller already encoded.
+  expect(s8, 0, repeat("\x1B\x65", 80), sizes(160)    , "80 escapes");
+  expect(s8, 0, repeat("\x1B\x65", 81), sizes(152, 10), "81 escapes");
+
+  got = expect(s8, 0, gsm(152) + "\x1B\x65" + gsm(10), sizes(152, 12), "an escape at septet 153");
+  CHECK(got.size() == 2 && got[1][0] == '\x1B', "an escape at septet 153 is split");
+
+  // The euro sign is three octets of UTF-8, and two septets.
+  expect(s8, 0, euros(80), sizes(240)     , "80 euro signs");
+  expect(s8, 0, euros(81), sizes(228, 15) , "81 euro signs");
+}
+
+//--------------------------------------------------------------------------------
+static void ucs2Parts()
+{
+  MessageSegmenter s8(8, 16);
+  MessageSegmenter s16(16, 16);
+  std::string      pair("\xD8\x3D\xDE\x00", 4);
+
+  expect(s8 , 8, ucs2(70), sizes(140)    , "ucs2 70");
+  expect(s8 , 8, ucs2(71), sizes(134, 8) , "ucs2 71");
+  expect(s16, 8, ucs2(71), sizes(132, 10), "ucs2 71, 16 bit");
+
+  expect(s8 , 8, ucs2(65) + pair + ucs2(5), sizes(134, 10), "a surrogate pair that fits");
+
+  std::vector<std::string> got = expect(s8, 8, ucs2(66) + pair + ucs2(5), sizes(132, 14), "a surrogate pair at octet 133");
+  CHECK(got.size() == 2 && got[1].compare(0, 4, pair) == 0, "a surrogate pair at octet 133 is split");
+
+  expect(s16, 8, ucs2(65) + pair + ucs2(5), sizes(130, 14), "a surrogate pair at octet 131, 16 bit");
+
+  rejects(s8, 8, std::string("\x00\x41\x00", 3), "ucs2 of 3 octets");
+}
+
+//--------------------------------------------------------------------------------
+static void octetParts()
+{
+  MessageSegmenter s8(8, 16);
+  MessageSegmenter s16(16, 16);
+
+  expect(s8 , 4   , std::string(140, 'x'), sizes(140)   , "octets 140");
+  expect(s8 , 4   , std::string(141, 'x'), sizes(134, 7), "octets 141");
+  expect(s16, 4   , std::string(141, 'x'), sizes(133, 8), "octets 141, 16 bit");
+  expect(s8 , 0xF4, std::string(141, 'x'), sizes(134, 7), "octets 141, message class");
+}
+
+//--------------------------------------------------------------------------------
+// UTF-8 that the message centre converts, costs one septet per character, but
+// the octets still have to fit sm_length.
+static void octetCap()
+{
+  MessageSegmenter s8(8, 16);
+  MessageSegmenter s16(16, 16);
+  std::string      e("\xC3\xA9");
+
+  expect(s8 , 0, repeat(e, 127), sizes(254)    , "127 two octet characters");
+  expect(s8 , 0, repeat(e, 128), sizes(248, 8) , "128 two octet characters");
+  expect(s16, 0, repeat(e, 128), sizes(246, 10), "128 two octet characters, 16 bit");
+  expect(s8 , 0, repeat(e, 160), sizes(248, 72), "160 two octet characters");
+
+  // With a UDH of the caller's own, the message goes as it is, or not at all.
+  Parts parts = split(s8, 0, std::string(254, 'a'), 0x40);
+  CHECK(parts.size() == 1 && ((std::string)parts[0]->short_message).size() == 254, "a caller's UDH of 254 octets is not sent as it is");
+
+  rejects(s8, 0, std::string(255, 'a'), "a caller's UDH of 255 octets", 0x40);
+}
+
+//--------------------------------------------------------------------------------
+static void maxParts()
+{
+  MessageSegmenter s3(8, 3);
+
+  expect(s3, 0, gsm(459), sizes(153, 153, 153), "3 parts allowed, 3 needed");
+  rejects(s3, 0, gsm(460), "3 parts allowed, 4 needed");
+}
+
+//--------------------------------------------------------------------------------
+static void udhLayout()
+{
+  MessageSegmenter s8(8, 16);
+  MessageSegmenter s16(16, 16);
+  ConcatInfo       info;
+  ConcatInfo       next;
+
+  Parts       parts = split(s8, 0, gsm(161), 0x03);
+  std::string sm    = (std::string)parts[0]->short_message;
+
+  CHECK(parts[0]->esm_class.bits_set(0x43), "8 bit: esm_class lost UDHI, or the caller's bits");
+  CHECK(sm.compare(0, 3, std::string("\x05\x00\x03", 3)) == 0, "8 bit: UDH does not start with 05 00 03");
+  CHECK(sm[4] == 2 && sm[5] == 1, "8 bit: UDH has the wrong total or sequence");
+  CHECK(concatInfo(parts[0], info) && info.reference == (uint8_t)sm[3], "8 bit: concatInfo() reads the wrong reference");
+
+  CHECK(concatInfo(split(s8, 0, gsm(161))[0], next) && next.reference == ((info.reference + 1) & 0xFF),
+        "8 bit: the next message to the destination does not get the next reference");
+
+  parts = split(s16, 0, gsm(161));
+  sm    = (std::string)parts[1]->short_message;
+
+  CHECK(sm.compare(0, 3, std::string("\x06\x08\x04", 3)) == 0, "16 bit: UDH does not start with 06 08 04");
+  CHECK(sm[5] == 2 && sm[6] == 2, "16 bit: UDH has the wrong total or sequence");
+  CHECK(concatInfo(parts[1], info) && info.reference == (((uint8_t)sm[3] << 8) | (uint8_t)sm[4]), "16 bit: concatInfo() reads the wrong reference");
+}
+
+//--------------------------------------------------------------------------------
+static SharedPduSubmitSm withUdh(const std::string &sm, uint8_t esmClass = 0x40)
+{
+  SharedPduSubmitSm pdu(new smpp_pdu::PDU_submit_sm());
+
+  pdu->esm_class     = esmClass;
+  pdu->short_message = sm;
+
+  return pdu;
+}
+
+static void concatInfoParsing()
+{
+  ConcatInfo info;
+
+  // A concatenation element after another one.
+  CHECK(concatInfo(withUdh(std::string("\x08\x24\x01\x00\x00\x03\x12\x03\x02text", 13)), info) &&
+        info.reference == 0x12 && info.total == 3 && info.sequence == 2, "concatInfo(): misreads an element after another one");
+
+  CHECK(!concatInfo(withUdh(std::string("\x03\x24\x01\x00text", 8)), info), "concatInfo(): no concatenation element");
+  CHECK(!concatInfo(withUdh(std::string("\x05\x00\x03\x12", 4)), info), "concatInfo(): UDH longer than short_message");
+  CHECK(!concatInfo(withUdh(std::string("\x05\x00\x05\x12\x03\x01", 6)), info), "concatInfo(): element longer than the UDH");
+  CHECK(!concatInfo(withUdh(std::string("\x05\x00\x03\x12\x00\x01", 6)), info), "concatInfo(): a total of 0 parts");
+  CHECK(!concatInfo(withUdh(std::string("\x05\x00\x03\x12\x03\x01", 6), 0x00), info), "concatInfo(): UDHI not set");
+  CHECK(!concatInfo(withUdh(std::string()), info), "concatInfo(): empty short_message");
+  CHECK(!concatInfo(SharedPduDeliverSm(new smpp_pdu::PDU_deliver_sm()), info), "concatInfo(): not a submit_sm");
+}
+
+//--------------------------------------------------------------------------------
+int main()
+{
+  gsm7();
+  ucs2Parts();
+  octetParts();
+  octetCap();
+  maxParts();
+  udhLayout();
+  concatInfoParsing();
+
+  return check::result("message segmenter");
+}
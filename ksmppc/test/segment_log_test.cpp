@@ -0,0 +1,495 @@
+// File  : segment_log_test.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// What SegmentLog recovers on start-up, after a clean shutdown and after the
+// damage a crash can leave behind: a torn record, a bad checksum, and pending
+// records behind popped ones. And records popped with a ticket, that must
+// come back after a restart until they are done().
+//
+// Then the durable commit path: appenders that share one sync, and a failed
+// sync, after which the records it covered must be gone, and the log takes no
+// more. fdatasync() is replaced below, to count the syncs and to fail them.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "segment_log.hpp"
+#include "check.hpp"
+
+//--------------------------------------------------------------------------------
+// The on-disk layout, as segment_log.cpp writes it.
+static const off_t    segmentHeader = 64;
+static const off_t    recordHeader  = 12; // length, state, checksum.
+static const uint32_t RECORD_POPPED = 0x454e4f44; // "DONE"
+static const size_t   segmentSize   = 64 * 1024;
+
+static std::string    dir;
+
+//--------------------------------------------------------------------------------
+// SegmentLog's commits come here, rather than to the C library.
+static boost::mutex   syncMutex;
+static unsigned       syncCalls = 0;
+static bool           syncFails = false;
+
+extern "C" int fdatasync(int fd)
+{
+  boost::mutex::scoped_lock lock(syncMutex);
+
+  ++syncCalls;
+
+  if(syncFails) {
+    errno = EIO;
+    return -1;
+  }
+
+  return syscall(SYS_fdatasync, fd);
+}
+
+static unsigned syncs()
+{
+  boost::mutex::scoped_lock lock(syncMutex);
+  return syncCalls;
+}
+
+static off_t recordOffset(const std::vector<std::string> &records, size_t index) // in the first segment.
+{
+  off_t pos = segmentHeader;
+
+  for(size_t i = 0; i < index; ++i) {
+    pos += recordHeader + ((records[i].size() + 3) & ~3U);
+  }
+
+  return pos;
+}
+
+static std::string firstSegment()
+{
+  return dir + "/q.0000000000000000.seg";
+}
+
+static uint32_t readWord(off_t pos)
+{
+  uint32_t v  = 0;
+  int      fd = open(firstSegment().c_str(), O_RDONLY);
+
+  if(fd >= 0) {
+    if(pread(fd, &v, sizeof(v), pos) != sizeof(v)) {
+      v = 0;
+    }
+    close(fd);
+  }
+
+  return v;
+}
+
+static void writeBytes(off_t pos, const void *data, size_t length)
+{
+  int fd = open(firstSegment().c_str(), O_WRONLY);
+
+  if(fd < 0 || pwrite(fd, data, length, pos) != (ssize_t)length) {
+    std::cerr << "Could not damage " << firstSegment() << std::endl;
+    exit(2);
+  }
+
+  close(fd);
+}
+
+//--------------------------------------------------------------------------------
+static void clean()
+{
+  DIR *d = opendir(dir.c_str());
+
+  for(struct dirent *e = d ? readdir(d) : NULL; e; e = readdir(d)) {
+    if(e->d_name[0] != '.') {
+      unlink((dir + "/" + e->d_name).c_str());
+    }
+  }
+
+  if(d) {
+    closedir(d);
+  }
+}
+
+static std::vector<std::string> fill(unsigned n)
+{
+  std::vector<std::string> records;
+
+  for(unsigned i = 0; i < n; ++i) {
+    records.push_back(std::string("record ") + (char)('A' + i) + std::string(i * 3, '.')); // uneven lengths, so the padding is used.
+  }
+
+  SegmentLog log("q", dir, segmentSize);
+
+  for(unsigned i = 0; i < n; ++i) {
+    log.append(records[i].data(), records[i].size());
+  }
+
+  return records;
+}
+
+static std::vector<std::string> drain(SegmentLog &log)
+{
+  std::vector<std::string> out;
+  std::string              record;
+
+  while(log.pop(record)) {
+    out.push_back(record);
+  }
+
+  return out;
+}
+
+static bool same(const std::vector<std::string> &got, const std::vector<std::string> &records, size_t from, size_t to)
+{
+  return got == std::vector<std::string>(records.begin() + from, records.begin() + to);
+}
+
+//--------------------------------------------------------------------------------
+static void cleanRestart()
+{
+  clean();
+  std::vector<std::string> records = fill(4);
+
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 4, "clean restart: " << log.size() << " records instead of 4");
+  CHECK(same(drain(log), records, 0, 4), "clean restart: records differ");
+}
+
+//--------------------------------------------------------------------------------
+static void pendingAfterPopped()
+{
+  clean();
+  std::vector<std::string> records = fill(5);
+
+  {
+    SegmentLog  log("q", dir, segmentSize);
+    std::string record;
+    log.pop(record);
+    log.pop(record);
+  }
+
+  CHECK(readWord(recordOffset(records, 0) + 4) == RECORD_POPPED, "popped: the first record is not marked DONE");
+  CHECK(readWord(recordOffset(records, 1) + 4) == RECORD_POPPED, "popped: the second record is not marked DONE");
+
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 3, "popped: " << log.size() << " records instead of 3");
+  CHECK(same(drain(log), records, 2, 5), "popped: records differ");
+
+  std::string extra("after recovery");
+  log.append(extra.data(), extra.size());
+  std::vector<std::string> got = drain(log);
+  CHECK(got.size() == 1 && got[0] == extra, "popped: a record appended after recovery does not come back");
+}
+
+//--------------------------------------------------------------------------------
+static void tornRecord()
+{
+  clean();
+  std::vector<std::string> records = fill(4);
+
+  // The last record's bytes only partly reached the disk.
+  writeBytes(recordOffset(records, 3) + recordHeader + 2, "XX", 2);
+
+  {
+    SegmentLog log("q", dir, segmentSize);
+    CHECK(log.size() == 3, "torn: " << log.size() << " records instead of 3");
+
+    std::string extra("written over the torn one");
+    log.append(extra.data(), extra.size());
+
+    std::vector<std::string> got = drain(log);
+    std::vector<std::string> expected(records.begin(), records.begin() + 3);
+    expected.push_back(extra);
+    CHECK(got == expected, "torn: records differ, or the torn record was not overwritten");
+  }
+
+  // And the record written in its place survives the next restart, with nothing of the torn one.
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 0, "torn: " << log.size() << " records left after popping them all");
+}
+
+//--------------------------------------------------------------------------------
+static void tornLength()
+{
+  clean();
+  std::vector<std::string> records = fill(3);
+
+  // A length word that runs past the end of the segment.
+  uint32_t huge = segmentSize;
+  writeBytes(recordOffset(records, 2), &huge, sizeof(huge));
+
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 2, "length: " << log.size() << " records instead of 2");
+  CHECK(same(drain(log), records, 0, 2), "length: records differ");
+}
+
+//--------------------------------------------------------------------------------
+static void badChecksum()
+{
+  clean();
+  std::vector<std::string> records = fill(4);
+
+  // A record in the middle no longer matches its checksum. It, and everything after it, is gone.
+  uint32_t bad = ~readWord(recordOffset(records, 1) + 8);
+  writeBytes(recordOffset(records, 1) + 8, &bad, sizeof(bad));
+
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 1, "checksum: " << log.size() << " records instead of 1");
+  CHECK(same(drain(log), records, 0, 1), "checksum: records differ");
+}
+
+//--------------------------------------------------------------------------------
+static void badState()
+{
+  clean();
+  std::vector<std::string> records = fill(3);
+
+  uint32_t bad = 0x12345678;
+  writeBytes(recordOffset(records, 2) + 4, &bad, sizeof(bad));
+
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 2, "state: " << log.size() << " records instead of 2");
+  CHECK(same(drain(log), records, 0, 2), "state: records differ");
+}
+
+//--------------------------------------------------------------------------------
+static void acrossSegments()
+{
+  clean();
+
+  std::vector<std::string> records;
+  {
+    SegmentLog log("q", dir, segmentSize);
+
+    for(unsigned i = 0; i < 300; ++i) { // about 1k each, so several segments.
+      records.push_back(std::string(1000 + i, (char)('a' + i % 26)));
+      log.append(records.back().data(), records.back().size());
+    }
+
+    CHECK(log.segmentCount() > 2, "segments: only " << log.segmentCount() << " segment(s) used");
+
+    std::string record;
+    for(unsigned i = 0; i < 100; ++i) {
+      log.pop(record);
+    }
+  }
+
+  SegmentLog log("q", dir, segmentSize);
+  CHECK(log.size() == 200, "segments: " << log.size() << " records instead of 200");
+  CHECK(same(drain(log), records, 100, 300), "segments: records differ");
+}
+
+//--------------------------------------------------------------------------------
+static void heldUntilDone()
+{
+  clean();
+  std::vector<std::string> records = fill(6);
+
+  {
+    SegmentLog                      log("q", dir, segmentSize);
+    std::vector<SegmentLog::Ticket> tickets(5);
+    std::string                     record;
+
+    for(size_t i = 0; i < tickets.size(); ++i) {
+      CHECK(log.pop(record, &tickets[i]) && record == records[i], "held: pop " << i << " gives the wrong record");
+      CHECK(tickets[i] != 0, "held: ticket " << i << " is 0");
+    }
+
+    CHECK(log.size() == 1, "held: " << log.size() << " records instead of 1");
+
+    log.done(tickets[3]); // out of order.
+    log.done(tickets[0]);
+    log.done(tickets[1]);
+  }
+
+  CHECK(readWord(recordOffset(records, 2) + 4) != RECORD_POPPED, "held: a record not done() is marked DONE");
+  CHECK(readWord(recordOffset(records, 3) + 4) == RECORD_POPPED, "held: a done() record is not marked DONE");
+
+  SegmentLog               log("q", dir, segmentSize);
+  std::vector<std::string> expected;
+
+  expected.push_back(records[2]);
+  expected.push_back(records[4]);
+  expected.push_back(records[5]);
+
+  CHECK(log.size() == 3, "held: " << log.size() << " records instead of 3, after a restart");
+  CHECK(drain(log) == expected, "held: records differ after a restart");
+}
+
+//--------------------------------------------------------------------------------
+static void heldAcrossSegments()
+{
+  clean();
+
+  SegmentLog               log("q", dir, segmentSize);
+  std::vector<std::string> records;
+
+  for(unsigned i = 0; i < 200; ++i) {
+    records.push_back(std::string(1000 + i, (char)('a' + i % 26)));
+    log.append(records.back().data(), records.back().size());
+  }
+
+  size_t             used = log.segmentCount();
+  SegmentLog::Ticket first;
+  std::string        record;
+
+  CHECK(log.pop(record, &first) && record == records[0], "held segments: the first pop gives the wrong record");
+  CHECK(same(drain(log), records, 1, 200), "held segments: records differ, reading past a held record");
+  CHECK(log.segmentCount() == used, "held segments: " << log.segmentCount() << " segment(s) instead of " << used << ", with the first record held");
+
+  log.done(first);
+  CHECK(log.segmentCount() == 1, "held segments: " << log.segmentCount() << " segment(s) left, after done()");
+}
+
+//--------------------------------------------------------------------------------
+static void durableBatch()
+{
+  clean();
+
+  std::vector<std::string> records;
+
+  for(unsigned i = 0; i < 10; ++i) {
+    records.push_back(std::string("durable ") + (char)('A' + i));
+  }
+
+  {
+    SegmentLog log("q", dir, segmentSize, true);
+    unsigned   before = syncs();
+
+    log.append(records);
+    CHECK(syncs() - before == 1, "durable batch: " << syncs() - before << " syncs for one batch");
+  }
+
+  SegmentLog log("q", dir, segmentSize, true);
+  CHECK(same(drain(log), records, 0, 10), "durable batch: records differ after a restart");
+}
+
+//--------------------------------------------------------------------------------
+static void appendOne(SegmentLog *log, unsigned i)
+{
+  std::string record = std::string("appender ") + (char)('A' + i);
+  log->append(record.data(), record.size());
+}
+
+static void groupCommit()
+{
+  clean();
+
+  const unsigned appenders = 8;
+
+  SegmentLog          log("q", dir, segmentSize, true, 500000, appenders); // a long window, that the batch fills first.
+  boost::thread_group threads;
+  unsigned            before = syncs();
+
+  for(unsigned i = 0; i < appenders; ++i) {
+    threads.create_thread(boost::bind(appendOne, &log, i));
+  }
+  threads.join_all();
+
+  CHECK(syncs() - before < appenders, "group commit: " << syncs() - before << " syncs for " << appenders << " appenders");
+  CHECK(log.size() == appenders, "group commit: " << log.size() << " records instead of " << appenders);
+}
+
+//--------------------------------------------------------------------------------
+static void failedSync()
+{
+  clean();
+
+  std::string kept("synced");
+  std::string lost("not synced");
+  std::string record;
+
+  {
+    SegmentLog log("q", dir, segmentSize, true);
+
+    log.append(kept.data(), kept.size());
+
+    syncFails = true;
+
+    bool threw = false;
+    try {
+      log.append(lost.data(), lost.size());
+    } catch(std::runtime_error &) {
+      threw = true;
+    }
+
+    syncFails = false;
+
+    CHECK(threw, "failed sync: append() did not throw");
+    CHECK(log.size() == 1, "failed sync: " << log.size() << " records instead of 1");
+
+    threw = false;
+    try {
+      log.append(kept.data(), kept.size());
+    } catch(std::runtime_error &) {
+      threw = true;
+    }
+
+    CHECK(threw, "failed sync: the log took another record");
+    CHECK(log.pop(record) && record == kept, "failed sync: the synced record is gone");
+    CHECK(!log.pop(record), "failed sync: the rolled back record was popped");
+  }
+
+  SegmentLog log("q", dir, segmentSize, true);
+  CHECK(log.size() == 0, "failed sync: " << log.size() << " records after a restart, instead of 0");
+}
+
+//--------------------------------------------------------------------------------
+int main()
+{
+  char tmpl[] = "/tmp/ksmppc-segment-log-test.XXXXXX";
+
+  if(!mkdtemp(tmpl)) {
+    std::cerr << "Could not create a test directory." << std::endl;
+    return 2;
+  }
+
+  dir = tmpl;
+
+  cleanRestart();
+  pendingAfterPopped();
+  tornRecord();
+  tornLength();
+  badChecksum();
+  badState();
+  acrossSegments();
+  heldUntilDone();
+  heldAcrossSegments();
+  durableBatch();
+  groupCommit();
+  failedSync();
+
+  clean();
+  rmdir(dir.c_str());
+
+  return check::result("segment log");
+}
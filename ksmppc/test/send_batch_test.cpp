@@ -0,0 +1,142 @@
+// File  : send_batch_test.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+
+// Checks how submitMessages() answers for each message of a batch, when the
+// queue takes all of it, only the first items of it, or none. A message that
+// was queued must keep RQST_SUCCESS, or its client would send it again.
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "handler_send_batch.hpp"
+#include "check.hpp"
+
+//--------------------------------------------------------------------------------
+// Takes the first accept items of a push_batch(), and then fails the way the
+// backends do: PartialPushError if it took any, anything else if it took none.
+class FailingQueue : public SmppPduQueue
+{
+  public:
+    explicit FailingQueue(size_t accepted) : accept(accepted) {}
+
+    size_t                     accept;
+    std::vector<SharedSmppPdu> queued;
+
+  protected:
+    void doPush(SharedSmppPdu item)
+    {
+      doPushBatch(std::vector<SharedSmppPdu>(1, item));
+    }
+
+    void doPushBatch(const std::vector<SharedSmppPdu> &items)
+    {
+      size_t taken = std::min(accept, items.size());
+
+      queued.insert(queued.end(), items.begin(), items.begin() + taken);
+
+      if(taken < items.size()) {
+        if(taken > 0) {
+          throw PartialPushError("disk full", taken);
+        }
+        throw std::runtime_error("disk full");
+      }
+    }
+
+    SharedSmppPdu doPop  (Ticket *) { return SharedSmppPdu(); }
+    bool          doEmpty()         { return queued.empty();  }
+    size_t        doSize ()         { return queued.size();   }
+};
+
+static const size_t all = (size_t)-1;
+
+//--------------------------------------------------------------------------------
+// One message per character of layout, with that many parts. '0' is a message
+// the builder already rejected.
+static std::vector<PendingSend> batch(const std::string &layout)
+{
+  std::vector<PendingSend> sends(layout.size());
+
+  for(size_t i = 0; i < layout.size(); ++i) {
+    for(char p = '0'; p < layout[i]; ++p) {
+      sends[i].parts.push_back(SharedPduSubmitSm(new smpp_pdu::PDU_submit_sm()));
+    }
+
+    if(layout[i] == '0') {
+      sends[i].status = kisscpp::RQST_INVALID_PARAMETER;
+      sends[i].error  = "rejected by the builder";
+    }
+  }
+
+  return sends;
+}
+
+// expected has a character per message: 'S' RQST_SUCCESS, 'I' RQST_INVALID_PARAMETER,
+// 'U' RQST_UNKNOWN with the queue's error, 'P' RQST_UNKNOWN because only some parts were queued.
+static void submit(const std::string &layout, size_t accept, const std::string &expected, size_t expectedRejected)
+{
+  std::vector<PendingSend>        sends = batch(layout);
+  boost::shared_ptr<FailingQueue> queue(new FailingQueue(accept));
+  std::string                     what  = "layout " + layout + ", " + (accept == all ? std::string("all") : std::string(1, (char)('0' + accept))) + " accepted";
+
+  size_t rejected = submitMessages(sends, queue, SharedSessionPool());
+
+  CHECK(rejected == expectedRejected, what << ": " << rejected << " rejected instead of " << expectedRejected);
+
+  std::vector<SharedSmppPdu> parts;
+
+  for(size_t i = 0; i < sends.size(); ++i) {
+    parts.insert(parts.end(), sends[i].parts.begin(), sends[i].parts.end());
+
+    int         status = kisscpp::RQST_SUCCESS;
+    std::string error;
+
+    switch(expected[i]) {
+      case 'I': status = kisscpp::RQST_INVALID_PARAMETER; error = "rejected by the builder";                         break;
+      case 'U': status = kisscpp::RQST_UNKNOWN;           error = "disk full";                                       break;
+      case 'P': status = kisscpp::RQST_UNKNOWN;           error = "Only some parts of the message could be queued"; break;
+    }
+
+    CHECK(sends[i].status == status && sends[i].error == error,
+          what << ": message " << i << " has kcm-sts " << sends[i].status << " \"" << sends[i].error << "\", instead of " << expected[i]);
+  }
+
+  // The queue got the parts of the messages that were not rejected, in order.
+  parts.resize(std::min(parts.size(), queue->queued.size()));
+  CHECK(queue->queued == parts, what << ": the queue did not get the parts in order");
+}
+
+//--------------------------------------------------------------------------------
+int main()
+{
+  submit("1213", all, "SSSS", 0); // everything queued.
+  submit("101" , all, "SIS" , 1); // the builder's rejects are left as they are.
+  submit("1213", 3  , "SSUU", 2); // the push fails between two messages,
+  submit("1213", 2  , "SPUU", 3); // between the parts of one,
+  submit("1213", 0  , "UUUU", 4); // or before anything is queued.
+  submit("0112", 1  , "ISUU", 3); // a builder's reject in front does not shift the others.
+  submit("2"   , 1  , "P"   , 1);
+  submit("0"   , all, "I"   , 1); // nothing to queue at all.
+
+  return check::result("send batch");
+}
@@ -0,0 +1,167 @@
+// File  : session_dispatch_test.cpp
+// Author: Dirk J. Botha <bothadj@gmail.com>
+//
+// This file is part of ksmppcd application. Which is part of the KISS-SMPP
+// project.
+//
+// The ksmppcd application is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the License,
+// or (at your option) any later version.
+//
+// The ksmppcd application is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the ksmppcd application.
+// If not, see <http://www.gnu.org/licenses/>.
+
+// Checks the SessionDispatch tables:
+//  - every [state][slot] entry is a handler, either a real one or procpdu_unhandled,
+//  - only the slots of known command ids have real handlers,
+//  - no two known command ids share a slot,
+//  - inbound and outbound, they agree with the switches they replaced,
+//  - and so does dispatch(), with its fast path for bound sessions.
+
+#include <cstring>
+#include <iostream>
+#include <set>
+
+#include "tools/recording_session.hpp"
+#include "check.hpp"
+
+typedef RecordingSession::Dispatch Dispatch;
+
+//--------------------------------------------------------------------------------
+static const uint32_t knownCommands[] = {
+  smpp_pdu::CommandId::GenericNack,          smpp_pdu::CommandId::BindReceiver,         smpp_pdu::CommandId::BindReceiverResp,
+  smpp_pdu::CommandId::BindTransmitter,      smpp_pdu::CommandId::BindTransmitterResp,  smpp_pdu::CommandId::QuerySm,
+  smpp_pdu::CommandId::QuerySmResp,          smpp_pdu::CommandId::SubmitSm,             smpp_pdu::CommandId::SubmitSmResp,
+  smpp_pdu::CommandId::DeliverSm,            smpp_pdu::CommandId::DeliverSmResp,        smpp_pdu::CommandId::Unbind,
+  smpp_pdu::CommandId::UnbindResp,           smpp_pdu::CommandId::ReplaceSm,            smpp_pdu::CommandId::ReplaceSmResp,
+  smpp_pdu::CommandId::CancelSm,             smpp_pdu::CommandId::CancelSmResp,         smpp_pdu::CommandId::BindTransceiver,
+  smpp_pdu::CommandId::BindTransceiverResp,  smpp_pdu::CommandId::Outbind,              smpp_pdu::CommandId::EnquireLink,
+  smpp_pdu::CommandId::EnquireLinkResp,      smpp_pdu::CommandId::SubmitMulti,          smpp_pdu::CommandId::SubmitMultiResp,
+  smpp_pdu::CommandId::AlertNotification,    smpp_pdu::CommandId::DataSm,               smpp_pdu::CommandId::DataSmResp,
+  smpp_pdu::CommandId::BroadcastSm,          smpp_pdu::CommandId::BroadcastSmResp,      smpp_pdu::CommandId::QueryBroadcastSm,
+  smpp_pdu::CommandId::QueryBroadcastSmResp, smpp_pdu::CommandId::CancelBroadcastSm,    smpp_pdu::CommandId::CancelBroadcastSmResp
+};
+
+static const size_t knownCount = sizeof(knownCommands) / sizeof(knownCommands[0]);
+
+// Unknown ids, including ones that share low bits with known ones.
+static const uint32_t unknownCommands[] = { 0x00000000, 0x0000000A, 0x00000040, 0x00000044, 0x00000104, 0x80000104,
+                                            0x000001FF, 0x00010004, 0x40000004, 0x80000022, 0xFFFFFFFF };
+
+//--------------------------------------------------------------------------------
+class Frame
+{
+  public:
+    explicit Frame(uint32_t commandId)
+    {
+      memset(bytes, 0, sizeof(bytes));
+      bytes[3] = 16;
+      bytes[4] = commandId >> 24;
+      bytes[5] = commandId >> 16;
+      bytes[6] = commandId >> 8;
+      bytes[7] = commandId;
+    }
+
+    uint8_t *data() { return bytes; }
+
+  private:
+    uint8_t bytes[16];
+};
+
+//--------------------------------------------------------------------------------
+static void checkAgainstSwitches(uint32_t commandId)
+{
+  Frame            frame(commandId);
+  RawPdu           rawpdu(frame.data());
+  RecordingSession session;
+
+  for(unsigned st = 0; st < Dispatch::STATE_COUNT; ++st) {
+    RecordingSession::State state = (RecordingSession::State)st;
+
+    session.last = 0;
+    session.process4state_switch(state, rawpdu);
+    const char *expected = session.last;
+
+    session.last = 0;
+    CHECK(Dispatch::inbound(st, commandId) != 0, "no handler at all for 0x" << std::hex << commandId << std::dec << " in state " << st);
+    if(Dispatch::inbound(st, commandId) != 0) {
+      session.process4state_table(state, rawpdu);
+    }
+
+    CHECK(session.last && strcmp(session.last, expected) == 0,
+          "inbound 0x" << std::hex << commandId << std::dec << " in state " << st << ": the switch runs " << expected
+          << ", the table runs " << (session.last ? session.last : "nothing"));
+
+    session.last = 0;
+    if(Dispatch::inbound(st, commandId) != 0) {
+      session.process4state(state, rawpdu);
+    }
+
+    CHECK(session.last && strcmp(session.last, expected) == 0,
+          "inbound 0x" << std::hex << commandId << std::dec << " in state " << st << ": the switch runs " << expected
+          << ", dispatch() runs " << (session.last ? session.last : "nothing"));
+
+    CHECK(session.send4state_table(state, commandId) == session.send4state_switch(state, commandId),
+          "outbound 0x" << std::hex << commandId << std::dec << " in state " << st);
+  }
+}
+
+//--------------------------------------------------------------------------------
+int main()
+{
+  Dispatch::build();
+
+  // Known command ids each get a slot of their own, and never slot 0.
+  std::set<unsigned> knownSlots;
+
+  for(size_t i = 0; i < knownCount; ++i) {
+    unsigned slot = Dispatch::commandSlot(knownCommands[i]);
+    CHECK(slot != 0, "command 0x" << std::hex << knownCommands[i] << " is in slot 0");
+    CHECK(knownSlots.insert(slot).second, "command 0x" << std::hex << knownCommands[i] << " shares slot " << std::dec << slot);
+  }
+
+  // Every entry of the table is a handler. Slots no known command maps to, only ever get procpdu_unhandled.
+  RecordingSession session;
+
+  for(unsigned slot = 0; slot < Dispatch::COMMAND_SLOTS; ++slot) {
+    uint32_t commandId = ((uint32_t)(slot & 0x80) << 24) | ((slot & 0x40) << 2) | (slot & 0x3F); // the inverse of commandSlot()
+    Frame    frame(commandId);
+    RawPdu   rawpdu(frame.data());
+
+    CHECK(Dispatch::commandSlot(commandId) == slot, "slot " << slot << " does not round trip");
+
+    for(unsigned st = 0; st < Dispatch::STATE_COUNT; ++st) {
+      Dispatch::PduHandler handler = Dispatch::inbound(st, commandId);
+
+      CHECK(handler != 0, "state " << st << " slot " << slot << " is empty");
+      if(handler == 0) {
+        continue;
+      }
+
+      session.last = 0;
+      (session.*handler)(rawpdu);
+
+      CHECK(knownSlots.count(slot) || strcmp(session.last, "procpdu_unhandled") == 0,
+            "state " << st << " slot " << slot << " is not a known command, but goes to " << session.last);
+      CHECK(knownSlots.count(slot) || !Dispatch::outboundPermitted(st, commandId),
+            "state " << st << " slot " << slot << " is not a known command, but may be sent");
+    }
+  }
+
+  for(size_t i = 0; i < knownCount; ++i) {
+    checkAgainstSwitches(knownCommands[i]);
+  }
+
+  for(size_t i = 0; i < sizeof(unknownCommands) / sizeof(unknownCommands[0]); ++i) {
+    checkAgainstSwitches(unknownCommands[i]);
+  }
+
+  return check::result("session dispatch tables");
+}
@@ -0,0 +1,7 @@
+LIMIT=$1
+COUNT=0
+while [ $COUNT -lt $LIMIT ];
+do
+  echo "{\"id\":\"$COUNT\",\"source-addr\":\"27836800464\",\"destination-addr\":\"27836800465\",\"short-message\":\"This is a test.\"}"
+  COUNT=$(($COUNT+1))
+done | nc -q 2 localhost 9111